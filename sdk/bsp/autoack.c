@@ -0,0 +1,312 @@
+#include "autoack.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "scum.h"
+#include "ieee_802_15_4.h"
+#include "radio.h"
+
+//=========================== variables =======================================
+
+typedef struct {
+    // Receiver: acknowledge frames addressed to us that request it
+    bool enabled;
+    bool addr_set;
+    uint16_t pan_id;
+    uint16_t short_addr;  // broadcast address if none
+    bool ext_addr_set;
+    uint8_t ext_addr[IEEE_802_15_4_EXT_ADDR_LENGTH];
+    uint32_t turnaround;
+    uint8_t ack[IEEE_802_15_4_ACK_LENGTH] __attribute__((aligned(4)));
+
+    // Sender: frame waiting for its acknowledgment
+    uint8_t* packet;
+    uint8_t pkt_len;
+    uint8_t seq_num;
+    uint8_t channel;
+    uint8_t max_retries;
+    uint8_t retries_left;
+    uint8_t attempts;
+    bool tx_at;  // first attempt sent at tx_ticks
+    uint32_t tx_ticks;
+    bool waiting;
+    bool acked;
+    int8_t ack_rssi;  // link quality of the last ACK received
+    uint8_t ack_chip_errors;
+    volatile bool busy;
+    autoack_status_t status;
+    autoack_done_cbt done_cb;
+} autoack_vars_t;
+
+autoack_vars_t autoack_vars;
+
+//=========================== prototypes ======================================
+
+static bool autoack_start(void* packet, uint8_t pkt_len, uint8_t retries,
+                          autoack_done_cbt cb);
+static void autoack_attempt(void);
+static bool autoack_addressed_to_us(const ieee_802_15_4_frame_t* view);
+static void autoack_finish(autoack_status_t status);
+static void cb_autoack_sent(radio_status_t status);
+static void cb_autoack_wait_done(radio_status_t status);
+
+//=========================== public ==========================================
+
+// Install the auto-ACK RX hook. Data and command frames with the ACK request
+// bit set and addressed to us are acknowledged aTurnaroundTime after they
+// end, with the TX start triggered by an RF timer compare. Nothing is
+// acknowledged until autoack_set_address() has registered our addresses. ACK
+// frames are matched against the frame being sent and never reach the RX
+// ring.
+void autoack_init(void) {
+    memset(&autoack_vars, 0, sizeof(autoack_vars_t));
+
+    autoack_vars.enabled = true;
+    autoack_vars.max_retries = AUTOACK_DEFAULT_MAX_RETRIES;
+    autoack_vars.turnaround = AUTOACK_TURNAROUND_TICKS;
+
+    radio_set_rx_hook(autoack_rx_hook);
+}
+
+// Register the PAN ID and addresses whose frames are acknowledged. short_addr
+// is IEEE_802_15_4_BROADCAST_ADDR and ext_addr NULL if we have none.
+// Broadcast frames are never acknowledged.
+void autoack_set_address(uint16_t pan_id, uint16_t short_addr,
+                         const uint8_t* ext_addr) {
+    autoack_vars.addr_set = false;
+
+    autoack_vars.pan_id = pan_id;
+    autoack_vars.short_addr = short_addr;
+    autoack_vars.ext_addr_set = ext_addr != NULL;
+    if (ext_addr != NULL) {
+        memcpy(autoack_vars.ext_addr, ext_addr, IEEE_802_15_4_EXT_ADDR_LENGTH);
+    }
+
+    autoack_vars.addr_set = true;
+}
+
+// Enable or disable acknowledging received frames. ACKs for frames sent with
+// autoack_send() are processed either way.
+void autoack_set_enabled(bool enabled) { autoack_vars.enabled = enabled; }
+
+void autoack_set_max_retries(uint8_t max_retries) {
+    autoack_vars.max_retries = max_retries;
+}
+
+// Send a frame once and listen for its ACK for AUTOACK_WAIT_TICKS. packet is
+// the MAC frame, with the ACK request bit set, and pkt_len includes the CRC;
+// the frame is sent on the current channel. cb is called from interrupt
+// context with AUTOACK_STATUS_ACKED or AUTOACK_STATUS_NO_ACK. Returns false
+// if the frame does not request an ACK or the radio is busy.
+bool autoack_tx_async(void* packet, uint8_t pkt_len, autoack_done_cbt cb) {
+    return autoack_start(packet, pkt_len, 0, cb);
+}
+
+// Same as autoack_tx_async(), but the frame is sent exactly when the RF timer
+// reaches ticks, which must be at least ~50 us ahead (see
+// radio_schedule_tx_at()). Used to send right after a clear channel
+// assessment.
+bool autoack_tx_at(void* packet, uint8_t pkt_len, uint32_t ticks,
+                   autoack_done_cbt cb) {
+    autoack_vars.tx_at = true;
+    autoack_vars.tx_ticks = ticks;
+    return autoack_start(packet, pkt_len, 0, cb);
+}
+
+// Same as autoack_tx_async(), but the frame is sent again up to max_retries
+// times until it is acknowledged.
+bool autoack_send_async(void* packet, uint8_t pkt_len, autoack_done_cbt cb) {
+    return autoack_start(packet, pkt_len, autoack_vars.max_retries, cb);
+}
+
+// Blocking wrapper around autoack_send_async(); the core sleeps until the
+// frame is acknowledged or the retries are exhausted.
+autoack_status_t autoack_send(void* packet, uint8_t pkt_len) {
+    if (!autoack_send_async(packet, pkt_len, NULL)) {
+        return AUTOACK_STATUS_ERROR;
+    }
+
+    radio_wait_while(&autoack_vars.busy);
+
+    return autoack_vars.status;
+}
+
+bool autoack_busy(void) { return autoack_vars.busy; }
+
+// Delay between the end of a received frame and the start of its ACK, in RF
+// timer ticks. Defaults to aTurnaroundTime; TSCH uses TsTxAckDelay instead.
+void autoack_set_turnaround(uint32_t ticks) { autoack_vars.turnaround = ticks; }
+
+// Match the next ACK frames against seq_num, for a frame sent without
+// autoack_tx_async(), e.g. by a slotted MAC listening in its own ACK window.
+void autoack_expect_ack(uint8_t seq_num) {
+    autoack_vars.seq_num = seq_num;
+    autoack_vars.acked = false;
+    autoack_vars.waiting = true;
+}
+
+// Whether the ACK expected with autoack_expect_ack() has arrived. Stops
+// waiting for it.
+bool autoack_ack_received(void) {
+    autoack_vars.waiting = false;
+    return autoack_vars.acked;
+}
+
+// RSSI (dBm) and chip errors of the last ACK received, e.g. for a transmit
+// power controller
+void autoack_get_ack_quality(int8_t* rssi, uint8_t* chip_errors) {
+    *rssi = autoack_vars.ack_rssi;
+    *chip_errors = autoack_vars.ack_chip_errors;
+}
+
+// RX hook installed by autoack_init(). MAC layers installing their own hook
+// pass the frames they do not handle on to it.
+radio_rx_verdict_t autoack_rx_hook(radio_rx_slot_t* slot, uint32_t timestamp) {
+    const uint8_t* frame = &slot->buffer[1];
+    ieee_802_15_4_frame_t view;
+    uint8_t frame_type;
+    uint8_t ack_len;
+
+    if (slot->length < IEEE_802_15_4_ACK_LENGTH) {
+        return RADIO_RX_HOOK_QUEUE;
+    }
+
+    frame_type = frame[0] & IEEE_802_15_4_FCF_FRAME_TYPE_MASK;
+    if (frame_type == IEEE_802_15_4_FRAME_TYPE_ACK) {
+        if (autoack_vars.waiting &&
+            frame[IEEE_802_15_4_SEQ_NUM_OFFSET] == autoack_vars.seq_num) {
+            autoack_vars.acked = true;
+            autoack_vars.ack_rssi = slot->rssi;
+            autoack_vars.ack_chip_errors = slot->LQI_chip_errors & 0xFF;
+            return RADIO_RX_HOOK_CONSUME;
+        }
+        return RADIO_RX_HOOK_DROP;
+    }
+
+    if (!autoack_vars.enabled || !autoack_vars.addr_set ||
+        (frame[0] & IEEE_802_15_4_FCF_ACK_REQUEST) == 0 ||
+        (frame_type != IEEE_802_15_4_FRAME_TYPE_DATA &&
+         frame_type != IEEE_802_15_4_FRAME_TYPE_COMMAND)) {
+        return RADIO_RX_HOOK_QUEUE;
+    }
+
+    // A frame without sequence number cannot be acknowledged immediately
+    if (ieee_802_15_4_parse(frame, slot->length, &view) &&
+        view.seq_num_present && autoack_addressed_to_us(&view)) {
+        ack_len = ieee_802_15_4_build_ack(autoack_vars.ack, view.seq_num,
+                                          false);
+        radio_reply_at(autoack_vars.ack, ack_len,
+                       timestamp + autoack_vars.turnaround);
+    }
+    return RADIO_RX_HOOK_QUEUE;
+}
+
+//=========================== private =========================================
+
+static bool autoack_start(void* packet, uint8_t pkt_len, uint8_t retries,
+                          autoack_done_cbt cb) {
+    uint8_t* frame = packet;
+
+    bool tx_at = autoack_vars.tx_at;
+
+    autoack_vars.tx_at = false;
+    if (autoack_vars.busy || radio_busy() ||
+        pkt_len < IEEE_802_15_4_ACK_LENGTH ||
+        (frame[0] & IEEE_802_15_4_FCF_ACK_REQUEST) == 0) {
+        return false;
+    }
+
+    autoack_vars.packet = frame;
+    autoack_vars.pkt_len = pkt_len;
+    autoack_vars.seq_num = frame[IEEE_802_15_4_SEQ_NUM_OFFSET];
+    autoack_vars.channel = radio_getFrequency();
+    autoack_vars.retries_left = retries;
+    autoack_vars.attempts = 0;
+    autoack_vars.done_cb = cb;
+    autoack_vars.busy = true;
+
+    if (tx_at) {
+        autoack_vars.attempts = 1;
+        radio_setFrequency(autoack_vars.channel, FREQ_TX);
+        radio_loadPacket(frame, pkt_len);
+        radio_txEnable();
+        if (!radio_schedule_tx_at(autoack_vars.tx_ticks, cb_autoack_sent)) {
+            radio_rfOff();
+            autoack_vars.busy = false;
+            return false;
+        }
+        return true;
+    }
+
+    autoack_attempt();
+    return true;
+}
+
+static void autoack_attempt(void) {
+    autoack_vars.attempts++;
+    autoack_vars.acked = false;
+
+    radio_setFrequency(autoack_vars.channel, FREQ_TX);
+    if (!radio_tx_async(autoack_vars.packet, autoack_vars.pkt_len,
+                        cb_autoack_sent)) {
+        autoack_finish(AUTOACK_STATUS_ERROR);
+    }
+}
+
+// Whether the destination of the frame is our short or extended address, in
+// our PAN
+static bool autoack_addressed_to_us(const ieee_802_15_4_frame_t* view) {
+    if (view->dst_pan_id_present && view->dst_pan_id != autoack_vars.pan_id &&
+        view->dst_pan_id != IEEE_802_15_4_BROADCAST_PAN_ID) {
+        return false;
+    }
+
+    if (view->dst_addr_mode == IEEE_802_15_4_ADDR_MODE_SHORT) {
+        return autoack_vars.short_addr != IEEE_802_15_4_BROADCAST_ADDR &&
+               view->dst_short_addr == autoack_vars.short_addr;
+    }
+    if (view->dst_addr_mode == IEEE_802_15_4_ADDR_MODE_EXTENDED) {
+        return autoack_vars.ext_addr_set &&
+               memcmp(view->dst_addr, autoack_vars.ext_addr,
+                      IEEE_802_15_4_EXT_ADDR_LENGTH) == 0;
+    }
+    return false;
+}
+
+static void autoack_finish(autoack_status_t status) {
+    autoack_done_cbt cb = autoack_vars.done_cb;
+
+    autoack_vars.status = status;
+    autoack_vars.done_cb = NULL;
+    autoack_vars.busy = false;
+
+    if (cb != NULL) {
+        cb(status, autoack_vars.attempts);
+    }
+}
+
+// The frame is on the air, listen for the ACK
+static void cb_autoack_sent(radio_status_t status) {
+    radio_setFrequency(autoack_vars.channel, FREQ_RX);
+
+    autoack_vars.waiting = true;
+    if (!radio_rx_async(AUTOACK_WAIT_TICKS, cb_autoack_wait_done)) {
+        autoack_vars.waiting = false;
+        autoack_finish(AUTOACK_STATUS_ERROR);
+    }
+}
+
+static void cb_autoack_wait_done(radio_status_t status) {
+    autoack_vars.waiting = false;
+
+    if (autoack_vars.acked) {
+        autoack_finish(AUTOACK_STATUS_ACKED);
+    } else if (autoack_vars.retries_left > 0) {
+        autoack_vars.retries_left--;
+        autoack_attempt();
+    } else {
+        autoack_finish(AUTOACK_STATUS_NO_ACK);
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef __AUTOACK_H
+#define __AUTOACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "radio.h"
+
+//=========================== define ==========================================
+
+// aTurnaroundTime, 12 symbols = 192 us, in RF timer ticks
+#define AUTOACK_TURNAROUND_TICKS 96
+
+// macAckWaitDuration, 54 symbols = 864 us, in RF timer ticks
+#define AUTOACK_WAIT_TICKS 432
+
+// macMaxFrameRetries default
+#define AUTOACK_DEFAULT_MAX_RETRIES 3
+
+//=========================== typedef =========================================
+
+typedef enum {
+    AUTOACK_STATUS_ACKED = 0x01,
+    AUTOACK_STATUS_NO_ACK = 0x02,
+    AUTOACK_STATUS_ERROR = 0x03,  // the frame could not be sent
+} autoack_status_t;
+
+// attempts is the number of times the frame was sent, retries included
+typedef void (*autoack_done_cbt)(autoack_status_t status, uint8_t attempts);
+
+//=========================== prototypes ======================================
+
+void autoack_init(void);
+void autoack_set_address(uint16_t pan_id, uint16_t short_addr,
+                         const uint8_t* ext_addr);
+void autoack_set_enabled(bool enabled);
+void autoack_set_max_retries(uint8_t max_retries);
+void autoack_set_turnaround(uint32_t ticks);
+radio_rx_verdict_t autoack_rx_hook(radio_rx_slot_t* slot, uint32_t timestamp);
+
+bool autoack_tx_async(void* packet, uint8_t pkt_len, autoack_done_cbt cb);
+bool autoack_tx_at(void* packet, uint8_t pkt_len, uint32_t ticks,
+                   autoack_done_cbt cb);
+bool autoack_send_async(void* packet, uint8_t pkt_len, autoack_done_cbt cb);
+autoack_status_t autoack_send(void* packet, uint8_t pkt_len);
+bool autoack_busy(void);
+void autoack_get_ack_quality(int8_t* rssi, uint8_t* chip_errors);
+
+//==== for MAC layers sending frames themselves
+void autoack_expect_ack(uint8_t seq_num);
+bool autoack_ack_received(void);
+
+#endif
@@ -0,0 +1,301 @@
+#include "ble.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "scum.h"
+#include "radio.h"
+#include "rftimer.h"
+#include "scm3c_hw_interface.h"
+
+//=========================== define ==========================================
+
+// CRC24 polynomial x^24 + x^10 + x^9 + x^6 + x^4 + x^3 + x + 1, bit reversed:
+// the CRC is computed least significant bit first, as the bits are sent
+#define BLE_CRC24_POLY_REVERSED 0xDA6000
+
+// Whitening LFSR x^7 + x^4 + 1, kept in the upper 7 bits of a byte
+#define BLE_WHITEN_TAPS 0x11
+
+// Arbitrary TX FIFO control bits in ANALOG_CFG_REG_11. Bits are shifted in
+// one at a time on the load clock and sent at 1 Mbps once transmit is set.
+#define BLE_FIFO_DATA_IN 0x0080
+#define BLE_FIFO_LOAD_CLK 0x0040
+#define BLE_FIFO_TRANSMIT 0x0020
+
+// Air time of one bit at 1 Mbps is half an RF timer tick; add some margin
+// for the PA ramp down
+#define BLE_TX_MARGIN_TICKS 20
+
+// 802.15.4 channels 11 and 26, used to interpolate the LC codes
+#define BLE_802_15_4_CH11_MHZ 2405
+#define BLE_802_15_4_CH26_MHZ 2480
+
+#define BLE_NUM_ADV_CHANNELS 3
+
+//=========================== variables =======================================
+
+typedef struct {
+    // Kernels, built once by ble_init()
+    uint32_t crc_table[256];
+    // Whitening byte (low byte) and next LFSR state (high byte) for each
+    // 7-bit LFSR state
+    uint16_t whiten_table[128];
+
+    uint8_t pdu_type;
+    bool random_address;
+    uint8_t adv_address[BLE_ADV_ADDRESS_LENGTH];
+    uint8_t adv_data[BLE_MAX_ADV_DATA_LENGTH];
+    uint8_t adv_data_len;
+
+    // TX LC codes of channels 37, 38 and 39; 0 to derive them from the radio
+    // channel table
+    uint32_t channel_codes[BLE_NUM_ADV_CHANNELS];
+
+    uint8_t packet[BLE_MAX_PACKET_LENGTH];
+    uint8_t packet_len;
+} ble_vars_t;
+
+ble_vars_t ble_vars;
+
+//=========================== prototypes ======================================
+
+static uint8_t ble_whiten_seed(uint8_t channel);
+static uint32_t ble_channel_code(uint8_t channel);
+static void ble_load_fifo(const uint8_t* packet, uint8_t len);
+
+//=========================== public ==========================================
+
+// Build the CRC24 and whitening tables, and set the BLE clock to the internal
+// 1 MHz clock. Advertises ADV_NONCONN_IND with an all-zero public address and
+// no data until configured otherwise.
+void ble_init(void) {
+    uint32_t crc;
+    uint8_t lfsr;
+    uint8_t byte;
+    uint8_t mask;
+    uint16_t i;
+    uint8_t j;
+
+    memset(&ble_vars, 0, sizeof(ble_vars_t));
+    ble_vars.pdu_type = BLE_PDU_ADV_NONCONN_IND;
+
+    for (i = 0; i < 256; i++) {
+        crc = i;
+        for (j = 0; j < 8; j++) {
+            crc = (crc & 1) ? (crc >> 1) ^ BLE_CRC24_POLY_REVERSED : crc >> 1;
+        }
+        ble_vars.crc_table[i] = crc;
+    }
+
+    for (i = 0; i < 128; i++) {
+        lfsr = i << 1;
+        byte = 0;
+        for (mask = 1; mask != 0; mask <<= 1) {
+            if (lfsr & 0x80) {
+                lfsr ^= BLE_WHITEN_TAPS;
+                byte |= mask;
+            }
+            lfsr <<= 1;
+        }
+        ble_vars.whiten_table[i] = byte | ((uint16_t)(lfsr >> 1) << 8);
+    }
+
+    int_clk_ble_ASC();
+    enable_1mhz_ble_ASC();
+    analog_scan_chain_write();
+    analog_scan_chain_load();
+}
+
+// Advertiser address, least significant byte first. random sets TxAdd.
+void ble_set_adv_address(const uint8_t* address, bool random) {
+    memcpy(ble_vars.adv_address, address, BLE_ADV_ADDRESS_LENGTH);
+    ble_vars.random_address = random;
+}
+
+// Advertising data (AD structures), up to 31 bytes
+bool ble_set_adv_data(const uint8_t* data, uint8_t len) {
+    if (len > BLE_MAX_ADV_DATA_LENGTH) {
+        return false;
+    }
+    memcpy(ble_vars.adv_data, data, len);
+    ble_vars.adv_data_len = len;
+    return true;
+}
+
+void ble_set_pdu_type(uint8_t pdu_type) { ble_vars.pdu_type = pdu_type; }
+
+// Override the TX LC code of an advertising channel, e.g. with a value found
+// by sweeping against a BLE receiver. 0 restores the default, interpolated
+// from the 802.15.4 TX codes of the radio channel table.
+void ble_set_channel_code(uint8_t channel, uint32_t lc_code) {
+    if (channel >= BLE_ADV_CHANNEL_37 && channel <= BLE_ADV_CHANNEL_39) {
+        ble_vars.channel_codes[channel - BLE_ADV_CHANNEL_37] = lc_code;
+    }
+}
+
+// Build the advertising packet for channel: preamble, access address, PDU,
+// CRC24, with PDU and CRC whitened for the channel. Returns its length.
+uint8_t ble_gen_packet(uint8_t channel) {
+    uint8_t* packet = ble_vars.packet;
+    uint8_t* pdu = &packet[BLE_PREAMBLE_LENGTH + BLE_ACCESS_ADDRESS_LENGTH];
+    uint8_t pdu_len = BLE_PDU_HEADER_LENGTH + BLE_ADV_ADDRESS_LENGTH +
+                      ble_vars.adv_data_len;
+    uint32_t crc;
+
+    // The preamble alternates starting with the first access address bit
+    packet[0] = (BLE_ADV_ACCESS_ADDRESS & 1) ? 0x55 : 0xAA;
+    packet[1] = BLE_ADV_ACCESS_ADDRESS & 0xFF;
+    packet[2] = (BLE_ADV_ACCESS_ADDRESS >> 8) & 0xFF;
+    packet[3] = (BLE_ADV_ACCESS_ADDRESS >> 16) & 0xFF;
+    packet[4] = (BLE_ADV_ACCESS_ADDRESS >> 24) & 0xFF;
+
+    pdu[0] = ble_vars.pdu_type & 0x0F;
+    if (ble_vars.random_address) {
+        pdu[0] |= 0x40;
+    }
+    pdu[1] = BLE_ADV_ADDRESS_LENGTH + ble_vars.adv_data_len;
+    memcpy(&pdu[BLE_PDU_HEADER_LENGTH], ble_vars.adv_address,
+           BLE_ADV_ADDRESS_LENGTH);
+    memcpy(&pdu[BLE_PDU_HEADER_LENGTH + BLE_ADV_ADDRESS_LENGTH],
+           ble_vars.adv_data, ble_vars.adv_data_len);
+
+    crc = ble_crc24(pdu, pdu_len, BLE_ADV_CRC_INIT);
+    pdu[pdu_len] = crc & 0xFF;
+    pdu[pdu_len + 1] = (crc >> 8) & 0xFF;
+    pdu[pdu_len + 2] = (crc >> 16) & 0xFF;
+
+    ble_whiten(pdu, pdu_len + BLE_CRC_LENGTH, channel);
+
+    ble_vars.packet_len = BLE_PREAMBLE_LENGTH + BLE_ACCESS_ADDRESS_LENGTH +
+                          pdu_len + BLE_CRC_LENGTH;
+    return ble_vars.packet_len;
+}
+
+// Send one advertising packet on channel (37, 38 or 39) and return once it
+// is on the air. The PA and LO are powered as for an 802.15.4 transmission;
+// the bits go through the arbitrary TX FIFO at 1 Mbps. Returns false if the
+// channel is invalid or the radio is busy.
+bool ble_transmit(uint8_t channel) {
+    uint32_t end;
+
+    if (channel < BLE_ADV_CHANNEL_37 || channel > BLE_ADV_CHANNEL_39 ||
+        radio_busy()) {
+        return false;
+    }
+
+    ble_gen_packet(channel);
+
+    LC_set_word(LC_monotonic_word(ble_channel_code(channel)));
+    radio_txEnable();
+    ble_load_fifo(ble_vars.packet, ble_vars.packet_len);
+
+    SCUM_ANALOG_CFG_REG_11 = BLE_FIFO_TRANSMIT;
+    end = rftimer_readCounter() + ble_vars.packet_len * 8 / 2 +
+          BLE_TX_MARGIN_TICKS;
+    while ((int32_t)(rftimer_readCounter() - end) < 0);
+    SCUM_ANALOG_CFG_REG_11 = 0;
+
+    radio_rfOff();
+    return true;
+}
+
+// Send the advertising packet on channels 37, 38 and 39 in turn
+bool ble_advertise(void) {
+    uint8_t channel;
+
+    for (channel = BLE_ADV_CHANNEL_37; channel <= BLE_ADV_CHANNEL_39;
+         channel++) {
+        if (!ble_transmit(channel)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// CRC24 of data, one table lookup per byte. init is the CRC initial value as
+// given by the specification; the result holds the first transmitted CRC bit
+// in bit 0, i.e. it is sent least significant byte first.
+uint32_t ble_crc24(const uint8_t* data, uint8_t len, uint32_t init) {
+    uint32_t crc = 0;
+    uint8_t i;
+
+    // The register runs bit reversed
+    for (i = 0; i < 24; i++) {
+        crc = (crc << 1) | ((init >> i) & 1);
+    }
+
+    for (i = 0; i < len; i++) {
+        crc = (crc >> 8) ^ ble_vars.crc_table[(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+// Whiten (or de-whiten) data in place for channel, one table lookup per byte
+void ble_whiten(uint8_t* data, uint8_t len, uint8_t channel) {
+    uint8_t state = ble_whiten_seed(channel);
+    uint16_t entry;
+    uint8_t i;
+
+    for (i = 0; i < len; i++) {
+        entry = ble_vars.whiten_table[state];
+        data[i] ^= entry & 0xFF;
+        state = entry >> 8;
+    }
+}
+
+//=========================== private =========================================
+
+// LFSR position 0 set, positions 1 to 6 hold the channel index, most
+// significant bit first. Position 0 is the most significant bit of the
+// 7-bit state.
+static uint8_t ble_whiten_seed(uint8_t channel) {
+    uint8_t seed = 0x01;
+    uint8_t i;
+
+    for (i = 0; i < 6; i++) {
+        if (channel & (1 << i)) {
+            seed |= 1 << (6 - i);
+        }
+    }
+    return seed;
+}
+
+static uint32_t ble_channel_code(uint8_t channel) {
+    static const uint16_t channel_mhz[BLE_NUM_ADV_CHANNELS] = {
+        BLE_ADV_CHANNEL_37_MHZ, BLE_ADV_CHANNEL_38_MHZ,
+        BLE_ADV_CHANNEL_39_MHZ};
+    radio_channel_table_t table;
+    uint8_t index = channel - BLE_ADV_CHANNEL_37;
+    int32_t low;
+    int32_t high;
+
+    if (ble_vars.channel_codes[index] != 0) {
+        return ble_vars.channel_codes[index];
+    }
+
+    // Linear in the monotonic LC code between 2405 and 2480 MHz
+    radio_export_channel_table(&table);
+    low = table.tx_codes[0];
+    high = table.tx_codes[IEEE_802_15_4_NUM_CHANNELS - 1];
+    return low + ((int32_t)channel_mhz[index] - BLE_802_15_4_CH11_MHZ) *
+                     (high - low) /
+                     (BLE_802_15_4_CH26_MHZ - BLE_802_15_4_CH11_MHZ);
+}
+
+// Shift the packet into the TX FIFO, each byte least significant bit first
+static void ble_load_fifo(const uint8_t* packet, uint8_t len) {
+    uint32_t data;
+    uint8_t mask;
+    uint8_t i;
+
+    for (i = 0; i < len; i++) {
+        for (mask = 1; mask != 0; mask <<= 1) {
+            data = (packet[i] & mask) ? BLE_FIFO_DATA_IN : 0;
+            SCUM_ANALOG_CFG_REG_11 = data;
+            SCUM_ANALOG_CFG_REG_11 = data | BLE_FIFO_LOAD_CLK;
+            SCUM_ANALOG_CFG_REG_11 = data;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef __BLE_H
+#define __BLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//=========================== define ==========================================
+
+// Advertising channels and their center frequencies in MHz
+#define BLE_ADV_CHANNEL_37 37
+#define BLE_ADV_CHANNEL_38 38
+#define BLE_ADV_CHANNEL_39 39
+#define BLE_ADV_CHANNEL_37_MHZ 2402
+#define BLE_ADV_CHANNEL_38_MHZ 2426
+#define BLE_ADV_CHANNEL_39_MHZ 2480
+
+// Access address and CRC initial value of advertising channel packets
+#define BLE_ADV_ACCESS_ADDRESS 0x8E89BED6
+#define BLE_ADV_CRC_INIT 0x555555
+
+#define BLE_ADV_ADDRESS_LENGTH 6
+#define BLE_MAX_ADV_DATA_LENGTH 31
+
+// Preamble, access address, PDU header, AdvA, AdvData and CRC
+#define BLE_PREAMBLE_LENGTH 1
+#define BLE_ACCESS_ADDRESS_LENGTH 4
+#define BLE_PDU_HEADER_LENGTH 2
+#define BLE_CRC_LENGTH 3
+#define BLE_MAX_PACKET_LENGTH                                          \
+    (BLE_PREAMBLE_LENGTH + BLE_ACCESS_ADDRESS_LENGTH +                 \
+     BLE_PDU_HEADER_LENGTH + BLE_ADV_ADDRESS_LENGTH +                  \
+     BLE_MAX_ADV_DATA_LENGTH + BLE_CRC_LENGTH)
+
+// Advertising PDU types
+#define BLE_PDU_ADV_IND 0x0
+#define BLE_PDU_ADV_NONCONN_IND 0x2
+#define BLE_PDU_ADV_SCAN_IND 0x6
+
+//=========================== prototypes ======================================
+
+void ble_init(void);
+void ble_set_adv_address(const uint8_t* address, bool random);
+bool ble_set_adv_data(const uint8_t* data, uint8_t len);
+void ble_set_pdu_type(uint8_t pdu_type);
+void ble_set_channel_code(uint8_t channel, uint32_t lc_code);
+
+uint8_t ble_gen_packet(uint8_t channel);
+bool ble_transmit(uint8_t channel);
+bool ble_advertise(void);
+
+//==== kernels
+uint32_t ble_crc24(const uint8_t* data, uint8_t len, uint32_t init);
+void ble_whiten(uint8_t* data, uint8_t len, uint8_t channel);
+
+#endif
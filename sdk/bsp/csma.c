@@ -0,0 +1,224 @@
+#include "csma.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "scum.h"
+#include "autoack.h"
+#include "ieee_802_15_4.h"
+#include "radio.h"
+#include "rftimer.h"
+
+//=========================== define ==========================================
+
+#define CSMA_RFTIMER_ID 4
+
+//=========================== variables =======================================
+
+typedef struct {
+    csma_config_t config;
+    uint32_t prng_state;
+
+    // Frame being sent
+    uint8_t* packet;
+    uint8_t pkt_len;
+    uint8_t channel;
+    bool ack_request;
+    uint8_t nb;  // number of backoffs for the current attempt
+    uint8_t be;  // backoff exponent
+    uint8_t retries;
+    volatile bool busy;
+    csma_status_t status;
+    csma_done_cbt done_cb;
+} csma_vars_t;
+
+csma_vars_t csma_vars;
+
+//=========================== prototypes ======================================
+
+static uint32_t csma_random(void);
+static void csma_attempt(void);
+static void csma_backoff(void);
+static void csma_finish(csma_status_t status);
+static void cb_csma_backoff_done(void);
+static void cb_csma_cca_done(radio_status_t status);
+static void cb_csma_sent(radio_status_t status);
+static void cb_csma_acked(autoack_status_t status, uint8_t attempts);
+
+//=========================== public ==========================================
+
+// Initialize the unslotted CSMA-CA layer with the IEEE 802.15.4 defaults. seed
+// should differ between motes, e.g. derived from calibration results, so that
+// they draw different backoffs. Frames requesting an ACK rely on the autoack
+// module, which must be initialized as well.
+void csma_init(uint32_t seed) {
+    memset(&csma_vars, 0, sizeof(csma_vars_t));
+
+    csma_vars.config.min_be = CSMA_DEFAULT_MIN_BE;
+    csma_vars.config.max_be = CSMA_DEFAULT_MAX_BE;
+    csma_vars.config.max_backoffs = CSMA_DEFAULT_MAX_BACKOFFS;
+    csma_vars.config.max_retries = CSMA_DEFAULT_MAX_RETRIES;
+    csma_vars.config.cca_threshold = CSMA_DEFAULT_CCA_THRESHOLD;
+
+    // xorshift32 must not be seeded with 0
+    csma_vars.prng_state = seed ^ rftimer_readCounter();
+    if (csma_vars.prng_state == 0) {
+        csma_vars.prng_state = 1;
+    }
+}
+
+void csma_set_config(const csma_config_t* config) {
+    csma_vars.config = *config;
+}
+
+void csma_get_config(csma_config_t* config) { *config = csma_vars.config; }
+
+// Send a frame on the current channel once the channel is assessed clear.
+// Each attempt waits a random number of unit backoff periods in
+// [0, 2^BE - 1] on an RF timer compare, then runs a CCA; a busy channel
+// increases BE up to max_be and the attempt fails after max_backoffs extra
+// backoffs. A frame with the ACK request bit set is sent through the autoack
+// module and, if not acknowledged, retried up to max_retries times, each
+// retry running CSMA-CA again. cb is called from interrupt context. Returns
+// false if a frame is already being sent or the radio is busy.
+bool csma_send_async(void* packet, uint8_t pkt_len, csma_done_cbt cb) {
+    uint8_t* frame = packet;
+
+    if (csma_vars.busy || radio_busy()) {
+        return false;
+    }
+
+    csma_vars.packet = frame;
+    csma_vars.pkt_len = pkt_len;
+    csma_vars.channel = radio_getFrequency();
+    csma_vars.ack_request = (frame[0] & IEEE_802_15_4_FCF_ACK_REQUEST) != 0;
+    csma_vars.retries = 0;
+    csma_vars.done_cb = cb;
+    csma_vars.busy = true;
+
+    rftimer_set_callback_by_id(cb_csma_backoff_done, CSMA_RFTIMER_ID);
+    csma_attempt();
+    return true;
+}
+
+// Blocking wrapper around csma_send_async(); the core sleeps until the frame
+// is sent or dropped.
+csma_status_t csma_send(void* packet, uint8_t pkt_len) {
+    if (!csma_send_async(packet, pkt_len, NULL)) {
+        return CSMA_STATUS_ERROR;
+    }
+
+    radio_wait_while(&csma_vars.busy);
+
+    return csma_vars.status;
+}
+
+bool csma_busy(void) { return csma_vars.busy; }
+
+//=========================== private =========================================
+
+// xorshift32
+static uint32_t csma_random(void) {
+    uint32_t x = csma_vars.prng_state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    csma_vars.prng_state = x;
+    return x;
+}
+
+static void csma_attempt(void) {
+    csma_vars.nb = 0;
+    csma_vars.be = csma_vars.config.min_be;
+    csma_backoff();
+}
+
+// Wait a random number of unit backoff periods before the next CCA
+static void csma_backoff(void) {
+    uint32_t periods = csma_random() & ((1UL << csma_vars.be) - 1);
+
+    if (periods == 0) {
+        cb_csma_backoff_done();
+        return;
+    }
+
+    rftimer_setCompareIn_by_id(
+        rftimer_readCounter() + periods * CSMA_UNIT_BACKOFF_TICKS,
+        CSMA_RFTIMER_ID);
+}
+
+static void csma_finish(csma_status_t status) {
+    csma_done_cbt cb = csma_vars.done_cb;
+
+    csma_vars.status = status;
+    csma_vars.done_cb = NULL;
+    csma_vars.busy = false;
+
+    if (cb != NULL) {
+        cb(status);
+    }
+}
+
+static void cb_csma_backoff_done(void) {
+    rftimer_disable_interrupts_by_id(CSMA_RFTIMER_ID);
+
+    radio_setFrequency(csma_vars.channel, FREQ_RX);
+    if (!radio_cca_async(CSMA_CCA_TICKS, csma_vars.config.cca_threshold,
+                         cb_csma_cca_done)) {
+        csma_finish(CSMA_STATUS_ERROR);
+    }
+}
+
+static void cb_csma_cca_done(radio_status_t status) {
+    uint32_t tx_ticks;
+    bool sent;
+
+    if (status != RADIO_STATUS_CCA_CLEAR) {
+        // Channel busy, or a frame was received meanwhile
+        csma_vars.nb++;
+        if (csma_vars.nb > csma_vars.config.max_backoffs) {
+            csma_finish(CSMA_STATUS_CHANNEL_ACCESS_FAILURE);
+            return;
+        }
+        if (csma_vars.be < csma_vars.config.max_be) {
+            csma_vars.be++;
+        }
+        csma_backoff();
+        return;
+    }
+
+    // Send one turnaround time after the channel was found clear, not after
+    // the software TX start delay of radio_tx_async()
+    tx_ticks = rftimer_readCounter() + CSMA_TURNAROUND_TICKS;
+    if (csma_vars.ack_request) {
+        sent = autoack_tx_at(csma_vars.packet, csma_vars.pkt_len, tx_ticks,
+                             cb_csma_acked);
+    } else {
+        radio_setFrequency(csma_vars.channel, FREQ_TX);
+        radio_loadPacket(csma_vars.packet, csma_vars.pkt_len);
+        radio_txEnable();
+        sent = radio_schedule_tx_at(tx_ticks, cb_csma_sent);
+    }
+    if (!sent) {
+        csma_finish(CSMA_STATUS_ERROR);
+    }
+}
+
+static void cb_csma_sent(radio_status_t status) {
+    csma_finish(CSMA_STATUS_SUCCESS);
+}
+
+static void cb_csma_acked(autoack_status_t status, uint8_t attempts) {
+    if (status == AUTOACK_STATUS_ACKED) {
+        csma_finish(CSMA_STATUS_SUCCESS);
+    } else if (status == AUTOACK_STATUS_NO_ACK &&
+               csma_vars.retries < csma_vars.config.max_retries) {
+        csma_vars.retries++;
+        csma_attempt();
+    } else {
+        csma_finish(status == AUTOACK_STATUS_NO_ACK ? CSMA_STATUS_NO_ACK
+                                                    : CSMA_STATUS_ERROR);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef __CSMA_H
+#define __CSMA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//=========================== define ==========================================
+
+// aUnitBackoffPeriod, 20 symbols = 320 us, in RF timer ticks
+#define CSMA_UNIT_BACKOFF_TICKS 160
+
+// 8-symbol CCA window (128 us) plus ~50 us of LDO settling, in RF timer ticks
+#define CSMA_CCA_TICKS 89
+
+// Delay between a clear CCA and the start of the frame (aTurnaroundTime)
+#define CSMA_TURNAROUND_TICKS 96
+
+// IEEE 802.15.4 defaults
+#define CSMA_DEFAULT_MIN_BE 3
+#define CSMA_DEFAULT_MAX_BE 5
+#define CSMA_DEFAULT_MAX_BACKOFFS 4
+#define CSMA_DEFAULT_MAX_RETRIES 3
+
+// Default CCA energy threshold in dBm, as reported by radio_get_rssi(): 10 dB
+// above the -85 dBm the AGC reports at its highest gain, on an idle channel
+#define CSMA_DEFAULT_CCA_THRESHOLD (-75)
+
+//=========================== typedef =========================================
+
+typedef struct {
+    uint8_t min_be;        // macMinBE
+    uint8_t max_be;        // macMaxBE
+    uint8_t max_backoffs;  // macMaxCSMABackoffs (NB limit)
+    uint8_t max_retries;   // macMaxFrameRetries
+    int8_t cca_threshold;  // dBm
+} csma_config_t;
+
+typedef enum {
+    CSMA_STATUS_SUCCESS = 0x01,  // sent, and acknowledged if requested
+    CSMA_STATUS_NO_ACK = 0x02,
+    CSMA_STATUS_CHANNEL_ACCESS_FAILURE = 0x03,
+    CSMA_STATUS_ERROR = 0x04,
+} csma_status_t;
+
+typedef void (*csma_done_cbt)(csma_status_t status);
+
+//=========================== prototypes ======================================
+
+void csma_init(uint32_t seed);
+void csma_set_config(const csma_config_t* config);
+void csma_get_config(csma_config_t* config);
+
+bool csma_send_async(void* packet, uint8_t pkt_len, csma_done_cbt cb);
+csma_status_t csma_send(void* packet, uint8_t pkt_len);
+bool csma_busy(void);
+
+#endif
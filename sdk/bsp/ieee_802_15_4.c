@@ -2,8 +2,302 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+
+// Length of the FCS at the end of a frame.
+#define IEEE_802_15_4_FCS_LENGTH 2
+
+// Length of the key identifier field by key identifier mode.
+static const uint8_t ieee_802_15_4_key_id_lengths[4] = {0, 1, 5, 9};
+
+static uint8_t ieee_802_15_4_addr_length(const uint8_t mode) {
+    if (mode == IEEE_802_15_4_ADDR_MODE_SHORT) {
+        return IEEE_802_15_4_SHORT_ADDR_LENGTH;
+    }
+    if (mode == IEEE_802_15_4_ADDR_MODE_EXTENDED) {
+        return IEEE_802_15_4_EXT_ADDR_LENGTH;
+    }
+    return 0;
+}
+
+// Presence of the PAN ID fields for the addressing modes and the PAN ID
+// compression bit (IEEE 802.15.4-2015, table 7-2 for frame version 2).
+void ieee_802_15_4_pan_ids_present(ieee_802_15_4_frame_t* view) {
+    const bool dst = view->dst_addr_mode != IEEE_802_15_4_ADDR_MODE_NONE;
+    const bool src = view->src_addr_mode != IEEE_802_15_4_ADDR_MODE_NONE;
+    const bool panc = view->pan_id_compression;
+
+    if (view->frame_version != IEEE_802_15_4_FRAME_VERSION_2015) {
+        view->dst_pan_id_present = dst;
+        view->src_pan_id_present = src && !(panc && dst);
+    } else if (!dst && !src) {
+        view->dst_pan_id_present = panc;
+        view->src_pan_id_present = false;
+    } else if (!src) {
+        view->dst_pan_id_present = !panc;
+        view->src_pan_id_present = false;
+    } else if (!dst) {
+        view->dst_pan_id_present = false;
+        view->src_pan_id_present = !panc;
+    } else if (view->dst_addr_mode == IEEE_802_15_4_ADDR_MODE_EXTENDED &&
+               view->src_addr_mode == IEEE_802_15_4_ADDR_MODE_EXTENDED) {
+        view->dst_pan_id_present = !panc;
+        view->src_pan_id_present = false;
+    } else {
+        view->dst_pan_id_present = true;
+        view->src_pan_id_present = !panc;
+    }
+}
+
+static uint16_t ieee_802_15_4_read_u16(const uint8_t* buffer) {
+    return buffer[0] | (buffer[1] << 8);
+}
+
+static void ieee_802_15_4_write_u16(uint8_t* buffer, const uint16_t value) {
+    buffer[0] = value & 0xFF;
+    buffer[1] = value >> 8;
+}
 
 bool ieee_802_15_4_validate_channel(const uint8_t channel) {
     return channel >= IEEE_802_15_4_MIN_CHANNEL &&
            channel <= IEEE_802_15_4_MAX_CHANNEL;
 }
+
+bool ieee_802_15_4_parse(const uint8_t* frame, const uint8_t length,
+                         ieee_802_15_4_frame_t* view) {
+    // Header and payload end before the FCS.
+    const uint8_t end = length - IEEE_802_15_4_FCS_LENGTH;
+    uint16_t fcf;
+    uint16_t descriptor;
+    uint8_t index = 2;
+    uint8_t dst_addr_length;
+    uint8_t src_addr_length;
+    uint8_t security_control;
+
+    if (length < IEEE_802_15_4_FCS_LENGTH + 2) {
+        return false;
+    }
+
+    fcf = ieee_802_15_4_read_u16(frame);
+    view->frame_type = fcf & IEEE_802_15_4_FCF_FRAME_TYPE_MASK;
+    view->frame_version = (fcf >> IEEE_802_15_4_FCF_FRAME_VERSION_SHIFT) &
+                          IEEE_802_15_4_FCF_FIELD_MASK;
+    view->security_enabled = (fcf & IEEE_802_15_4_FCF_SECURITY_ENABLED) != 0;
+    view->frame_pending = (fcf & IEEE_802_15_4_FCF_FRAME_PENDING) != 0;
+    view->ack_request = (fcf & IEEE_802_15_4_FCF_ACK_REQUEST) != 0;
+    view->pan_id_compression =
+        (fcf & IEEE_802_15_4_FCF_PAN_ID_COMPRESSION) != 0;
+    view->seq_num_present =
+        view->frame_version != IEEE_802_15_4_FRAME_VERSION_2015 ||
+        (fcf & IEEE_802_15_4_FCF_SEQ_NUM_SUPPRESSION) == 0;
+    view->ie_present = view->frame_version ==
+                           IEEE_802_15_4_FRAME_VERSION_2015 &&
+                       (fcf & IEEE_802_15_4_FCF_IE_PRESENT) != 0;
+    view->dst_addr_mode = (fcf >> IEEE_802_15_4_FCF_DST_ADDR_MODE_SHIFT) &
+                          IEEE_802_15_4_FCF_FIELD_MASK;
+    view->src_addr_mode = (fcf >> IEEE_802_15_4_FCF_SRC_ADDR_MODE_SHIFT) &
+                          IEEE_802_15_4_FCF_FIELD_MASK;
+
+    // Addressing mode 1 is reserved.
+    dst_addr_length = ieee_802_15_4_addr_length(view->dst_addr_mode);
+    src_addr_length = ieee_802_15_4_addr_length(view->src_addr_mode);
+    if ((view->dst_addr_mode != IEEE_802_15_4_ADDR_MODE_NONE &&
+         dst_addr_length == 0) ||
+        (view->src_addr_mode != IEEE_802_15_4_ADDR_MODE_NONE &&
+         src_addr_length == 0)) {
+        return false;
+    }
+    ieee_802_15_4_pan_ids_present(view);
+
+    if (index + view->seq_num_present +
+            (view->dst_pan_id_present + view->src_pan_id_present) *
+                IEEE_802_15_4_SHORT_ADDR_LENGTH +
+            dst_addr_length + src_addr_length >
+        end) {
+        return false;
+    }
+
+    view->seq_num = 0;
+    if (view->seq_num_present) {
+        view->seq_num = frame[index++];
+    }
+
+    view->dst_pan_id = 0;
+    if (view->dst_pan_id_present) {
+        view->dst_pan_id = ieee_802_15_4_read_u16(&frame[index]);
+        index += IEEE_802_15_4_SHORT_ADDR_LENGTH;
+    }
+    view->dst_addr = dst_addr_length ? &frame[index] : NULL;
+    view->dst_short_addr = 0;
+    if (view->dst_addr_mode == IEEE_802_15_4_ADDR_MODE_SHORT) {
+        view->dst_short_addr = ieee_802_15_4_read_u16(&frame[index]);
+    }
+    index += dst_addr_length;
+
+    view->src_pan_id = view->dst_pan_id;
+    if (view->src_pan_id_present) {
+        view->src_pan_id = ieee_802_15_4_read_u16(&frame[index]);
+        index += IEEE_802_15_4_SHORT_ADDR_LENGTH;
+    }
+    view->src_addr = src_addr_length ? &frame[index] : NULL;
+    view->src_short_addr = 0;
+    if (view->src_addr_mode == IEEE_802_15_4_ADDR_MODE_SHORT) {
+        view->src_short_addr = ieee_802_15_4_read_u16(&frame[index]);
+    }
+    index += src_addr_length;
+
+    // Auxiliary security header: security control, frame counter and key
+    // identifier.
+    view->aux_security = NULL;
+    view->aux_security_length = 0;
+    if (view->security_enabled) {
+        if (index >= end) {
+            return false;
+        }
+        security_control = frame[index];
+        view->aux_security_length =
+            1 +
+            ieee_802_15_4_key_id_lengths
+                [(security_control >> IEEE_802_15_4_SEC_KEY_ID_MODE_SHIFT) &
+                 IEEE_802_15_4_FCF_FIELD_MASK];
+        if (view->frame_version != IEEE_802_15_4_FRAME_VERSION_2015 ||
+            !(security_control & IEEE_802_15_4_SEC_FRAME_COUNTER_SUPPRESSION)) {
+            view->aux_security_length += 4;
+        }
+        if (index + view->aux_security_length > end) {
+            return false;
+        }
+        view->aux_security = &frame[index];
+        index += view->aux_security_length;
+    }
+
+    // Header IEs, up to a termination IE or the end of the frame.
+    view->header_ie = NULL;
+    view->header_ie_length = 0;
+    if (view->ie_present) {
+        view->header_ie = &frame[index];
+        while (index + 2 <= end) {
+            descriptor = ieee_802_15_4_read_u16(&frame[index]);
+            if (descriptor & IEEE_802_15_4_IE_TYPE_PAYLOAD) {
+                return false;
+            }
+            index += 2 + (descriptor & IEEE_802_15_4_IE_LENGTH_MASK);
+            if (index > end) {
+                return false;
+            }
+            descriptor = (descriptor >> IEEE_802_15_4_IE_ELEMENT_ID_SHIFT) &
+                         IEEE_802_15_4_IE_ELEMENT_ID_MASK;
+            if (descriptor == IEEE_802_15_4_HEADER_IE_TERMINATION_1 ||
+                descriptor == IEEE_802_15_4_HEADER_IE_TERMINATION_2) {
+                break;
+            }
+        }
+        view->header_ie_length = index - (view->header_ie - frame);
+    }
+
+    view->payload = &frame[index];
+    view->payload_offset = index;
+    view->payload_length = end - index;
+    return true;
+}
+
+uint8_t ieee_802_15_4_build_header(uint8_t* buffer,
+                                   const ieee_802_15_4_frame_t* header) {
+    ieee_802_15_4_frame_t fields = *header;
+    const uint8_t dst_addr_length =
+        ieee_802_15_4_addr_length(header->dst_addr_mode);
+    const uint8_t src_addr_length =
+        ieee_802_15_4_addr_length(header->src_addr_mode);
+    uint16_t fcf;
+    uint8_t index = 2;
+
+    // Compress the source PAN ID away whenever both PAN IDs are equal; the
+    // 2015 rules also drop the destination PAN ID of frames without source
+    // address. 2015 frames between extended addresses carry a single PAN ID,
+    // which compression would drop as well.
+    fields.pan_id_compression =
+        header->dst_addr_mode != IEEE_802_15_4_ADDR_MODE_NONE &&
+        header->src_addr_mode != IEEE_802_15_4_ADDR_MODE_NONE &&
+        header->dst_pan_id == header->src_pan_id &&
+        !(header->frame_version == IEEE_802_15_4_FRAME_VERSION_2015 &&
+          header->dst_addr_mode == IEEE_802_15_4_ADDR_MODE_EXTENDED &&
+          header->src_addr_mode == IEEE_802_15_4_ADDR_MODE_EXTENDED);
+    ieee_802_15_4_pan_ids_present(&fields);
+
+    fcf = (header->frame_type & IEEE_802_15_4_FCF_FRAME_TYPE_MASK) |
+          ((header->frame_version & IEEE_802_15_4_FCF_FIELD_MASK)
+           << IEEE_802_15_4_FCF_FRAME_VERSION_SHIFT) |
+          (header->dst_addr_mode << IEEE_802_15_4_FCF_DST_ADDR_MODE_SHIFT) |
+          (header->src_addr_mode << IEEE_802_15_4_FCF_SRC_ADDR_MODE_SHIFT);
+    if (header->aux_security != NULL) {
+        fcf |= IEEE_802_15_4_FCF_SECURITY_ENABLED;
+    }
+    if (header->frame_pending) {
+        fcf |= IEEE_802_15_4_FCF_FRAME_PENDING;
+    }
+    if (header->ack_request) {
+        fcf |= IEEE_802_15_4_FCF_ACK_REQUEST;
+    }
+    if (fields.pan_id_compression) {
+        fcf |= IEEE_802_15_4_FCF_PAN_ID_COMPRESSION;
+    }
+    if (header->frame_version == IEEE_802_15_4_FRAME_VERSION_2015) {
+        if (!header->seq_num_present) {
+            fcf |= IEEE_802_15_4_FCF_SEQ_NUM_SUPPRESSION;
+        }
+        if (header->header_ie != NULL) {
+            fcf |= IEEE_802_15_4_FCF_IE_PRESENT;
+        }
+    }
+    ieee_802_15_4_write_u16(buffer, fcf);
+
+    if (header->frame_version != IEEE_802_15_4_FRAME_VERSION_2015 ||
+        header->seq_num_present) {
+        buffer[index++] = header->seq_num;
+    }
+
+    if (fields.dst_pan_id_present) {
+        ieee_802_15_4_write_u16(&buffer[index], header->dst_pan_id);
+        index += IEEE_802_15_4_SHORT_ADDR_LENGTH;
+    }
+    if (header->dst_addr_mode == IEEE_802_15_4_ADDR_MODE_SHORT) {
+        ieee_802_15_4_write_u16(&buffer[index], header->dst_short_addr);
+    } else if (dst_addr_length) {
+        memcpy(&buffer[index], header->dst_addr, dst_addr_length);
+    }
+    index += dst_addr_length;
+
+    if (fields.src_pan_id_present) {
+        ieee_802_15_4_write_u16(&buffer[index], header->src_pan_id);
+        index += IEEE_802_15_4_SHORT_ADDR_LENGTH;
+    }
+    if (header->src_addr_mode == IEEE_802_15_4_ADDR_MODE_SHORT) {
+        ieee_802_15_4_write_u16(&buffer[index], header->src_short_addr);
+    } else if (src_addr_length) {
+        memcpy(&buffer[index], header->src_addr, src_addr_length);
+    }
+    index += src_addr_length;
+
+    if (header->aux_security != NULL) {
+        memcpy(&buffer[index], header->aux_security,
+               header->aux_security_length);
+        index += header->aux_security_length;
+    }
+    if (header->frame_version == IEEE_802_15_4_FRAME_VERSION_2015 &&
+        header->header_ie != NULL) {
+        memcpy(&buffer[index], header->header_ie, header->header_ie_length);
+        index += header->header_ie_length;
+    }
+    return index;
+}
+
+uint8_t ieee_802_15_4_build_ack(uint8_t* buffer, const uint8_t seq_num,
+                                const bool frame_pending) {
+    buffer[0] = IEEE_802_15_4_FRAME_TYPE_ACK;
+    if (frame_pending) {
+        buffer[0] |= IEEE_802_15_4_FCF_FRAME_PENDING;
+    }
+    buffer[1] = 0;
+    buffer[IEEE_802_15_4_SEQ_NUM_OFFSET] = seq_num;
+    return IEEE_802_15_4_ACK_LENGTH;
+}
@@ -13,7 +13,127 @@
 // Maximum 802.15.4 channel.
 #define IEEE_802_15_4_MAX_CHANNEL 26
 
+// Frame control field, first two bytes of the MAC header (little endian).
+#define IEEE_802_15_4_FCF_FRAME_TYPE_MASK 0x0007
+#define IEEE_802_15_4_FCF_SECURITY_ENABLED 0x0008
+#define IEEE_802_15_4_FCF_FRAME_PENDING 0x0010
+#define IEEE_802_15_4_FCF_ACK_REQUEST 0x0020
+#define IEEE_802_15_4_FCF_PAN_ID_COMPRESSION 0x0040
+#define IEEE_802_15_4_FCF_SEQ_NUM_SUPPRESSION 0x0100
+#define IEEE_802_15_4_FCF_IE_PRESENT 0x0200
+#define IEEE_802_15_4_FCF_DST_ADDR_MODE_SHIFT 10
+#define IEEE_802_15_4_FCF_FRAME_VERSION_SHIFT 12
+#define IEEE_802_15_4_FCF_SRC_ADDR_MODE_SHIFT 14
+#define IEEE_802_15_4_FCF_FIELD_MASK 0x3
+
+// Addressing modes.
+#define IEEE_802_15_4_ADDR_MODE_NONE 0x0
+#define IEEE_802_15_4_ADDR_MODE_SHORT 0x2
+#define IEEE_802_15_4_ADDR_MODE_EXTENDED 0x3
+
+// Frame versions.
+#define IEEE_802_15_4_FRAME_VERSION_2003 0x0
+#define IEEE_802_15_4_FRAME_VERSION_2006 0x1
+#define IEEE_802_15_4_FRAME_VERSION_2015 0x2
+
+// Broadcast PAN ID and short address.
+#define IEEE_802_15_4_BROADCAST_PAN_ID 0xFFFF
+#define IEEE_802_15_4_BROADCAST_ADDR 0xFFFF
+
+// Bytes on the air besides the PHY payload: preamble, SFD and PHY header.
+#define IEEE_802_15_4_PHY_OVERHEAD 6
+
+// Air time of one byte at 250 kbps, 32 us, in RF timer ticks.
+#define IEEE_802_15_4_BYTE_TICKS 16
+
+// Length of an extended address.
+#define IEEE_802_15_4_EXT_ADDR_LENGTH 8
+
+// Length of a short address or PAN ID.
+#define IEEE_802_15_4_SHORT_ADDR_LENGTH 2
+
+// Auxiliary security header, security control field.
+#define IEEE_802_15_4_SEC_LEVEL_MASK 0x07
+#define IEEE_802_15_4_SEC_KEY_ID_MODE_SHIFT 3
+#define IEEE_802_15_4_SEC_FRAME_COUNTER_SUPPRESSION 0x20
+
+// Header IE descriptor.
+#define IEEE_802_15_4_IE_LENGTH_MASK 0x007F
+#define IEEE_802_15_4_IE_ELEMENT_ID_SHIFT 7
+#define IEEE_802_15_4_IE_ELEMENT_ID_MASK 0x00FF
+#define IEEE_802_15_4_IE_TYPE_PAYLOAD 0x8000
+#define IEEE_802_15_4_HEADER_IE_TERMINATION_1 0x7E
+#define IEEE_802_15_4_HEADER_IE_TERMINATION_2 0x7F
+
+// View of a MAC frame, decoded in place: the pointers refer to the buffer
+// passed to ieee_802_15_4_parse(). The same structure describes the header
+// to write with ieee_802_15_4_build_header().
+typedef struct {
+    uint8_t frame_type;
+    uint8_t frame_version;
+    bool security_enabled;
+    bool frame_pending;
+    bool ack_request;
+    bool pan_id_compression;
+    bool seq_num_present;
+    bool ie_present;
+    uint8_t seq_num;
+
+    uint8_t dst_addr_mode;
+    uint8_t src_addr_mode;
+    bool dst_pan_id_present;
+    bool src_pan_id_present;
+    uint16_t dst_pan_id;
+    uint16_t src_pan_id;  // dst_pan_id if compressed away
+    const uint8_t* dst_addr;  // over-the-air (little endian) order
+    const uint8_t* src_addr;
+    uint16_t dst_short_addr;  // when dst_addr_mode is short
+    uint16_t src_short_addr;
+
+    const uint8_t* aux_security;  // NULL if security is disabled
+    uint8_t aux_security_length;
+    const uint8_t* header_ie;  // NULL if there are no header IEs
+    uint8_t header_ie_length;  // termination IE included
+
+    const uint8_t* payload;  // payload IEs included
+    uint8_t payload_offset;
+    uint8_t payload_length;  // FCS excluded
+} ieee_802_15_4_frame_t;
+
+// Frame types.
+#define IEEE_802_15_4_FRAME_TYPE_BEACON 0x0
+#define IEEE_802_15_4_FRAME_TYPE_DATA 0x1
+#define IEEE_802_15_4_FRAME_TYPE_ACK 0x2
+#define IEEE_802_15_4_FRAME_TYPE_COMMAND 0x3
+
+// Offset of the sequence number in the MAC header.
+#define IEEE_802_15_4_SEQ_NUM_OFFSET 2
+
+// Length of an immediate acknowledgment frame, including the 2-byte FCS.
+#define IEEE_802_15_4_ACK_LENGTH 5
+
 // Validate the channel.
 bool ieee_802_15_4_validate_channel(uint8_t channel);
 
+// Decode the MAC frame of length bytes (the PHY length, FCS included) at
+// frame into view. Returns false if the frame is truncated or uses a reserved
+// addressing mode.
+bool ieee_802_15_4_parse(const uint8_t* frame, uint8_t length,
+                         ieee_802_15_4_frame_t* view);
+
+// Set dst_pan_id_present and src_pan_id_present from the frame version, the
+// addressing modes and the PAN ID compression bit of view.
+void ieee_802_15_4_pan_ids_present(ieee_802_15_4_frame_t* view);
+
+// Write the MAC header described by header into buffer and return its length,
+// i.e. the offset of the payload. The frame control field is derived from the
+// header fields, PAN ID compression included.
+uint8_t ieee_802_15_4_build_header(uint8_t* buffer,
+                                   const ieee_802_15_4_frame_t* header);
+
+// Write an immediate acknowledgment into buffer and return its length,
+// FCS included.
+uint8_t ieee_802_15_4_build_ack(uint8_t* buffer, uint8_t seq_num,
+                                bool frame_pending);
+
 #endif  // __IEEE_802_15_4_H
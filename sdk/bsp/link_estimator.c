@@ -0,0 +1,310 @@
+#include "link_estimator.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "scum.h"
+#include "ieee_802_15_4.h"
+#include "neighbor_table.h"
+#include "rftimer.h"
+
+//=========================== variables =======================================
+
+typedef struct {
+    neighbor_table_entry_t entry;
+    link_estimate_t overall;  // all channels together
+    link_estimate_t channels[IEEE_802_15_4_NUM_CHANNELS];
+} link_estimator_neighbor_t;
+
+// Delivery ratio of a channel over all neighbors
+typedef struct {
+    uint16_t delivery;
+    uint16_t samples;
+    bool blacklisted;
+    uint32_t retry_at;  // RF timer count at which it is tried again
+} link_estimator_channel_t;
+
+typedef struct {
+    link_estimator_neighbor_t neighbors[LINK_ESTIMATOR_MAX_NEIGHBORS];
+    neighbor_table_t table;
+    link_estimator_channel_t channels[IEEE_802_15_4_NUM_CHANNELS];
+    uint16_t blacklist_threshold;
+    uint32_t blacklist_timeout;
+    link_estimator_stats_t stats;
+} link_estimator_vars_t;
+
+link_estimator_vars_t link_estimator_vars;
+
+//=========================== prototypes ======================================
+
+static link_estimator_neighbor_t* link_estimator_add(uint16_t addr);
+static int32_t link_estimator_ewma(int32_t average, int32_t sample);
+static void link_estimator_update_rx(link_estimate_t* estimate, int8_t rssi,
+                                     uint8_t lqi);
+static void link_estimator_update_tx(link_estimate_t* estimate,
+                                     uint16_t delivery, uint16_t etx);
+static void link_estimator_update_channel(uint8_t index, uint16_t delivery);
+static bool link_estimator_usable(uint8_t index);
+
+//=========================== public ==========================================
+
+void link_estimator_init(void) {
+    uint8_t i;
+
+    memset(&link_estimator_vars, 0, sizeof(link_estimator_vars_t));
+    neighbor_table_init(&link_estimator_vars.table,
+                        link_estimator_vars.neighbors,
+                        LINK_ESTIMATOR_MAX_NEIGHBORS,
+                        sizeof(link_estimator_neighbor_t));
+
+    for (i = 0; i < IEEE_802_15_4_NUM_CHANNELS; i++) {
+        link_estimator_vars.channels[i].delivery = LINK_ESTIMATOR_ONE;
+    }
+    link_estimator_vars.blacklist_threshold =
+        LINK_ESTIMATOR_DEFAULT_BLACKLIST_THRESHOLD;
+    link_estimator_vars.blacklist_timeout =
+        LINK_ESTIMATOR_DEFAULT_BLACKLIST_TIMEOUT;
+}
+
+// Blacklist the channels whose delivery ratio drops under threshold
+// (LINK_ESTIMATOR_ONE is 100%) for timeout RF timer ticks. A threshold of 0
+// disables blacklisting and clears the blacklist.
+void link_estimator_set_blacklist(uint16_t threshold, uint32_t timeout) {
+    uint8_t i;
+
+    __disable_irq();
+    link_estimator_vars.blacklist_threshold = threshold;
+    link_estimator_vars.blacklist_timeout = timeout;
+    if (threshold == 0) {
+        for (i = 0; i < IEEE_802_15_4_NUM_CHANNELS; i++) {
+            link_estimator_vars.channels[i].blacklisted = false;
+        }
+    }
+    __enable_irq();
+}
+
+// Feed the RSSI (dBm) and LQI of a frame received from neighbor addr on
+// channel. May be called from interrupt context.
+void link_estimator_report_rx(uint16_t addr, uint8_t channel, int8_t rssi,
+                              uint8_t lqi) {
+    link_estimator_neighbor_t* neighbor;
+
+    __disable_irq();
+    neighbor = link_estimator_add(addr);
+    link_estimator_update_rx(&neighbor->overall, rssi, lqi);
+    if (ieee_802_15_4_validate_channel(channel)) {
+        link_estimator_update_rx(
+            &neighbor->channels[channel - IEEE_802_15_4_MIN_CHANNEL], rssi,
+            lqi);
+    }
+    __enable_irq();
+}
+
+// Feed the outcome of a frame sent to neighbor addr on channel: the number
+// of transmissions it took, retries included, and whether it was finally
+// acknowledged. Updates the delivery ratio and ETX of the link and the
+// delivery ratio of the channel, which is blacklisted if it falls under the
+// threshold. The last usable channel is never blacklisted. May be called
+// from interrupt context.
+void link_estimator_report_tx(uint16_t addr, uint8_t channel,
+                              uint8_t attempts, bool acked) {
+    link_estimator_neighbor_t* neighbor;
+    uint16_t delivery = 0;
+    uint16_t etx = LINK_ESTIMATOR_ETX_MAX;
+    uint8_t index;
+
+    if (attempts == 0) {
+        attempts = 1;
+    }
+    if (acked) {
+        delivery = LINK_ESTIMATOR_ONE / attempts;
+        if (attempts < LINK_ESTIMATOR_ETX_MAX / LINK_ESTIMATOR_ONE) {
+            etx = attempts * LINK_ESTIMATOR_ONE;
+        }
+    }
+
+    __disable_irq();
+    neighbor = link_estimator_add(addr);
+    link_estimator_update_tx(&neighbor->overall, delivery, etx);
+    if (ieee_802_15_4_validate_channel(channel)) {
+        index = channel - IEEE_802_15_4_MIN_CHANNEL;
+        link_estimator_update_tx(&neighbor->channels[index], delivery, etx);
+        link_estimator_update_channel(index, delivery);
+    }
+    __enable_irq();
+}
+
+// Estimate of the link to neighbor addr on channel. Returns false if the
+// neighbor is unknown or the channel out of range.
+bool link_estimator_get_link(uint16_t addr, uint8_t channel,
+                             link_estimate_t* estimate) {
+    link_estimator_neighbor_t* neighbor;
+
+    if (!ieee_802_15_4_validate_channel(channel)) {
+        return false;
+    }
+
+    __disable_irq();
+    neighbor = neighbor_table_find(&link_estimator_vars.table, addr);
+    if (neighbor != NULL) {
+        *estimate = neighbor->channels[channel - IEEE_802_15_4_MIN_CHANNEL];
+    }
+    __enable_irq();
+    return neighbor != NULL;
+}
+
+// Estimate of the link to neighbor addr over all channels. Returns false if
+// the neighbor is unknown.
+bool link_estimator_get_neighbor(uint16_t addr, link_estimate_t* estimate) {
+    link_estimator_neighbor_t* neighbor;
+
+    __disable_irq();
+    neighbor = neighbor_table_find(&link_estimator_vars.table, addr);
+    if (neighbor != NULL) {
+        *estimate = neighbor->overall;
+    }
+    __enable_irq();
+    return neighbor != NULL;
+}
+
+// Whether channel is worth transmitting on, i.e. not blacklisted
+bool link_estimator_channel_usable(uint8_t channel) {
+    bool usable;
+
+    if (!ieee_802_15_4_validate_channel(channel)) {
+        return false;
+    }
+
+    __disable_irq();
+    usable = link_estimator_usable(channel - IEEE_802_15_4_MIN_CHANNEL);
+    __enable_irq();
+    return usable;
+}
+
+// Usable channels, bit 0 for channel 11 to bit 15 for channel 26, e.g. to
+// skip the blacklisted channels of a hopping sequence
+uint16_t link_estimator_get_channel_mask(void) {
+    uint16_t mask = 0;
+    uint8_t i;
+
+    __disable_irq();
+    for (i = 0; i < IEEE_802_15_4_NUM_CHANNELS; i++) {
+        if (link_estimator_usable(i)) {
+            mask |= 1 << i;
+        }
+    }
+    __enable_irq();
+    return mask;
+}
+
+void link_estimator_get_stats(link_estimator_stats_t* stats) {
+    __disable_irq();
+    *stats = link_estimator_vars.stats;
+    __enable_irq();
+}
+
+void link_estimator_reset_stats(void) {
+    __disable_irq();
+    memset(&link_estimator_vars.stats, 0, sizeof(link_estimator_stats_t));
+    __enable_irq();
+}
+
+//=========================== private =========================================
+
+// Entry of neighbor addr, taking the one of the least recently used neighbor
+// if the table is full
+static link_estimator_neighbor_t* link_estimator_add(uint16_t addr) {
+    link_estimator_neighbor_t* neighbor;
+    neighbor_table_result_t result;
+
+    neighbor = neighbor_table_add(&link_estimator_vars.table, addr, &result);
+    if (result == NEIGHBOR_TABLE_EVICTED) {
+        link_estimator_vars.stats.evictions++;
+    }
+    return neighbor;
+}
+
+static int32_t link_estimator_ewma(int32_t average, int32_t sample) {
+    return average + (sample - average) / (1 << LINK_ESTIMATOR_EWMA_SHIFT);
+}
+
+// The first sample of an estimate is taken as is
+static void link_estimator_update_rx(link_estimate_t* estimate, int8_t rssi,
+                                     uint8_t lqi) {
+    if (estimate->rx_frames == 0) {
+        estimate->rssi = rssi * LINK_ESTIMATOR_ONE;
+        estimate->lqi = lqi * LINK_ESTIMATOR_ONE;
+    } else {
+        estimate->rssi = link_estimator_ewma(estimate->rssi,
+                                             rssi * LINK_ESTIMATOR_ONE);
+        estimate->lqi =
+            link_estimator_ewma(estimate->lqi, lqi * LINK_ESTIMATOR_ONE);
+    }
+    if (estimate->rx_frames < UINT16_MAX) {
+        estimate->rx_frames++;
+    }
+}
+
+static void link_estimator_update_tx(link_estimate_t* estimate,
+                                     uint16_t delivery, uint16_t etx) {
+    if (estimate->tx_frames == 0) {
+        estimate->delivery = delivery;
+        estimate->etx = etx;
+    } else {
+        estimate->delivery = link_estimator_ewma(estimate->delivery, delivery);
+        estimate->etx = link_estimator_ewma(estimate->etx, etx);
+    }
+    if (estimate->tx_frames < UINT16_MAX) {
+        estimate->tx_frames++;
+    }
+}
+
+// Update the delivery ratio of a channel and blacklist it once it has been
+// tried enough and is under the threshold
+static void link_estimator_update_channel(uint8_t index, uint16_t delivery) {
+    link_estimator_channel_t* channel = &link_estimator_vars.channels[index];
+    uint8_t usable = 0;
+    uint8_t i;
+
+    if (!link_estimator_usable(index)) {
+        return;
+    }
+
+    channel->delivery = link_estimator_ewma(channel->delivery, delivery);
+    if (channel->samples < LINK_ESTIMATOR_MIN_SAMPLES) {
+        channel->samples++;
+        return;
+    }
+
+    if (channel->delivery >= link_estimator_vars.blacklist_threshold) {
+        return;
+    }
+    for (i = 0; i < IEEE_802_15_4_NUM_CHANNELS; i++) {
+        if (link_estimator_usable(i)) {
+            usable++;
+        }
+    }
+    if (usable > 1) {
+        channel->blacklisted = true;
+        channel->retry_at =
+            rftimer_readCounter() + link_estimator_vars.blacklist_timeout;
+        link_estimator_vars.stats.blacklisted++;
+    }
+}
+
+// Whether a channel is usable, taking it off the blacklist once its timeout
+// has expired. It then starts over as a perfect channel, so that it gets
+// LINK_ESTIMATOR_MIN_SAMPLES frames before it can be blacklisted again.
+static bool link_estimator_usable(uint8_t index) {
+    link_estimator_channel_t* channel = &link_estimator_vars.channels[index];
+
+    if (channel->blacklisted &&
+        (int32_t)(rftimer_readCounter() - channel->retry_at) >= 0) {
+        channel->blacklisted = false;
+        channel->delivery = LINK_ESTIMATOR_ONE;
+        channel->samples = 0;
+        link_estimator_vars.stats.retried++;
+    }
+    return !channel->blacklisted;
+}
@@ -0,0 +1,70 @@
+#ifndef __LINK_ESTIMATOR_H
+#define __LINK_ESTIMATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//=========================== define ==========================================
+
+// Number of neighbors tracked; the least recently used one is evicted
+#ifndef LINK_ESTIMATOR_MAX_NEIGHBORS
+#define LINK_ESTIMATOR_MAX_NEIGHBORS 8
+#endif
+
+// Estimates are fixed-point with 8 fractional bits: 256 is 1.0
+#define LINK_ESTIMATOR_ONE 256
+
+// Each new sample weighs 1/2^LINK_ESTIMATOR_EWMA_SHIFT in the averages
+#define LINK_ESTIMATOR_EWMA_SHIFT 3
+
+// ETX of a frame that was never acknowledged, and upper bound of the ETX
+#define LINK_ESTIMATOR_ETX_MAX (8 * LINK_ESTIMATOR_ONE)
+
+// Default channel blacklisting: a channel whose delivery ratio, over all
+// neighbors, drops under 50% is avoided for 30 s (RF timer ticks) before it
+// is tried again
+#define LINK_ESTIMATOR_DEFAULT_BLACKLIST_THRESHOLD (LINK_ESTIMATOR_ONE / 2)
+#define LINK_ESTIMATOR_DEFAULT_BLACKLIST_TIMEOUT 15000000
+
+// Frames sent on a channel before its delivery ratio is trusted
+#define LINK_ESTIMATOR_MIN_SAMPLES 8
+
+//=========================== typedef =========================================
+
+// Link quality estimate, fixed-point with 8 fractional bits
+typedef struct {
+    int16_t rssi;        // dBm
+    uint16_t lqi;        // as in radio_rx_slot_t
+    uint16_t delivery;   // acknowledged frames per transmission
+    uint16_t etx;        // transmissions per acknowledged frame
+    uint16_t rx_frames;  // frames received, saturated
+    uint16_t tx_frames;  // frames sent, saturated
+} link_estimate_t;
+
+typedef struct {
+    uint32_t blacklisted;  // channels blacklisted
+    uint32_t retried;      // blacklisted channels tried again
+    uint32_t evictions;    // neighbors evicted to make room for new ones
+} link_estimator_stats_t;
+
+//=========================== prototypes ======================================
+
+void link_estimator_init(void);
+void link_estimator_set_blacklist(uint16_t threshold, uint32_t timeout);
+
+void link_estimator_report_rx(uint16_t addr, uint8_t channel, int8_t rssi,
+                              uint8_t lqi);
+void link_estimator_report_tx(uint16_t addr, uint8_t channel,
+                              uint8_t attempts, bool acked);
+
+bool link_estimator_get_link(uint16_t addr, uint8_t channel,
+                             link_estimate_t* estimate);
+bool link_estimator_get_neighbor(uint16_t addr, link_estimate_t* estimate);
+
+bool link_estimator_channel_usable(uint8_t channel);
+uint16_t link_estimator_get_channel_mask(void);
+
+void link_estimator_get_stats(link_estimator_stats_t* stats);
+void link_estimator_reset_stats(void);
+
+#endif
@@ -0,0 +1,309 @@
+#include "lpl.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "scum.h"
+#include "autoack.h"
+#include "ieee_802_15_4.h"
+#include "radio.h"
+#include "rftimer.h"
+
+//=========================== define ==========================================
+
+#define LPL_RFTIMER_ID 4
+
+// Longest compare set at once. Longer wake-up intervals are reached in steps,
+// as rftimer_setCompareIn_by_id() treats values more than 0xffff ticks ahead
+// as being in the past.
+#define LPL_TIMER_MAX_STEP_TICKS 0x8000
+
+//=========================== variables =======================================
+
+typedef struct {
+    uint32_t wake_interval;
+    int8_t cca_threshold;
+    bool running;
+    uint32_t next_wake;
+
+    // Frame being strobed
+    uint8_t* packet;
+    uint8_t pkt_len;
+    uint8_t channel;
+    bool ack_request;
+    uint32_t strobe_end;
+    volatile bool busy;
+    lpl_status_t status;
+    lpl_done_cbt done_cb;
+
+    // Energy accounting
+    uint32_t on_start;
+    uint64_t radio_on_ticks;
+    uint64_t elapsed_ticks;
+    uint32_t elapsed_start;
+    uint32_t wakeups;
+    uint32_t strobes;
+} lpl_vars_t;
+
+lpl_vars_t lpl_vars;
+
+//=========================== prototypes ======================================
+
+static void lpl_arm_timer(void);
+static void lpl_radio_off(void);
+static void lpl_strobe(void);
+static void lpl_finish(lpl_status_t status);
+static void cb_lpl_timer(void);
+static void cb_lpl_cca_done(radio_status_t status);
+static void cb_lpl_listen_done(radio_status_t status);
+static void cb_lpl_strobe_sent(radio_status_t status);
+static void cb_lpl_strobe_acked(autoack_status_t status, uint8_t attempts);
+
+//=========================== public ==========================================
+
+// Initialize low-power listening with the default wake-up interval. Strobes
+// and their acknowledgments rely on the autoack module, which must be
+// initialized as well.
+void lpl_init(void) {
+    memset(&lpl_vars, 0, sizeof(lpl_vars_t));
+
+    lpl_vars.wake_interval = LPL_DEFAULT_WAKE_INTERVAL_TICKS;
+    lpl_vars.cca_threshold = LPL_DEFAULT_CCA_THRESHOLD;
+}
+
+// Interval between two wake-ups of the receiver, in RF timer ticks. Senders
+// must use the same interval, as they strobe for one interval. Applies from
+// the next wake-up.
+void lpl_set_wake_interval(uint32_t ticks) {
+    if (ticks > LPL_WAKE_TICKS) {
+        lpl_vars.wake_interval = ticks;
+    }
+}
+
+uint32_t lpl_get_wake_interval(void) { return lpl_vars.wake_interval; }
+
+void lpl_set_cca_threshold(int8_t threshold) {
+    lpl_vars.cca_threshold = threshold;
+}
+
+// Start duty cycling the receiver on the current channel. Every wake-up
+// interval, the receiver is turned on for LPL_WAKE_TICKS and turned off again
+// unless energy or an SFD was detected, in which case it listens for the next
+// strobe. Received frames are queued in the radio RX ring.
+void lpl_start(void) {
+    lpl_vars.running = true;
+    lpl_vars.next_wake = rftimer_readCounter() + lpl_vars.wake_interval;
+    lpl_vars.elapsed_start = rftimer_readCounter();
+
+    rftimer_set_callback_by_id(cb_lpl_timer, LPL_RFTIMER_ID);
+    lpl_arm_timer();
+}
+
+// Stop waking up. A strobed frame being sent is not interrupted.
+void lpl_stop(void) {
+    lpl_vars.running = false;
+    rftimer_disable_interrupts_by_id(LPL_RFTIMER_ID);
+    if (!lpl_vars.busy && radio_busy()) {
+        radio_rx_cancel();
+        lpl_radio_off();
+    }
+}
+
+// Send a frame to a duty-cycled receiver on the current channel by repeating
+// it until it is acknowledged, for at most one wake-up interval. A frame
+// without the ACK request bit set, e.g. a broadcast, is repeated for the
+// whole interval. cb is called from interrupt context. Returns false if a
+// frame is already being sent or the radio is busy.
+bool lpl_send_async(void* packet, uint8_t pkt_len, lpl_done_cbt cb) {
+    uint8_t* frame = packet;
+
+    if (lpl_vars.busy || radio_busy()) {
+        return false;
+    }
+
+    lpl_vars.packet = frame;
+    lpl_vars.pkt_len = pkt_len;
+    lpl_vars.channel = radio_getFrequency();
+    lpl_vars.ack_request = (frame[0] & IEEE_802_15_4_FCF_ACK_REQUEST) != 0;
+    lpl_vars.done_cb = cb;
+    lpl_vars.busy = true;
+
+    lpl_vars.on_start = rftimer_readCounter();
+    lpl_vars.strobe_end =
+        lpl_vars.on_start + lpl_vars.wake_interval + LPL_WAKE_TICKS;
+    lpl_strobe();
+    return true;
+}
+
+// Blocking wrapper around lpl_send_async(); the core sleeps until the frame
+// is acknowledged or the strobe ends.
+lpl_status_t lpl_send(void* packet, uint8_t pkt_len) {
+    if (!lpl_send_async(packet, pkt_len, NULL)) {
+        return LPL_STATUS_ERROR;
+    }
+
+    radio_wait_while(&lpl_vars.busy);
+
+    return lpl_vars.status;
+}
+
+bool lpl_busy(void) { return lpl_vars.busy; }
+
+// Radio-on time of the receiver wake-ups and the sender strobes, and its
+// share of the time elapsed since the counters were reset, scaled to one hour
+void lpl_get_energy(lpl_energy_t* energy) {
+    uint64_t elapsed;
+
+    __disable_irq();
+    energy->radio_on_ticks = lpl_vars.radio_on_ticks;
+    elapsed = lpl_vars.elapsed_ticks;
+    if (lpl_vars.running) {
+        elapsed += rftimer_readCounter() - lpl_vars.elapsed_start;
+    }
+    energy->wakeups = lpl_vars.wakeups;
+    energy->strobes = lpl_vars.strobes;
+    __enable_irq();
+
+    energy->elapsed_ticks = elapsed;
+    energy->on_ms_per_hour =
+        elapsed ? (uint32_t)(energy->radio_on_ticks * 3600000 / elapsed) : 0;
+}
+
+void lpl_reset_energy(void) {
+    __disable_irq();
+    lpl_vars.radio_on_ticks = 0;
+    lpl_vars.elapsed_ticks = 0;
+    lpl_vars.elapsed_start = rftimer_readCounter();
+    lpl_vars.wakeups = 0;
+    lpl_vars.strobes = 0;
+    __enable_irq();
+}
+
+//=========================== private =========================================
+
+static void lpl_arm_timer(void) {
+    uint32_t now = rftimer_readCounter();
+
+    if ((int32_t)(lpl_vars.next_wake - now) > LPL_TIMER_MAX_STEP_TICKS) {
+        rftimer_setCompareIn_by_id(now + LPL_TIMER_MAX_STEP_TICKS,
+                                   LPL_RFTIMER_ID);
+    } else {
+        rftimer_setCompareIn_by_id(lpl_vars.next_wake, LPL_RFTIMER_ID);
+    }
+}
+
+// Turn the radio off, unless another operation was started meanwhile, and
+// account for the radio-on time since on_start
+static void lpl_radio_off(void) {
+    if (!radio_busy()) {
+        radio_rfOff();
+    }
+    lpl_vars.radio_on_ticks += rftimer_readCounter() - lpl_vars.on_start;
+}
+
+// Send one copy of the frame, one turnaround time from now
+static void lpl_strobe(void) {
+    uint32_t tx_ticks = rftimer_readCounter() + AUTOACK_TURNAROUND_TICKS;
+    bool sent;
+
+    lpl_vars.strobes++;
+    if (lpl_vars.ack_request) {
+        sent = autoack_tx_at(lpl_vars.packet, lpl_vars.pkt_len, tx_ticks,
+                             cb_lpl_strobe_acked);
+    } else {
+        radio_setFrequency(lpl_vars.channel, FREQ_TX);
+        radio_loadPacket(lpl_vars.packet, lpl_vars.pkt_len);
+        radio_txEnable();
+        sent = radio_schedule_tx_at(tx_ticks, cb_lpl_strobe_sent);
+    }
+    if (!sent) {
+        lpl_finish(LPL_STATUS_ERROR);
+    }
+}
+
+static void lpl_finish(lpl_status_t status) {
+    lpl_done_cbt cb = lpl_vars.done_cb;
+
+    lpl_radio_off();
+
+    lpl_vars.status = status;
+    lpl_vars.done_cb = NULL;
+    lpl_vars.busy = false;
+
+    if (cb != NULL) {
+        cb(status);
+    }
+}
+
+static void cb_lpl_timer(void) {
+    uint32_t now = rftimer_readCounter();
+
+    if (!lpl_vars.running) {
+        return;
+    }
+
+    // Intermediate step of a long wake-up interval
+    if ((int32_t)(lpl_vars.next_wake - now) > 0) {
+        lpl_arm_timer();
+        return;
+    }
+
+    lpl_vars.next_wake += lpl_vars.wake_interval;
+    lpl_vars.elapsed_ticks += now - lpl_vars.elapsed_start;
+    lpl_vars.elapsed_start = now;
+    lpl_arm_timer();
+
+    // Our own strobe or a late listen keeps the radio on anyway
+    if (lpl_vars.busy || radio_busy()) {
+        return;
+    }
+
+    lpl_vars.wakeups++;
+    lpl_vars.on_start = now;
+    if (!radio_cca_async(LPL_WAKE_TICKS, lpl_vars.cca_threshold,
+                         cb_lpl_cca_done)) {
+        lpl_radio_off();
+    }
+}
+
+static void cb_lpl_cca_done(radio_status_t status) {
+    // Energy or an SFD: a sender is strobing, catch its next copy
+    if (status == RADIO_STATUS_CCA_BUSY &&
+        radio_rx_async(LPL_LISTEN_TICKS, cb_lpl_listen_done)) {
+        return;
+    }
+
+    // Channel clear, or a whole strobe received within the window
+    lpl_radio_off();
+}
+
+// The frame, if any, is in the RX ring and was acknowledged by the autoack
+// RX hook. Energy without any frame may be a strobe the receiver could not
+// detect, which the adaptive packet detection threshold takes into account.
+static void cb_lpl_listen_done(radio_status_t status) {
+    if (status == RADIO_STATUS_TIMEOUT) {
+        radio_report_missed_frames(1);
+    }
+    lpl_radio_off();
+}
+
+static void cb_lpl_strobe_sent(radio_status_t status) {
+    if ((int32_t)(rftimer_readCounter() - lpl_vars.strobe_end) < 0) {
+        lpl_strobe();
+    } else {
+        lpl_finish(LPL_STATUS_SUCCESS);
+    }
+}
+
+static void cb_lpl_strobe_acked(autoack_status_t status, uint8_t attempts) {
+    if (status == AUTOACK_STATUS_ACKED) {
+        lpl_finish(LPL_STATUS_SUCCESS);
+    } else if (status == AUTOACK_STATUS_NO_ACK &&
+               (int32_t)(rftimer_readCounter() - lpl_vars.strobe_end) < 0) {
+        lpl_strobe();
+    } else {
+        lpl_finish(status == AUTOACK_STATUS_NO_ACK ? LPL_STATUS_NO_ACK
+                                                   : LPL_STATUS_ERROR);
+    }
+}
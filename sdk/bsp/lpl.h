@@ -0,0 +1,58 @@
+#ifndef __LPL_H
+#define __LPL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//=========================== define ==========================================
+
+// Default wake-up interval, 125 ms, in RF timer ticks
+#define LPL_DEFAULT_WAKE_INTERVAL_TICKS 62500
+
+// Listening window at each wake-up: LDO settling plus the longest silence
+// between two strobes of a sender (turnaround, ACK wait and ISR latency)
+#define LPL_WAKE_TICKS 700
+
+// Once energy is detected, listen long enough to catch the next strobe of a
+// maximum length frame
+#define LPL_LISTEN_TICKS 3000
+
+// Default CCA energy threshold in dBm, as reported by radio_get_rssi(): 10 dB
+// above the -85 dBm the AGC reports at its highest gain, in silence
+#define LPL_DEFAULT_CCA_THRESHOLD (-75)
+
+//=========================== typedef =========================================
+
+typedef enum {
+    LPL_STATUS_SUCCESS = 0x01,  // acknowledged, or strobed for a full interval
+    LPL_STATUS_NO_ACK = 0x02,
+    LPL_STATUS_ERROR = 0x03,
+} lpl_status_t;
+
+typedef struct {
+    uint64_t radio_on_ticks;  // time spent with the radio on
+    uint64_t elapsed_ticks;   // time since lpl_start() or the last reset
+    uint32_t on_ms_per_hour;  // radio-on time extrapolated to one hour
+    uint32_t wakeups;
+    uint32_t strobes;
+} lpl_energy_t;
+
+typedef void (*lpl_done_cbt)(lpl_status_t status);
+
+//=========================== prototypes ======================================
+
+void lpl_init(void);
+void lpl_set_wake_interval(uint32_t ticks);
+uint32_t lpl_get_wake_interval(void);
+void lpl_set_cca_threshold(int8_t threshold);
+void lpl_start(void);
+void lpl_stop(void);
+
+bool lpl_send_async(void* packet, uint8_t pkt_len, lpl_done_cbt cb);
+lpl_status_t lpl_send(void* packet, uint8_t pkt_len);
+bool lpl_busy(void);
+
+void lpl_get_energy(lpl_energy_t* energy);
+void lpl_reset_energy(void);
+
+#endif
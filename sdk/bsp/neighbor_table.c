@@ -0,0 +1,86 @@
+#include "neighbor_table.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//=========================== prototypes ======================================
+
+static neighbor_table_entry_t* neighbor_table_entry(
+    const neighbor_table_t* table, uint8_t index);
+
+//=========================== public ==========================================
+
+// Set up a table over num_entries entries of entry_size bytes, all free
+void neighbor_table_init(neighbor_table_t* table, void* entries,
+                         uint8_t num_entries, size_t entry_size) {
+    table->entries = entries;
+    table->entry_size = entry_size;
+    table->num_entries = num_entries;
+    neighbor_table_clear(table);
+}
+
+// Forget every neighbor
+void neighbor_table_clear(neighbor_table_t* table) {
+    memset(table->entries, 0, table->num_entries * table->entry_size);
+    table->use_count = 0;
+}
+
+// Entry of neighbor addr, or NULL if it is not in the table
+void* neighbor_table_find(const neighbor_table_t* table, uint16_t addr) {
+    neighbor_table_entry_t* entry;
+    uint8_t i;
+
+    for (i = 0; i < table->num_entries; i++) {
+        entry = neighbor_table_entry(table, i);
+        if (entry->used && entry->addr == addr) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Entry of neighbor addr, marked as the most recently used. A neighbor not in
+// the table takes a free entry or the least recently used one, cleared.
+// result, if not NULL, tells which.
+void* neighbor_table_add(neighbor_table_t* table, uint16_t addr,
+                         neighbor_table_result_t* result) {
+    neighbor_table_entry_t* victim = neighbor_table_entry(table, 0);
+    neighbor_table_entry_t* entry;
+    neighbor_table_result_t found = NEIGHBOR_TABLE_FOUND;
+    uint8_t i;
+
+    for (i = 0; i < table->num_entries; i++) {
+        entry = neighbor_table_entry(table, i);
+        if (entry->used && entry->addr == addr) {
+            break;
+        }
+        if (victim->used &&
+            (!entry->used || entry->last_used < victim->last_used)) {
+            victim = entry;
+        }
+    }
+
+    if (i == table->num_entries) {
+        found = victim->used ? NEIGHBOR_TABLE_EVICTED : NEIGHBOR_TABLE_ADDED;
+        entry = victim;
+        memset(entry, 0, table->entry_size);
+        entry->used = true;
+        entry->addr = addr;
+    }
+    entry->last_used = ++table->use_count;
+
+    if (result != NULL) {
+        *result = found;
+    }
+    return entry;
+}
+
+//=========================== private =========================================
+
+static neighbor_table_entry_t* neighbor_table_entry(
+    const neighbor_table_t* table, uint8_t index) {
+    return (neighbor_table_entry_t*)((uint8_t*)table->entries +
+                                     index * table->entry_size);
+}
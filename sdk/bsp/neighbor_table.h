@@ -0,0 +1,46 @@
+// Small tables of per-neighbor state, keyed by short address, as kept by the
+// TX power controller and the link estimator. Once a table is full, the least
+// recently used neighbor makes room for a new one. The entries are structs
+// whose first member is a neighbor_table_entry_t. The table is not locked:
+// callers shared with interrupt context mask interrupts around it.
+
+#ifndef __NEIGHBOR_TABLE_H
+#define __NEIGHBOR_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//=========================== typedef =========================================
+
+// Header of a table entry
+typedef struct {
+    bool used;
+    uint16_t addr;
+    uint32_t last_used;
+} neighbor_table_entry_t;
+
+typedef struct {
+    void* entries;
+    size_t entry_size;
+    uint8_t num_entries;
+    uint32_t use_count;
+} neighbor_table_t;
+
+// How neighbor_table_add() got the entry of a neighbor
+typedef enum {
+    NEIGHBOR_TABLE_FOUND = 0x00,    // already in the table
+    NEIGHBOR_TABLE_ADDED = 0x01,    // took a free entry
+    NEIGHBOR_TABLE_EVICTED = 0x02,  // took the least recently used entry
+} neighbor_table_result_t;
+
+//=========================== prototypes ======================================
+
+void neighbor_table_init(neighbor_table_t* table, void* entries,
+                         uint8_t num_entries, size_t entry_size);
+void neighbor_table_clear(neighbor_table_t* table);
+void* neighbor_table_find(const neighbor_table_t* table, uint16_t addr);
+void* neighbor_table_add(neighbor_table_t* table, uint16_t addr,
+                         neighbor_table_result_t* result);
+
+#endif
@@ -74,6 +74,9 @@ void perform_calibration(void) {
 #endif
 }
 
+// LC code of RX channel 11 found by the optical calibration
+uint32_t optical_get_LC_code(void) { return optical_vars.LC_code; }
+
 //=========================== interrupt =======================================
 
 // This interrupt goes off every time 32 new bits of data have been shifted into
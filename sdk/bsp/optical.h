@@ -17,4 +17,7 @@ void optical_enable(void);
 void perform_calibration(void);
 void optical_sfd_isr(void);
 
+//==== getters
+uint32_t optical_get_LC_code(void);
+
 #endif
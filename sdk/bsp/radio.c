@@ -9,30 +9,21 @@
 #include "scum.h"
 #include "helpers.h"
 #include "gpio.h"
+#include "ieee_802_15_4.h"
 #include "rftimer.h"
 #include "scm3c_hw_interface.h"
 
 // raw_chip interrupt related
-unsigned int chips[100];
-unsigned int chip_index = 0;
-int raw_chips;
-int jj;
 unsigned int acfg3_val;
 
 // These coefficients are used for filtering frequency feedback information
 // These are no necessarily the ideal values to use; situationally dependent
 unsigned char FIR_coeff[11] = {4, 16, 37, 64, 87, 96, 87, 64, 37, 16, 4};
-unsigned int IF_estimate_history[11] = {500, 500, 500, 500, 500,
-                                        500, 500, 500, 500, 500};
-signed short cdr_tau_history[11] = {0};
 
 //=========================== definition ======================================
 
 // #define DIV_ON
 
-#define MAXLENGTH_TRX_BUFFER 128  // 1B length, 125B data, 2B CRC
-#define NUM_CHANNELS 16
-
 // per SCuM user guide section 19.1:
 //    The RSSI value corresponds to the
 //    gain setting after Automatic Gain Control has settled and has a maximum
@@ -54,19 +45,98 @@ signed short cdr_tau_history[11] = {0};
 #define LO_FREQ_UPDATE_TIMEOUT 10
 #define FILTER_WINDOWS_LEN 11
 #define FIR_COEFF_SCALE 512  // determined by FIR_coeff
+#define IF_ESTIMATE_NOMINAL 500
+
+// ppm of chip rate error per CDR tau adjustment is 15625 / (8 * packet_len),
+// kept as a Q16 reciprocal per packet length; 0 for the empty packet
+#define PPM_PER_TAU_Q16(len) ((len) ? ((15625UL << 16) / 8) / (len) : 0)
+#define PPM_PER_TAU_Q16_4(len)                                         \
+    PPM_PER_TAU_Q16(len), PPM_PER_TAU_Q16((len) + 1),                  \
+        PPM_PER_TAU_Q16((len) + 2), PPM_PER_TAU_Q16((len) + 3)
+#define PPM_PER_TAU_Q16_16(len)                                        \
+    PPM_PER_TAU_Q16_4(len), PPM_PER_TAU_Q16_4((len) + 4),              \
+        PPM_PER_TAU_Q16_4((len) + 8), PPM_PER_TAU_Q16_4((len) + 12)
+#define PPM_PER_TAU_Q16_64(len)                                        \
+    PPM_PER_TAU_Q16_16(len), PPM_PER_TAU_Q16_16((len) + 16),           \
+        PPM_PER_TAU_Q16_16((len) + 32), PPM_PER_TAU_Q16_16((len) + 48)
 
 #define LC_CODE_RX 700  // Board Q3: tested at Inria A102 room (Oct, 16 2019)
 #define LC_CODE_TX 707  // Board Q3: tested at Inria A102 room (Oct, 16 2019)
 
+// LC code step between two adjacent channels (5 MHz), used as the default
+// until a table is built or loaded
+#define LC_CODE_CHANNEL_STEP 40
+
 #define FREQ_UPDATE_RATE 15
 
+//===== channel table builder
+
+// LC counter gate time per step, in RF timer ticks. Matches the former
+// busy_wait_cycles(16000) window (~23 ms).
+#define TABLE_COUNT_TICKS 11430
+#define TABLE_RX_COUNT_MARGIN 20
+#define TABLE_TX_COUNT_MARGIN 5
+
 //===== for recognizing panid
+// Indices in the RX buffer, which starts with the PHY length byte
 
 #define LEN_PKT_INDEX 0x00
+#define FCF_LBYTE_PKT_INDEX 0x01
+#define FCF_HBYTE_PKT_INDEX 0x02
 #define PANID_LBYTE_PKT_INDEX 0x04
 #define PANID_HBYTE_PKT_INDEX 0x05
 #define DEFAULT_PANID 0xcafe
 
+// The address filter looks at the frame once its destination address fields
+// can have been received: PHY length, FCF, sequence number, PAN ID and an
+// extended address (14 bytes at 16 ticks each) after the SFD, plus some slack
+// for the DMA. Shorter frames are only filtered once complete, as aborting
+// them would race with their end.
+#define FILTER_CHECK_TICKS 240
+#define FILTER_MIN_ABORT_LEN 21
+
+//===== adaptive packet detection threshold
+// The threshold is a Hamming distance: lowering it rejects more false SFDs,
+// raising it recovers sensitivity. It is re-evaluated every
+// THRESHOLD_WINDOW_SFDS SFDs from the share of SFDs not followed by a valid
+// frame, and right away once THRESHOLD_MISSED_TRIGGER frames are reported
+// missed.
+#define THRESHOLD_WINDOW_SFDS 64
+#define THRESHOLD_FALSE_HIGH_PCT 50
+#define THRESHOLD_FALSE_LOW_PCT 10
+#define THRESHOLD_MISSED_TRIGGER 2
+#define THRESHOLD_DEFAULT_MIN 2
+#define THRESHOLD_DEFAULT_MAX 8
+
+//===== demodulator auto-selection
+// The demodulator in use is scored over windows of frames received, failed
+// and reported missed. Every DEMOD_HOLD_WINDOWS windows the other one is
+// tried for a window, cut short after DEMOD_PROBE_TIMEOUT_TICKS as it may
+// detect nothing, and the one with the lower packet error rate is kept.
+#define DEMOD_DEFAULT_WINDOW 100
+#define DEMOD_HOLD_WINDOWS 16
+#define DEMOD_PROBE_TIMEOUT_TICKS 2500000  // 5 s
+
+//===== IF power control
+// Chip errors are counted over the first 256 chips, so only frames of at
+// least 8 bytes are scored. A CRC failure, a missed frame or more chip errors
+// than the target raise the IF level right away, by two levels past twice
+// the target; IF_POWER_DOWN_FRAMES frames in a row with at most half the
+// target and an RSSI of at least IF_POWER_DOWN_MIN_RSSI, 15 dB above the
+// weakest signal radio_get_rssi() reports, lower it by one.
+#define IF_POWER_MIN_LENGTH 8
+#define IF_POWER_DOWN_FRAMES 16
+#define IF_POWER_DOWN_MIN_RSSI -70  // dBm
+#define IF_POWER_DEFAULT_CHIP_ERRORS 12
+
+// Longest gap between two frames sent that is still counted as back-to-back
+// in the stats, 10 ms
+#define TX_GAP_MAX_TICKS 5000
+
+// Raw chip capture ring length; one unused word when capture is left out
+#define RAWCHIPS_RING_LENGTH \
+    (RADIO_RAWCHIPS_RING_SIZE > 0 ? RADIO_RAWCHIPS_RING_SIZE : 1)
+
 //===== RFTIMER
 // #define TIMER_PERIOD_TX        250000           ///< 500 = 1ms@500kHz
 // #define TIMER_PERIOD_RX        200000           ///< 500 = 1ms@500kHz
@@ -74,6 +144,20 @@ signed short cdr_tau_history[11] = {0};
 #define TIMER_PERIOD_RX 2000  ///< 500 = 1ms@
 // #define TIMER_PERIOD_RX        10000           ///< 500 = 1ms@500kHz
 
+// RFTIMER compare channels used by the radio driver
+#define RADIO_RFTIMER_RX_ID 0        // RX timeout
+#define RADIO_RFTIMER_RX_START_ID 1  // scheduled RX start
+#define RADIO_RFTIMER_TX_ID 2        // TX start, software or scheduled
+#define RADIO_RFTIMER_RX_STOP_ID 3   // scheduled RX stop
+#define RADIO_RFTIMER_FILTER_ID 5    // address filter early check
+#define RADIO_RFTIMER_TABLE_ID 6     // channel table builder
+
+// RFTIMER capture channels latching the radio events
+#define RADIO_CAPTURE_TX_SFD 0
+#define RADIO_CAPTURE_TX_SEND_DONE 1
+#define RADIO_CAPTURE_RX_SFD 2
+#define RADIO_CAPTURE_RX_DONE 3
+
 #define RX_PKT_ANY_LEN \
     0xFF  // A packet of length 255 is impossible by both IEEE 802.15.4 and BLE,
           // and is used to indicate that the packet length is not known in
@@ -81,6 +165,40 @@ signed short cdr_tau_history[11] = {0};
 
 //=========================== variables =======================================
 
+// TX LO count targets relative to the RX count of channel 11. Until figure out
+// why modulation spacing is only 800kHz, only set 400khz above RF channel.
+static const uint16_t table_tx_nums[IEEE_802_15_4_NUM_CHANNELS] = {
+    802, 904, 929, 269, 949, 434, 369, 578,
+    455, 970, 139, 297, 587, 109, 373, 159};
+static const uint16_t table_tx_dens[IEEE_802_15_4_NUM_CHANNELS] = {
+    801, 901, 924, 267, 940, 429, 364, 569,
+    447, 951, 136, 290, 572, 106, 362, 154};
+
+// PPM_PER_TAU_Q16() of every packet length, built at compile time into flash
+static const uint32_t ppm_per_tau[MAXLENGTH_TRX_BUFFER] = {
+    PPM_PER_TAU_Q16_64(0), PPM_PER_TAU_Q16_64(64)};
+
+// Frequency feedback filter. The history is circular; head is the slot the
+// next sample overwrites.
+typedef struct {
+    int32_t history[FILTER_WINDOWS_LEN];
+    uint8_t head;
+    uint16_t cooldown;
+} radio_freq_filter_t;
+
+// Frame sent straight from a caller-owned buffer
+typedef struct {
+    const uint8_t* packet;
+    uint16_t len;
+} radio_tx_desc_t;
+
+// IF gain and LDO settings of an IF level
+typedef struct {
+    uint8_t gain;    // I and Q gain, 63 is the max
+    uint8_t stg3gm;  // stage 3 ADC driver gm
+    uint8_t ldo;     // IF LDO reference, 0 is the highest voltage
+} radio_if_level_t;
+
 typedef struct {
     radio_mode_t radio_mode;
 
@@ -89,61 +207,198 @@ typedef struct {
     radio_capture_cbt startFrame_rx_cb;
     radio_capture_cbt endFrame_rx_cb;
     uint8_t radio_tx_buffer[MAXLENGTH_TRX_BUFFER] __attribute__((aligned(4)));
-    uint8_t radio_rx_buffer[MAXLENGTH_TRX_BUFFER] __attribute__((aligned(4)));
+
+    // Ping-pong TX descriptors. The descriptor at tx_desc_head is the frame
+    // loaded into (or being sent by) the radio; the other one, if any, is
+    // loaded as soon as TX_SEND_DONE fires and sent on TX_LOAD_DONE.
+    radio_tx_desc_t tx_desc[RADIO_NUM_TX_DESC];
+    uint8_t tx_desc_head;
+    volatile uint8_t tx_desc_count;
+    bool tx_chained;
+    uint32_t tx_last_end;  // RF timer count at the end of the last frame sent
+    bool tx_last_end_valid;
+
+    // TX burst: next supplies the frames, which are queued behind the one on
+    // the air from the TX_SEND_DONE interrupt, see radio_tx_burst_async()
+    bool burst;
+    radio_burst_next_cbt burst_next;
+    const radio_burst_frame_t* burst_frames;
+    uint16_t burst_num_frames;
+    uint16_t burst_index;
+    uint32_t burst_start;
+    uint32_t burst_sent;
     uint8_t current_frequency;
+    radio_freq_t current_freq_mode;
     bool crc_ok;
 
-    uint32_t rx_channel_codes[NUM_CHANNELS];
-    uint32_t tx_channel_codes[NUM_CHANNELS];
+    uint32_t rx_channel_codes[IEEE_802_15_4_NUM_CHANNELS];
+    uint32_t tx_channel_codes[IEEE_802_15_4_NUM_CHANNELS];
+
+    // LC register words of the codes above, so that retuning is a lookup
+    uint32_t rx_channel_words[IEEE_802_15_4_NUM_CHANNELS];
+    uint32_t tx_channel_words[IEEE_802_15_4_NUM_CHANNELS];
 
     // How many packets must be received before adjusting RX clock rates
     // Should be at least as long as the FIR filters
     uint16_t frequency_update_rate;
-    uint16_t frequency_update_cooldown_timer;
-
-    // TX parameters
-    bool sendDone;
+    bool frequency_tracking;
+    radio_freq_filter_t if_filters[IEEE_802_15_4_NUM_CHANNELS];
+    radio_freq_filter_t cdr_filter;  // chip rate error, in ppm
+
+    // Channel table builder, advanced one LC count per RF timer interrupt
+    volatile bool table_building;
+    bool table_tx;
+    uint8_t table_channel;
+    uint32_t table_count_rx_ch11;
+    radio_table_done_cbt table_done_cb;
+
+    // Asynchronous operation in progress; cleared from interrupt context
+    volatile bool busy;
+    radio_done_cbt done_cb;
+    uint32_t rx_timeout;
 
     // RX parameters
-    uint8_t rxPacket[RX_PKT_ANY_LEN];
     uint8_t rxPacket_len;
     radio_rx_cbt radio_rx_cb;
-    int8_t rxpk_rssi;
-    uint8_t rxpk_lqi;
-    bool rxpk_crc;
-    bool receiveDone;
     bool rxFrameStarted;
+    bool rx_continuous;
+    bool rx_window;
+    bool cca;
+    int8_t cca_threshold;
+    uint32_t rx_sfd_timestamp;
+    uint8_t rx_last_len;
     uint32_t IF_estimate;
     uint32_t LQI_chip_errors;
     uint32_t cdr_tau_value;
+
+    // RX descriptor ring. The slot at rx_ring_head is owned by the radio DMA;
+    // slots from rx_ring_tail up to the head hold frames waiting to be
+    // drained. The head is only moved by the RX interrupt and the tail only
+    // by the application.
+    radio_rx_slot_t rx_ring[RADIO_RX_RING_SIZE];
+    volatile uint8_t rx_ring_head;
+    volatile uint8_t rx_ring_tail;
+
+    radio_stats_t stats;
+
+    // Raw chip capture ring, filled by the RAWCHIPS interrupts and drained
+    // by radio_rawchips_read(). Words that do not fit are dropped; the first
+    // drop records where the gap sits in the stream, and words keep being
+    // dropped until the reader has reached it.
+    uint32_t rawchips_ring[RAWCHIPS_RING_LENGTH];
+    volatile uint16_t rawchips_head;
+    volatile uint16_t rawchips_tail;
+    volatile bool rawchips_gap;
+    volatile uint16_t rawchips_gap_at;
+    volatile uint32_t rawchips_dropped;
+
+    // Adaptive packet detection threshold, see
+    // radio_set_adaptive_threshold(); the current value is in the stats
+    bool threshold_adaptive;
+    uint8_t threshold_min;
+    uint8_t threshold_max;
+    uint16_t threshold_sfd;    // SFDs in the current window
+    uint16_t threshold_valid;  // of which real frames
+    uint16_t threshold_missed;
+
+    // Demodulator auto-selection, see radio_set_demod_auto(). The counters of
+    // the current window are updated from interrupt context and evaluated
+    // from radio_rx_release() and radio_rx_drain(). A switch requested while
+    // a frame is in flight waits there as well.
+    bool demod_auto;
+    bool demod_probing;
+    bool demod_pending;
+    radio_demod_t demod_target;
+    uint16_t demod_window;
+    uint16_t demod_hold;  // windows left before probing the other one
+    uint32_t demod_probe_start;
+    uint16_t demod_ok;
+    uint16_t demod_crc;
+    uint16_t demod_missed;
+
+    // IF power control, see radio_set_if_power_control(). if_level is the
+    // level wanted; it is programmed, between frames, from
+    // radio_rx_release() and radio_rx_drain().
+    bool if_power_control;
+    uint8_t if_chip_errors_target;
+    uint8_t if_level;
+    uint16_t if_good_frames;
+    uint16_t if_missed;  // frames reported missed, not yet acted upon
+
+    // Address filter, see radio_set_address_filter()
+    bool filter_enabled;
+    uint16_t filter_pan_id;
+    uint16_t filter_short_addr;
+    bool filter_ext_enabled;
+    uint8_t filter_ext_addr[IEEE_802_15_4_EXT_ADDR_LENGTH];
+
+    // Reply, such as an acknowledgment, requested by the RX hook. It is sent
+    // in place of re-arming the receiver; ack_resume_rx tells whether the
+    // receiver is turned back on afterwards or the RX operation completes.
+    radio_rx_hook_cbt rx_hook;
+    radio_tx_desc_t ack_desc;
+    uint32_t ack_ticks;
+    bool ack_requested;
+    bool ack_in_flight;
+    bool ack_resume_rx;
 } radio_vars_t;
 
 radio_vars_t radio_vars;
 
+// From the lowest power to the radio_init_rx_MF() settings. Gain is given up
+// first, then the IF LDO voltage.
+static const radio_if_level_t if_levels[RADIO_NUM_IF_LEVELS] = {
+    {31, 3, 24}, {39, 4, 16}, {47, 5, 8}, {55, 6, 4}, {63, 7, 2}, {63, 7, 0},
+};
+
 //=========================== prototypes ======================================
 
 void setFrequencyTX(uint8_t channel);
 void setFrequencyRX(uint8_t channel);
-
-// uint32_t build_RX_channel_table(uint32_t channel_11_LC_code);
-// void build_TX_channel_table(uint32_t channel_11_LC_code,
-//                             uint32_t count_LC_RX_ch11);
+static void radio_rx_start(uint8_t pkt_len, uint32_t timeout,
+                           radio_done_cbt cb);
+static void radio_complete(radio_status_t status);
+static void radio_wait_done(void);
+static void radio_rx_rearm(void);
+static void cb_timer_rx_window_end(void);
+static bool radio_address_match(const uint8_t* buffer);
+static void radio_rawchips_push(void);
+static void radio_threshold_update(void);
+static void cb_timer_filter(void);
+static bool radio_asc_deferred(void);
+static void radio_asc_rearm(void);
+static bool radio_demod_apply(radio_demod_t demod);
+static void radio_demod_update(void);
+static void radio_if_level_write(uint8_t level);
+static void radio_if_power_track(const radio_rx_slot_t* slot);
+static void radio_if_power_update(void);
+static inline uint8_t radio_rx_ring_next(uint8_t index);
+static void radio_tx_desc_load(const radio_tx_desc_t* desc);
+static bool radio_tx_desc_done(void);
+static void radio_burst_refill(void);
+static const void* radio_burst_next_frame(uint8_t* pkt_len);
+static void radio_update_channel_words(uint8_t index);
+static void radio_ack_start(void);
+static void radio_ack_done(void);
+static void radio_rx_resume(void);
+static void radio_frequency_track(uint8_t channel, uint8_t packet_len,
+                                  uint32_t IF_estimate,
+                                  uint32_t LQI_chip_errors,
+                                  int16_t cdr_tau_value);
+static int32_t radio_fir(const int32_t* history, uint8_t head);
+static void radio_table_count_start(void);
+static void cb_timer_table(void);
+static void radio_table_switch_to_tx(void);
 
 //=========================== public ==========================================
 
 // pkt_len should include CRC bytes (add 2 bytes to desired pkt size)
+// Blocking wrapper around radio_tx_async(); the core sleeps until the frame
+// has been sent.
 void send_packet(void* packet, uint8_t pkt_len) {
-    radio_vars.radio_mode = TX_MODE;
-
-    rftimer_set_callback_by_id(cb_timer_radio,2);
-
-    radio_loadPacket(packet, pkt_len);
-    radio_txEnable();
-
-    rftimer_setCompareIn_by_id(SCUM_RFTIMER->COUNTER + TIMER_PERIOD_TX, 2);
-    radio_vars.sendDone = false;
-
-    while (!radio_vars.sendDone) {}
+    if (radio_tx_async(packet, pkt_len, NULL)) {
+        radio_wait_done();
+    }
 }
 
 // Receive a packet of any length.
@@ -156,57 +411,652 @@ void receive_packet(bool timeout) {
 // Includes a timeout in case no packet is received.
 //  Timeout determined by TIMER_PERIOD_RX
 // If timeout is set false, then the function may block indefinitely
+// Blocking wrapper around the asynchronous receive path; the core sleeps until
+// a packet is received, the CRC check fails or the timeout expires.
 void receive_packet_length(uint8_t pkt_len, bool timeout) {
-    radio_vars.radio_mode = RX_MODE;
-    radio_vars.rxPacket_len =
-        pkt_len <= RX_PKT_ANY_LEN ? pkt_len : RX_PKT_ANY_LEN;
+    if (radio_vars.busy) {
+        return;
+    }
+
+    radio_rx_start(pkt_len, timeout ? TIMER_PERIOD_RX : 0, NULL);
+    radio_wait_done();
+    radio_rx_drain();
+}
+
+// Start transmitting a packet and return immediately. pkt_len should include
+// the CRC bytes. cb, if not NULL, is called from interrupt context with
+// RADIO_STATUS_SENT once the packet is on the air. Returns false if another
+// radio operation is still in progress.
+bool radio_tx_async(void* packet, uint8_t pkt_len, radio_done_cbt cb) {
+    if (radio_vars.busy) {
+        return false;
+    }
+
+    radio_vars.radio_mode = TX_MODE;
+    radio_vars.done_cb = cb;
+    radio_vars.busy = true;
+
+    rftimer_set_callback_by_id(cb_timer_radio, RADIO_RFTIMER_TX_ID);
+
+    radio_loadPacket(packet, pkt_len);
+    radio_txEnable();
+
+    // The packet is sent from cb_timer_radio() once the LDOs have settled
+    rftimer_setCompareIn_by_id(rftimer_readCounter() + TIMER_PERIOD_TX,
+                               RADIO_RFTIMER_TX_ID);
+    return true;
+}
+
+// Start listening for a packet of any length and return immediately. timeout
+// is expressed in RF timer ticks (500 = 1ms); 0 listens until a packet
+// arrives. cb, if not NULL, is called from interrupt context with
+// RADIO_STATUS_RECEIVED, RADIO_STATUS_CRC_FAIL, RADIO_STATUS_RX_DROPPED or
+// RADIO_STATUS_TIMEOUT.
+// Returns false if another radio operation is still in progress.
+bool radio_rx_async(uint32_t timeout, radio_done_cbt cb) {
+    if (radio_vars.busy) {
+        return false;
+    }
+
+    radio_rx_start(RX_PKT_ANY_LEN, timeout, cb);
+    return true;
+}
+
+bool radio_busy(void) { return radio_vars.busy; }
+
+// Sleep until flag is cleared from interrupt context, e.g. the busy flag of an
+// asynchronous operation. Interrupts are masked around the check so that a
+// completion landing between the test and WFI still wakes the core up.
+void radio_wait_while(volatile bool* flag) {
+    __disable_irq();
+    while (*flag) {
+        __WFI();
+        __enable_irq();
+        __disable_irq();
+    }
+    __enable_irq();
+}
+
+// Send a burst of frames without turning the radio off between them: the
+// TX LDOs stay up and the LO locked, and each frame is loaded as soon as the
+// previous one is sent and sent as soon as it is loaded. next is called for
+// each frame, from interrupt context after the first one, and returns it
+// (4-byte aligned, pkt_len including CRC) or NULL to end the burst. The radio
+// is turned off and cb called once the last frame is sent; the burst length
+// and its inter-frame gaps are in the stats. Returns false if the radio is
+// busy or next has no frame.
+bool radio_tx_burst_async(radio_burst_next_cbt next, radio_done_cbt cb) {
+    const void* packet;
+    uint8_t pkt_len;
+
+    if (radio_vars.busy) {
+        return false;
+    }
+
+    packet = next(&pkt_len);
+    if (packet == NULL) {
+        return false;
+    }
+
+    radio_vars.tx_desc_count = 0;
+    radio_vars.tx_chained = false;
+    if (!radio_tx_queue(packet, pkt_len)) {
+        return false;
+    }
+
+    radio_vars.radio_mode = TX_MODE;
+    radio_vars.done_cb = cb;
+    radio_vars.burst = true;
+    radio_vars.burst_next = next;
+    radio_vars.burst_sent = 0;
+    radio_vars.busy = true;
+
+    // Queue the second frame so that it is chained from the first send done
+    radio_burst_refill();
+
+    rftimer_set_callback_by_id(cb_timer_radio, RADIO_RFTIMER_TX_ID);
+    radio_txEnable();
+
+    // The first frame is sent from cb_timer_radio() once the LDOs have settled
+    rftimer_setCompareIn_by_id(rftimer_readCounter() + TIMER_PERIOD_TX,
+                               RADIO_RFTIMER_TX_ID);
+    return true;
+}
 
-    if (timeout) rftimer_set_callback(cb_timer_radio);
+// Blocking burst of num_frames frames; the core sleeps until the last one has
+// been sent. Returns false if nothing was sent.
+bool radio_tx_burst(const radio_burst_frame_t* frames, uint16_t num_frames) {
+    if (radio_vars.busy) {
+        return false;
+    }
+
+    radio_vars.burst_frames = frames;
+    radio_vars.burst_num_frames = num_frames;
+    radio_vars.burst_index = 0;
+    if (!radio_tx_burst_async(radio_burst_next_frame, NULL)) {
+        return false;
+    }
+
+    radio_wait_done();
+    return true;
+}
+
+// Keep the receiver on and collect every frame into the RX ring until
+// radio_rx_cancel() is called. The receiver is re-armed from the RX interrupt
+// as soon as a frame completes, so back-to-back frames are not lost while the
+// application drains the ring. Returns false if the radio is busy.
+bool radio_rx_listen(void) {
+    if (radio_vars.busy) {
+        return false;
+    }
+
+    radio_rx_start(RX_PKT_ANY_LEN, 0, NULL);
+    radio_vars.rx_continuous = true;
+    return true;
+}
+
+// Clear channel assessment: listen for duration RF timer ticks, then report
+// RADIO_STATUS_CCA_BUSY if the RSSI is at or above threshold (dBm) or an SFD
+// was detected, RADIO_STATUS_CCA_CLEAR otherwise. duration must cover the LDO
+// settling time (~50 us) on top of the 8-symbol CCA window. A frame received
+// completely meanwhile is queued and reported as for radio_rx_async(). cb is
+// called from interrupt context. Returns false if the radio is busy.
+bool radio_cca_async(uint32_t duration, int8_t threshold, radio_done_cbt cb) {
+    if (radio_vars.busy || duration == 0) {
+        return false;
+    }
+
+    radio_vars.cca = true;
+    radio_vars.cca_threshold = threshold;
+    radio_rx_start(RX_PKT_ANY_LEN, duration, cb);
+    return true;
+}
+
+// Turn the receiver off and end the pending RX operation without invoking its
+// completion callback. Frames already in the RX ring are kept.
+void radio_rx_cancel(void) {
+    if (!radio_vars.busy || radio_vars.radio_mode != RX_MODE) {
+        return;
+    }
+
+    radio_rfOff();
+    radio_vars.rx_continuous = false;
+    radio_vars.done_cb = NULL;
+    radio_complete(RADIO_STATUS_TIMEOUT);
+}
+
+// Return the oldest frame in the RX ring without removing it, or NULL if the
+// ring is empty. The slot stays valid until radio_rx_release() is called.
+radio_rx_slot_t* radio_rx_peek(void) {
+    if (radio_vars.rx_ring_tail == radio_vars.rx_ring_head) {
+        return NULL;
+    }
+    return &radio_vars.rx_ring[radio_vars.rx_ring_tail];
+}
+
+// Hand the oldest frame in the RX ring back to the radio. A valid frame first
+// feeds the frequency tracking loop of its channel, and any frame the IF
+// power control, if enabled. Must be called from thread context.
+void radio_rx_release(void) {
+    radio_rx_slot_t* slot;
+
+    if (radio_vars.rx_ring_tail == radio_vars.rx_ring_head) {
+        return;
+    }
+
+    slot = &radio_vars.rx_ring[radio_vars.rx_ring_tail];
+    // The IF and chip rate estimates come from the matched filter path
+    if (radio_vars.frequency_tracking && slot->crc_ok &&
+        radio_vars.stats.demodulator == RADIO_DEMOD_MF) {
+        radio_frequency_track(slot->channel, slot->length, slot->IF_estimate,
+                              slot->LQI_chip_errors, slot->cdr_tau_value);
+    }
+    if (radio_vars.if_power_control) {
+        radio_if_power_track(slot);
+    }
+    radio_vars.rx_ring_tail = radio_rx_ring_next(radio_vars.rx_ring_tail);
+
+    radio_demod_update();
+    radio_if_power_update();
+}
+
+// Pass every pending frame with a valid CRC to the RX callback and empty the
+// ring. Must be called from thread context. Returns the number of frames
+// handed to the callback.
+uint8_t radio_rx_drain(void) {
+    radio_rx_slot_t* slot;
+    uint8_t num_frames = 0;
+
+    while ((slot = radio_rx_peek()) != NULL) {
+        if (slot->crc_ok && radio_vars.radio_rx_cb != NULL) {
+            radio_vars.radio_rx_cb(&slot->buffer[1], slot->length);
+            num_frames++;
+        }
+        radio_rx_release();
+    }
+    radio_demod_update();
+    radio_if_power_update();
+    return num_frames;
+}
+
+// Number of frames lost because the RX ring was full.
+uint32_t radio_rx_drop_count(void) { return radio_vars.stats.rx_drops; }
+
+// Copy the radio event counters. The copy is taken with the radio interrupt
+// masked so that the counters are consistent with each other.
+void radio_get_stats(radio_stats_t* stats) {
+    radio_disable_interrupts();
+    *stats = radio_vars.stats;
+    radio_enable_interrupts();
+}
+
+void radio_reset_stats(void) {
+    uint8_t threshold = radio_vars.stats.correlation_threshold;
+    uint8_t demodulator = radio_vars.stats.demodulator;
+    uint8_t if_level = radio_vars.stats.if_level;
+
+    radio_disable_interrupts();
+    memset(&radio_vars.stats, 0, sizeof(radio_stats_t));
+    radio_vars.stats.correlation_threshold = threshold;
+    radio_vars.stats.demodulator = demodulator;
+    radio_vars.stats.if_level = if_level;
+    radio_enable_interrupts();
+}
+
+// Send the loaded frame exactly when the RF timer reaches ticks. The compare
+// channel triggers TX_SEND in hardware, so the frame start does not depend on
+// interrupt latency. The frame must already be loaded and radio_txEnable()
+// called at least ~50 us before ticks. cb is called as for radio_tx_async().
+// Returns false, and sends nothing, if ticks is already in the past or the
+// radio is busy.
+bool radio_schedule_tx_at(uint32_t ticks, radio_done_cbt cb) {
+    if (radio_vars.busy) {
+        return false;
+    }
 
+    radio_vars.radio_mode = TX_MODE;
+    radio_vars.done_cb = cb;
+    radio_vars.busy = true;
+
+    rftimer_set_callback_by_id(NULL, RADIO_RFTIMER_TX_ID);
+    if (!rftimer_setCompareAction_by_id(ticks, RADIO_RFTIMER_TX_ID,
+                                        RFTIMER_COMPARE_TX_SEND_ENABLE)) {
+        radio_vars.done_cb = NULL;
+        radio_vars.busy = false;
+        return false;
+    }
+    return true;
+}
+
+// Open a receive window between the RF timer counts start and stop. RX_START
+// and RX_STOP are triggered in hardware by two compare channels; the stop is
+// cancelled as soon as an SFD is detected so that a frame in flight is
+// received completely. radio_rxEnable() must be called at least ~50 us before
+// start. cb is called as for radio_rx_async(), with RADIO_STATUS_TIMEOUT if
+// the window closes empty or the frame received is not queued. Returns false
+// if start is already in the past or the radio is busy.
+bool radio_schedule_rx_window(uint32_t start, uint32_t stop,
+                              radio_done_cbt cb) {
+    if (radio_vars.busy) {
+        return false;
+    }
+
+    radio_vars.radio_mode = RX_MODE;
+    radio_vars.rxPacket_len = RX_PKT_ANY_LEN;
+    radio_vars.done_cb = cb;
+    radio_vars.rx_timeout = 0;
     radio_vars.rxFrameStarted = false;
-    radio_rxEnable();
-    radio_rxNow();
-    if (timeout) rftimer_setCompareIn(rftimer_readCounter() + TIMER_PERIOD_RX);
-    radio_vars.receiveDone = false;
-    while (!radio_vars.receiveDone) {}
+    radio_vars.rx_window = true;
+    radio_vars.busy = true;
+
+    // Reset digital baseband now, RX_START only starts the RX FSM
+    SCUM_ANALOG_CFG_REG_4 = 0x2000;
+    SCUM_ANALOG_CFG_REG_4 = 0x2800;
+
+    rftimer_set_callback_by_id(NULL, RADIO_RFTIMER_RX_START_ID);
+    rftimer_set_callback_by_id(cb_timer_rx_window_end,
+                               RADIO_RFTIMER_RX_STOP_ID);
+    if (!rftimer_setCompareAction_by_id(start, RADIO_RFTIMER_RX_START_ID,
+                                        RFTIMER_COMPARE_RX_START_ENABLE) ||
+        !rftimer_setCompareAction_by_id(stop, RADIO_RFTIMER_RX_STOP_ID,
+                                        RFTIMER_COMPARE_RX_STOP_ENABLE)) {
+        rftimer_disable_interrupts_by_id(RADIO_RFTIMER_RX_START_ID);
+        radio_vars.rx_window = false;
+        radio_vars.done_cb = NULL;
+        radio_vars.busy = false;
+        return false;
+    }
+    return true;
+}
+
+// Set the packet detection threshold, the Hamming distance below which the
+// chip stream is taken as a packet
+void radio_set_correlation_threshold(uint8_t threshold) {
+    radio_vars.stats.correlation_threshold = threshold;
+    SCUM_ANALOG_CFG_REG_9 = threshold;
+}
+
+// Adapt the packet detection threshold within [min, max] at runtime: it is
+// lowered while most SFDs turn out to be false detections, which wake the
+// CPU for nothing, and raised while they are rare or frames are reported
+// missed. Disabling keeps the current threshold.
+void radio_set_adaptive_threshold(bool enable, uint8_t min, uint8_t max) {
+    radio_disable_interrupts();
+    radio_vars.threshold_adaptive = enable && min <= max;
+    radio_vars.threshold_min = min;
+    radio_vars.threshold_max = max;
+    radio_vars.threshold_sfd = 0;
+    radio_vars.threshold_valid = 0;
+    radio_vars.threshold_missed = 0;
+    radio_enable_interrupts();
+}
+
+// Tell the radio that count frames were expected but not received, e.g. from
+// sequence number gaps or a MAC that heard energy without a frame. This is
+// the missed-frame input of the adaptive threshold.
+void radio_report_missed_frames(uint16_t count) {
+    radio_disable_interrupts();
+    radio_vars.stats.rx_missed += count;
+    radio_vars.threshold_missed += count;
+    radio_vars.demod_missed += count;
+    radio_vars.if_missed += count;
+    radio_threshold_update();
+    radio_enable_interrupts();
+}
+
+// Switch the receiver to the matched filter or zero-crossing demodulator.
+// Only the RX bits of the analog scan chain change and the calibrated IF
+// clock and packet detection threshold are kept. A listening receiver is
+// re-armed on the new demodulator. Must be called from thread context.
+// Returns false if a frame is being received or sent, or a receive window is
+// scheduled; the switch then happens from the next radio_rx_release() or
+// radio_rx_drain().
+bool radio_set_demodulator(radio_demod_t demod) {
+    return radio_demod_apply(demod);
+}
+
+radio_demod_t radio_get_demodulator(void) {
+    return (radio_demod_t)radio_vars.stats.demodulator;
+}
+
+// Pick the demodulator at runtime: the current one is scored over windows of
+// window frames (received, failed CRC or reported missed through
+// radio_report_missed_frames()) and the other one is tried periodically; the
+// one with the lower packet error rate, then CRC failure rate, is kept. The
+// rates are in the stats. Frames a demodulator does not detect at all only
+// count if they are reported missed. window 0 selects the default.
+void radio_set_demod_auto(bool enable, uint16_t window) {
+    radio_disable_interrupts();
+    radio_vars.demod_auto = enable;
+    radio_vars.demod_window = window ? window : DEMOD_DEFAULT_WINDOW;
+    radio_vars.demod_probing = false;
+    radio_vars.demod_hold = 0;
+    radio_vars.demod_ok = 0;
+    radio_vars.demod_crc = 0;
+    radio_vars.demod_missed = 0;
+    radio_enable_interrupts();
+}
+
+// Pick the IF gain and LDO level from the frames received: the lowest level
+// that keeps the chip errors in the first 256 chips of each frame at or below
+// chip_error_target (0 selects the default) is searched for, stepping down
+// slowly while frames are clean and strong and up quickly on errors or frames
+// reported missed through radio_report_missed_frames(). Frames consumed by
+// the RX hook are not seen. Disabling goes back to the highest level.
+void radio_set_if_power_control(bool enable, uint8_t chip_error_target) {
+    radio_disable_interrupts();
+    radio_vars.if_power_control = enable;
+    radio_vars.if_chip_errors_target =
+        chip_error_target ? chip_error_target : IF_POWER_DEFAULT_CHIP_ERRORS;
+    radio_vars.if_good_frames = 0;
+    radio_vars.if_missed = 0;
+    radio_enable_interrupts();
+
+    if (!enable) {
+        radio_set_if_level(RADIO_IF_LEVEL_MAX);
+    }
+}
+
+// Program IF level level, 0 being the lowest power. If the radio is sending,
+// receiving a frame or in a scheduled receive window, this happens from the
+// next radio_rx_release() or radio_rx_drain(). Must be called from thread
+// context. Returns false if level does not exist.
+bool radio_set_if_level(uint8_t level) {
+    if (level >= RADIO_NUM_IF_LEVELS) {
+        return false;
+    }
+
+    radio_vars.if_level = level;
+    radio_vars.if_good_frames = 0;
+    radio_if_power_update();
+    return true;
+}
+
+uint8_t radio_get_if_level(void) { return radio_vars.stats.if_level; }
+
+// Start streaming raw chips: once the chip shift register matches its start
+// value, every 32 chips are pushed into the raw chip ring until
+// radio_rawchips_stop() is called. The receiver must be on. The ring is
+// emptied. Does nothing if RADIO_RAWCHIPS_RING_SIZE is 0.
+void radio_rawchips_start(void) {
+    if (RADIO_RAWCHIPS_RING_SIZE == 0) {
+        return;
+    }
+
+    NVIC_DisableIRQ(RAWCHIPS_32_IRQn);
+
+    radio_vars.rawchips_head = 0;
+    radio_vars.rawchips_tail = 0;
+    radio_vars.rawchips_gap = false;
+    radio_vars.rawchips_dropped = 0;
+
+    // Clear both raw chip interrupts
+    acfg3_val |= 0x60;
+    SCUM_ANALOG_CFG_REG_3 = acfg3_val;
+    acfg3_val &= ~(0x60);
+    SCUM_ANALOG_CFG_REG_3 = acfg3_val;
+
+    NVIC_ClearPendingIRQ(RAWCHIPS_STARTVAL_IRQn);
+    NVIC_EnableIRQ(RAWCHIPS_STARTVAL_IRQn);
+}
+
+void radio_rawchips_stop(void) {
+    NVIC_DisableIRQ(RAWCHIPS_STARTVAL_IRQn);
+    NVIC_DisableIRQ(RAWCHIPS_32_IRQn);
+}
+
+// Move up to max captured words, oldest first, into words and return their
+// number. Reading stops at a gap left by dropped words; gap is set on the
+// next call, whose first word follows the gap.
+uint16_t radio_rawchips_read(uint32_t* words, uint16_t max, bool* gap) {
+    uint16_t head = radio_vars.rawchips_head;
+    uint16_t tail = radio_vars.rawchips_tail;
+    uint16_t count = 0;
+
+    *gap = false;
+    if (radio_vars.rawchips_gap && tail == radio_vars.rawchips_gap_at) {
+        __disable_irq();
+        radio_vars.rawchips_gap = false;
+        __enable_irq();
+        *gap = true;
+        head = radio_vars.rawchips_head;
+    }
+
+    while (tail != head && count < max) {
+        if (radio_vars.rawchips_gap && tail == radio_vars.rawchips_gap_at) {
+            break;
+        }
+        words[count++] = radio_vars.rawchips_ring[tail];
+        tail = (tail + 1) & (RADIO_RAWCHIPS_RING_SIZE - 1);
+    }
+
+    radio_vars.rawchips_tail = tail;
+    return count;
+}
+
+uint32_t radio_rawchips_dropped(void) { return radio_vars.rawchips_dropped; }
+
+// Only receive frames addressed to us: frames whose destination PAN ID is
+// neither pan_id nor broadcast, or whose destination address is neither
+// short_addr, the broadcast address nor ext_addr (8 bytes, in over-the-air
+// order; NULL if unused) are dropped before they reach the RX hook or the RX
+// ring. Long frames are aborted as soon as their address fields are in, and
+// the receiver is re-armed. Frames without a destination address, such as
+// beacons and immediate ACKs, always pass.
+void radio_set_address_filter(uint16_t pan_id, uint16_t short_addr,
+                              const uint8_t* ext_addr) {
+    radio_vars.filter_enabled = false;
+
+    radio_vars.filter_pan_id = pan_id;
+    radio_vars.filter_short_addr = short_addr;
+    radio_vars.filter_ext_enabled = ext_addr != NULL;
+    if (ext_addr != NULL) {
+        memcpy(radio_vars.filter_ext_addr, ext_addr,
+               IEEE_802_15_4_EXT_ADDR_LENGTH);
+    }
+
+    rftimer_set_callback_by_id(cb_timer_filter, RADIO_RFTIMER_FILTER_ID);
+    radio_vars.filter_enabled = true;
+}
+
+void radio_clear_address_filter(void) {
+    radio_vars.filter_enabled = false;
+    rftimer_disable_interrupts_by_id(RADIO_RFTIMER_FILTER_ID);
+}
+
+// Install a hook called from the RX interrupt for every frame with a valid
+// CRC, before the frame is queued. The slot metadata is already filled in and
+// timestamp is the RF timer count at the end of the frame. The verdict decides
+// what happens to the frame; RADIO_RX_HOOK_CONSUME ends a one-shot receive
+// operation with RADIO_STATUS_RECEIVED as if the frame had been queued.
+void radio_set_rx_hook(radio_rx_hook_cbt hook) { radio_vars.rx_hook = hook; }
+
+// Reply to the frame being processed, e.g. with an acknowledgment. Must only
+// be called from the RX hook. Once the hook returns, the receiver is turned
+// off, the LO is retuned to the TX code of the current channel and packet
+// (4-byte aligned, pkt_len including the CRC) is sent when the RF timer
+// reaches ticks, or as soon as it is loaded if ticks is already in the past.
+// The receive operation then resumes or completes as it would have without
+// the reply. No TX callback is called for the reply.
+bool radio_reply_at(const void* packet, uint8_t pkt_len, uint32_t ticks) {
+    if (((uint32_t)packet & 0x3) != 0 || pkt_len > MAXLENGTH_TRX_BUFFER) {
+        return false;
+    }
+
+    radio_vars.ack_desc.packet = packet;
+    radio_vars.ack_desc.len = pkt_len;
+    radio_vars.ack_ticks = ticks;
+    radio_vars.ack_requested = true;
+    return true;
 }
 
 void cb_startFrame_tx_radio(uint32_t timestamp) {}
 
 void cb_endFrame_tx_radio(uint32_t timestamp) {
     radio_rfOff();
-    radio_vars.sendDone = true;
+    radio_complete(RADIO_STATUS_SENT);
 }
 
 void cb_startFrame_rx_radio(uint32_t timestamp) {
     radio_vars.rxFrameStarted = true;
+    radio_vars.rx_sfd_timestamp = timestamp;
+
+    // Keep a scheduled receive window open until the frame is complete
+    if (radio_vars.rx_window) {
+        rftimer_disable_interrupts_by_id(RADIO_RFTIMER_RX_STOP_ID);
+    }
+
+    // A CCA must see the frame through, whoever it is addressed to
+    if (radio_vars.filter_enabled && !radio_vars.cca) {
+        rftimer_setCompareIn_by_id(timestamp + FILTER_CHECK_TICKS,
+                                   RADIO_RFTIMER_FILTER_ID);
+    }
 }
 
+// Complete the ring slot the DMA has just written and move the DMA to the next
+// free slot. Nothing is copied here: the application drains the ring from
+// thread context.
 void cb_endFrame_rx_radio(uint32_t timestamp) {
-    uint8_t packet_len = 0;
+    radio_rx_slot_t* slot = &radio_vars.rx_ring[radio_vars.rx_ring_head];
+    radio_rx_verdict_t verdict = RADIO_RX_HOOK_QUEUE;
+    bool dropped = false;
+    uint8_t next;
+
+    radio_vars.rxFrameStarted = false;
+    if (radio_vars.filter_enabled) {
+        rftimer_disable_interrupts_by_id(RADIO_RFTIMER_FILTER_ID);
+    }
+
+    slot->length = slot->buffer[LEN_PKT_INDEX];
+    slot->crc_ok = radio_getCrcOk();
+
+    // Packet must be of correct length (if specified a priori)
+    if (slot->crc_ok && radio_vars.rxPacket_len != RX_PKT_ANY_LEN &&
+        slot->length != radio_vars.rxPacket_len) {
+        // not the packet we are waiting for, go back to receiving...
+        radio_rx_resume();
+        return;
+    }
 
-    memset(radio_vars.rxPacket, 0, RX_PKT_ANY_LEN * sizeof(uint8_t));
-    radio_getReceivedFrame(radio_vars.rxPacket, &packet_len,
-                           radio_vars.rxPacket_len, &radio_vars.rxpk_rssi,
-                           &radio_vars.rxpk_lqi);
+    if (slot->crc_ok && radio_vars.filter_enabled &&
+        !radio_address_match(slot->buffer)) {
+        radio_vars.stats.rx_filtered++;
+        radio_rx_resume();
+        return;
+    }
+
+    slot->timestamp = radio_vars.rx_sfd_timestamp;
+    slot->rssi = radio_get_rssi();
+    slot->lqi = read_LQI();
+    slot->IF_estimate = radio_getIFestimate();
+    slot->LQI_chip_errors = radio_getLQIchipErrors();
+    slot->cdr_tau_value = radio_get_cdr_tau_value();
+    slot->channel = radio_vars.current_frequency;
 
-    // CRC must be ok and packet must be of correct length (if specified a
-    // priori)
-    if (radio_getCrcOk() && (radio_vars.rxPacket_len == RX_PKT_ANY_LEN ||
-                             packet_len == radio_vars.rxPacket_len)) {
+    if (slot->crc_ok) {
         // Only record IF estimate, LQI, and CDR tau for valid packets
-        radio_vars.IF_estimate = radio_getIFestimate();
-        radio_vars.LQI_chip_errors = radio_getLQIchipErrors();
-        radio_vars.radio_rx_cb(radio_vars.rxPacket, packet_len);
-        // printf("IF: %d \r\n", radio_vars.IF_estimate);
-    } else {
-        // go back to receiving...
-        radio_rxEnable();
-        radio_rxNow();
+        radio_vars.IF_estimate = slot->IF_estimate;
+        radio_vars.LQI_chip_errors = slot->LQI_chip_errors;
+        radio_vars.cdr_tau_value = slot->cdr_tau_value;
+        radio_vars.rx_last_len = slot->length;
+
+        if (radio_vars.rx_hook != NULL) {
+            verdict = radio_vars.rx_hook(slot, timestamp);
+        }
     }
 
-    radio_vars.rxFrameStarted = false;
-    radio_vars.receiveDone = true;
+    if (verdict == RADIO_RX_HOOK_QUEUE) {
+        next = radio_rx_ring_next(radio_vars.rx_ring_head);
+        if (next != radio_vars.rx_ring_tail) {
+            radio_vars.rx_ring_head = next;
+        } else {
+            // Ring full: the slot is reused and this frame is lost. It is
+            // not acknowledged either, so that the sender retries it.
+            radio_vars.stats.rx_drops++;
+            radio_vars.ack_requested = false;
+            dropped = true;
+        }
+    }
+
+    if (radio_vars.ack_requested) {
+        radio_vars.ack_resume_rx =
+            radio_vars.rx_continuous || verdict == RADIO_RX_HOOK_DROP;
+        radio_ack_start();
+        return;
+    }
+
+    if (radio_vars.rx_continuous || verdict == RADIO_RX_HOOK_DROP) {
+        radio_rx_resume();
+        return;
+    }
+
+    radio_rfOff();
+    if (dropped) {
+        radio_complete(RADIO_STATUS_RX_DROPPED);
+    } else {
+        radio_complete(slot->crc_ok ? RADIO_STATUS_RECEIVED
+                                    : RADIO_STATUS_CRC_FAIL);
+    }
 }
 
 // Repeatedly perform a radio operation. Supports RX/TX and sweeping/fixed LC
@@ -346,7 +1196,7 @@ void default_radio_rx_cb(uint8_t* packet, uint8_t packet_len) {
     printf("Received Packet. Contents: ");
 
     for (i = 0; i < packet_len - LENGTH_CRC; i++) {
-        printf("%d ", radio_vars.rxPacket[i]);
+        printf("%d ", packet[i]);
     }
     printf("\n");
 }
@@ -355,22 +1205,53 @@ void cb_timer_radio(void) {
     if (radio_vars.radio_mode == TX_MODE) {
         // Tranmit the packet
         radio_txNow();
+    } else if (radio_vars.radio_mode == RX_MODE && radio_vars.cca) {
+        // Sample the energy before turning the receiver off
+        bool busy = radio_vars.rxFrameStarted ||
+                    radio_get_rssi() >= radio_vars.cca_threshold;
+
+        radio_rfOff();
+        radio_complete(busy ? RADIO_STATUS_CCA_BUSY : RADIO_STATUS_CCA_CLEAR);
     } else if (radio_vars.radio_mode == RX_MODE) {
         // Stop attempting to receive
-        radio_vars.receiveDone = true;
+        radio_vars.stats.rx_timeouts++;
         radio_rfOff();
+        radio_complete(RADIO_STATUS_TIMEOUT);
     }
 }
 
 void radio_init(void) {
+    uint8_t i;
+    uint8_t j;
+
     // clear variables
     memset(&radio_vars, 0, sizeof(radio_vars_t));
 
     // skip building a channel table for now; hardcode LC values
-    radio_vars.tx_channel_codes[0] = LC_CODE_TX;
-    radio_vars.rx_channel_codes[0] = LC_CODE_RX;
+    for (i = 0; i < IEEE_802_15_4_NUM_CHANNELS; i++) {
+        radio_vars.tx_channel_codes[i] = LC_CODE_TX + i * LC_CODE_CHANNEL_STEP;
+        radio_vars.rx_channel_codes[i] = LC_CODE_RX + i * LC_CODE_CHANNEL_STEP;
+        radio_update_channel_words(i);
+    }
+    radio_vars.current_frequency = DEFAULT_FREQ;
+    radio_vars.filter_pan_id = DEFAULT_PANID;
+    radio_vars.stats.correlation_threshold = CORRELATION_THRESHOLD_DEFAULT;
+    radio_vars.threshold_min = THRESHOLD_DEFAULT_MIN;
+    radio_vars.threshold_max = THRESHOLD_DEFAULT_MAX;
+    radio_vars.stats.demodulator = RADIO_DEMOD_MF;
+    radio_vars.demod_window = DEMOD_DEFAULT_WINDOW;
+    radio_vars.if_level = RADIO_IF_LEVEL_MAX;
+    radio_vars.stats.if_level = RADIO_IF_LEVEL_MAX;
+    radio_vars.if_chip_errors_target = IF_POWER_DEFAULT_CHIP_ERRORS;
+    radio_vars.current_freq_mode = FREQ_RX;
 
     radio_vars.frequency_update_rate = FREQ_UPDATE_RATE;
+    radio_vars.frequency_tracking = true;
+    for (i = 0; i < IEEE_802_15_4_NUM_CHANNELS; i++) {
+        for (j = 0; j < FILTER_WINDOWS_LEN; j++) {
+            radio_vars.if_filters[i].history[j] = IF_ESTIMATE_NOMINAL;
+        }
+    }
 
     // Enable radio interrupts in NVIC
     NVIC_EnableIRQ(RF_IRQn);
@@ -379,16 +1260,27 @@ void radio_init(void) {
     // enable sfd done and receiving done interruptions of reception
     SCUM_RF->INT_CONFIG = TX_LOAD_DONE_INT_EN | TX_SFD_DONE_INT_EN |
                                    TX_SEND_DONE_INT_EN | RX_SFD_DONE_INT_EN |
-                                   RX_DONE_INT_EN;
-
-    // Enable all errors
-    //    SCUM_RF->ERROR_CONFIG  = (TX_OVERFLOW_ERROR_EN          |
-    //                                       TX_CUTOFF_ERROR_EN            |
-    //                                       RX_OVERFLOW_ERROR_EN          |
-    //                                       RX_CRC_ERROR_EN               |
-    //                                       RX_CUTOFF_ERROR_EN);
-
-    SCUM_RF->ERROR_CONFIG = RX_CRC_ERROR_EN;
+                                   RX_DONE_INT_EN |
+                                   TX_SFD_DONE_RFTIMER_PULSE_EN |
+                                   TX_SEND_DONE_RFTIMER_PULSE_EN |
+                                   RX_SFD_DONE_RFTIMER_PULSE_EN |
+                                   RX_DONE_RFTIMER_PULSE_EN;
+
+    // Latch the RF timer count in hardware on every frame event, so that the
+    // timestamps handed to the callbacks do not depend on interrupt latency
+    SCUM_RFTIMER->CAPTURE_CONTROL[RADIO_CAPTURE_TX_SFD] =
+        RFTIMER_CAPTURE_INPUT_SEL_TX_SFD_DONE;
+    SCUM_RFTIMER->CAPTURE_CONTROL[RADIO_CAPTURE_TX_SEND_DONE] =
+        RFTIMER_CAPTURE_INPUT_SEL_TX_SEND_DONE;
+    SCUM_RFTIMER->CAPTURE_CONTROL[RADIO_CAPTURE_RX_SFD] =
+        RFTIMER_CAPTURE_INPUT_SEL_RX_SFD_DONE;
+    SCUM_RFTIMER->CAPTURE_CONTROL[RADIO_CAPTURE_RX_DONE] =
+        RFTIMER_CAPTURE_INPUT_SEL_RX_DONE;
+
+    // Enable all errors; they are only counted in radio_vars.stats
+    SCUM_RF->ERROR_CONFIG = TX_OVERFLOW_ERROR_EN | TX_CUTOFF_ERROR_EN |
+                            RX_OVERFLOW_ERROR_EN | RX_CRC_ERROR_EN |
+                            RX_CUTOFF_ERROR_EN;
 
     // Set interrupt callbacks
     radio_setStartFrameTxCb(cb_startFrame_tx_radio);
@@ -423,8 +1315,15 @@ void radio_reset(void) {
     SCUM_RF->CONTROL = RF_RESET;
 }
 
-void radio_setFrequency(uint8_t frequency, radio_freq_t tx_or_rx) {
-    radio_vars.current_frequency = DEFAULT_FREQ;
+// Tune the LO to an 802.15.4 channel (11 to 26) for TX or RX. Returns false,
+// and leaves the LO untouched, if the channel is out of range.
+bool radio_setFrequency(uint8_t channel, radio_freq_t tx_or_rx) {
+    if (!ieee_802_15_4_validate_channel(channel)) {
+        return false;
+    }
+
+    radio_vars.current_frequency = channel;
+    radio_vars.current_freq_mode = tx_or_rx;
 
     switch (tx_or_rx) {
         case FREQ_TX:
@@ -437,18 +1336,79 @@ void radio_setFrequency(uint8_t frequency, radio_freq_t tx_or_rx) {
             // shouldn't happen
             break;
     }
+    return true;
+}
+
+uint8_t radio_getFrequency(void) { return radio_vars.current_frequency; }
+
+// Replace the channel table, e.g. with one saved from a previous calibration
+void radio_load_channel_table(const radio_channel_table_t* table) {
+    uint8_t i;
+
+    for (i = 0; i < IEEE_802_15_4_NUM_CHANNELS; i++) {
+        radio_vars.rx_channel_codes[i] = table->rx_codes[i];
+        radio_vars.tx_channel_codes[i] = table->tx_codes[i];
+        radio_update_channel_words(i);
+    }
+}
+
+// Copy the current channel table, including the corrections made by
+// radio_frequency_housekeeping()
+void radio_export_channel_table(radio_channel_table_t* table) {
+    memcpy(table->rx_codes, radio_vars.rx_channel_codes,
+           sizeof(table->rx_codes));
+    memcpy(table->tx_codes, radio_vars.tx_channel_codes,
+           sizeof(table->tx_codes));
 }
 
+// Copy the packet into the driver's TX buffer and load it into the TX FIFO.
+// Any frame queued with radio_tx_queue() is discarded.
 void radio_loadPacket(void* packet, uint16_t len) {
     memcpy(radio_vars.radio_tx_buffer, packet, len);
 
-    // load packet in TXFIFO
-    SCUM_RF->TX_DATA_ADDR = (uint32_t)radio_vars.radio_tx_buffer;
-    SCUM_RF->TX_PACK_LEN = len;
+    radio_vars.tx_desc_count = 0;
+    radio_vars.tx_chained = false;
+    radio_tx_queue(radio_vars.radio_tx_buffer, len);
+}
 
-    SCUM_RF->CONTROL = TX_LOAD;
+// Queue a frame for transmission without copying it. packet must be 4-byte
+// aligned and stay untouched until the frame has been sent. If the radio has
+// no frame loaded, the frame is loaded right away and sent on the next
+// radio_txNow(). Otherwise it waits behind the current frame and is sent
+// straight after it, without turning the radio off in between; the end of
+// frame TX callback only fires once the last queued frame is sent. Returns
+// false if both descriptors are in use or the buffer is not usable.
+bool radio_tx_queue(const void* packet, uint16_t len) {
+    radio_tx_desc_t* desc;
+    uint8_t count;
+
+    if (((uint32_t)packet & 0x3) != 0 || len > MAXLENGTH_TRX_BUFFER) {
+        return false;
+    }
+
+    radio_disable_interrupts();
+    count = radio_vars.tx_desc_count;
+    if (count == RADIO_NUM_TX_DESC) {
+        radio_enable_interrupts();
+        return false;
+    }
+
+    desc = &radio_vars.tx_desc[(radio_vars.tx_desc_head + count) %
+                               RADIO_NUM_TX_DESC];
+    desc->packet = packet;
+    desc->len = len;
+    radio_vars.tx_desc_count = count + 1;
+
+    if (count == 0) {
+        radio_tx_desc_load(desc);
+    }
+    radio_enable_interrupts();
+    return true;
 }
 
+// Number of frames queued for transmission, including the one on the air.
+uint8_t radio_tx_pending(void) { return radio_vars.tx_desc_count; }
+
 // Turn on the radio for transmit
 // This should be done at least ~50 us before txNow()
 void radio_txEnable() {
@@ -494,7 +1454,8 @@ void radio_rxEnable() {
     SCUM_ANALOG_CFG_REG_16 = 0x1;
 
     // Where packet will be stored in memory
-    SCUM_DMA_RF_RX_ADDR = (uint8_t *)radio_vars.radio_rx_buffer;
+    SCUM_DMA_RF_RX_ADDR =
+        (uint8_t *)radio_vars.rx_ring[radio_vars.rx_ring_head].buffer;
 
     // Reset radio FSM
     SCUM_RF->CONTROL = RF_RESET;
@@ -510,22 +1471,34 @@ void radio_rxNow() {
     SCUM_RF->CONTROL = RX_START;
 }
 
+// Copy the oldest frame out of the RX ring and release its slot. *pLenRead is
+// set to 0 if no frame is pending.
 void radio_getReceivedFrame(uint8_t* pBufRead, uint8_t* pLenRead,
                             uint8_t maxBufLen, int8_t* pRssi, uint8_t* pLqi) {
+    radio_rx_slot_t* slot = radio_rx_peek();
+
+    if (slot == NULL) {
+        *pLenRead = 0;
+        return;
+    }
+
     //===== rssi
-    *pRssi = read_RSSI() + RSSI_REFERENCE;
+    *pRssi = slot->rssi;
 
     //===== lqi
-    *pLqi = read_LQI();
+    *pLqi = slot->lqi;
 
     //===== length
-    *pLenRead = radio_vars.radio_rx_buffer[0];
+    *pLenRead = slot->length;
 
     //===== packet
     if (*pLenRead <= maxBufLen) {
-        memcpy(pBufRead, &(radio_vars.radio_rx_buffer[1]), *pLenRead);
+        memcpy(pBufRead, &slot->buffer[1], *pLenRead);
     }
+
+    radio_rx_release();
 }
+
 void radio_rfOn(void) {
     // clear reset pin
     SCUM_RF->CONTROL &= ~RF_RESET;
@@ -542,291 +1515,596 @@ void radio_rfOff(void) {
     SCUM_ANALOG_CFG_REG_10 = 0x0000;
 }
 
+// Feed the frequency tracking loop of the current channel with the statistics
+// of the last packet received. Frames released from the RX ring are fed
+// automatically while tracking is enabled; this entry point is kept for
+// applications that read the statistics themselves.
 void radio_frequency_housekeeping(uint32_t IF_estimate,
                                   uint32_t LQI_chip_errors,
                                   int16_t cdr_tau_value) {
-    int jj;
-    unsigned int IF_est_filtered;
-    signed int chip_rate_error_ppm, chip_rate_error_ppm_filtered;
+    radio_frequency_track(radio_vars.current_frequency,
+                          radio_vars.rx_last_len, IF_estimate,
+                          LQI_chip_errors, cdr_tau_value);
+}
 
-    uint32_t IF_coarse = scm3c_hw_interface_get_IF_coarse();
-    uint32_t IF_fine = scm3c_hw_interface_get_IF_fine();
+// Enable or disable the automatic frequency tracking of radio_rx_release()
+void radio_set_frequency_tracking(bool enable) {
+    radio_vars.frequency_tracking = enable;
+}
 
-    uint16_t packet_len = radio_vars.radio_rx_buffer[0];
+void radio_enable_interrupts(void) {
+    // Enable radio interrupts in NVIC
+    NVIC_EnableIRQ(RF_IRQn);
+}
 
-    // When updating LO and IF clock frequncies, must wait long enough for the
-    // changes to propagate before changing again Need to receive as many
-    // packets as there are taps in the FIR filter
-    radio_vars.frequency_update_cooldown_timer++;
+void radio_disable_interrupts(void) {
+    // Clear radio interrupts in NVIC
+    NVIC_DisableIRQ(RF_IRQn);
+}
 
-    // FIR filter for cdr tau slope
-    int32_t sum = 0;
+bool radio_getCrcOk(void) { return radio_vars.crc_ok; }
 
-    // A tau value of 0 indicates there is no rate mistmatch between the TX and
-    // RX chip clocks The cdr_tau_value corresponds to the number of samples
-    // that were added or dropped by the CDR Each sample point is 1/16MHz
-    // = 62.5ns Need to estimate ppm error for each packet, then FIR those
-    // values to make tuning decisions error_in_ppm = 1e6 * (#adjustments
-    // * 62.5ns) / (packet length (bytes) * 64 chips/byte * 500ns/chip) Which
-    // can be simplified to (#adjustments * 15625) / (packet length * 8)
+uint32_t radio_getIFestimate(void) { return read_IF_estimate(); }
 
-    chip_rate_error_ppm = (cdr_tau_value * 15625) / (packet_len * 8);
+uint32_t radio_getLQIchipErrors(void) { return SCUM_ANALOG_CFG_REG_21; }
 
-    // Shift old samples
-    for (jj = 9; jj >= 0; jj--) {
-        cdr_tau_history[jj + 1] = cdr_tau_history[jj];
-    }
+int16_t radio_get_cdr_tau_value(void) { return SCUM_ANALOG_CFG_REG_25; }
 
-    // New sample
-    cdr_tau_history[0] = chip_rate_error_ppm;
+// Received power in dBm, from the AGC gain code; only meaningful while the
+// receiver is on. The highest gain (RSSI_REF_READ_VALUE) is RSSI_REFERENCE
+// and each step below it is 1 dB more, so the scale bottoms out at
+// RSSI_REFERENCE.
+int8_t radio_get_rssi(void) {
+    return RSSI_REFERENCE + (RSSI_REF_READ_VALUE - (int8_t)read_RSSI());
+}
 
-    // Do FIR convolution
-    for (jj = 0; jj <= 10; jj++) {
-        sum = sum + cdr_tau_history[jj] * FIR_coeff[jj];
+//=========================== private =========================================
+
+static void radio_rx_start(uint8_t pkt_len, uint32_t timeout,
+                           radio_done_cbt cb) {
+    radio_vars.radio_mode = RX_MODE;
+    radio_vars.rxPacket_len =
+        pkt_len <= RX_PKT_ANY_LEN ? pkt_len : RX_PKT_ANY_LEN;
+    radio_vars.done_cb = cb;
+    radio_vars.rx_timeout = timeout;
+    radio_vars.busy = true;
+
+    if (timeout) {
+        rftimer_set_callback_by_id(cb_timer_radio, RADIO_RFTIMER_RX_ID);
     }
 
-    // Divide by 512 (sum of the coefficients) to scale output
-    chip_rate_error_ppm_filtered = sum / 512;
+    radio_vars.rxFrameStarted = false;
+    radio_rxEnable();
+    radio_rxNow();
+    if (timeout) {
+        rftimer_setCompareIn_by_id(rftimer_readCounter() + timeout,
+                                   RADIO_RFTIMER_RX_ID);
+    }
+}
 
-    // printf("%d -- %d\r\n",cdr_tau_value,chip_rate_error_ppm_filtered);
+// Finish the pending asynchronous operation and notify its owner. The
+// operation is marked idle before the callback runs so that the callback can
+// start the next one.
+static void radio_complete(radio_status_t status) {
+    radio_done_cbt cb = radio_vars.done_cb;
 
-    // The IF clock frequency steps are about 2000ppm, so make an adjustment
-    // only if the error is larger than 1000ppm Must wait long enough between
-    // changes for FIR to settle (at least 10 packets) Need to add some handling
-    // here in case the IF_fine code will rollover with this change (0 <=
-    // IF_fine <= 31)
-    if (radio_vars.frequency_update_cooldown_timer ==
-        radio_vars.frequency_update_rate) {
-        if (chip_rate_error_ppm_filtered > 1000) {
-            set_IF_clock_frequency(IF_coarse, IF_fine++, 0);
-        }
-        if (chip_rate_error_ppm_filtered < -1000) {
-            set_IF_clock_frequency(IF_coarse, IF_fine--, 0);
-        }
+    if (radio_vars.radio_mode == TX_MODE) {
+        rftimer_disable_interrupts_by_id(RADIO_RFTIMER_TX_ID);
+    } else if (radio_vars.rx_timeout) {
+        rftimer_disable_interrupts_by_id(RADIO_RFTIMER_RX_ID);
+    }
+    if (radio_vars.rx_window) {
+        rftimer_disable_interrupts_by_id(RADIO_RFTIMER_RX_START_ID);
+        rftimer_disable_interrupts_by_id(RADIO_RFTIMER_RX_STOP_ID);
     }
-    scm3c_hw_interface_set_IF_coarse(IF_coarse);
-    scm3c_hw_interface_set_IF_fine(IF_fine);
 
-    // FIR filter for IF estimate
-    sum = 0;
+    radio_vars.done_cb = NULL;
+    radio_vars.rx_continuous = false;
+    radio_vars.rx_window = false;
+    radio_vars.cca = false;
+    radio_vars.busy = false;
 
-    // The IF estimate reports how many zero crossings (both pos and neg) there
-    // were in a 100us period The IF should on average be 2.5 MHz, which means
-    // the IF estimate will return ~500 when there is no IF error Each tick is
-    // roughly 5 kHz of error
+    if (cb != NULL) {
+        cb(status);
+    }
+}
 
-    // Only make adjustments when the chip error rate is <10% (this value was
-    // picked as an arbitrary choice) While packets can be received at higher
-    // chip error rates, the average IF estimate tends to be less accurate
-    // Estimated chip_error_rate = LQI_chip_errors/256 (assuming the packet
-    // length was at least 8 Bytes)
-    if (LQI_chip_errors < 25) {
-        // Shift old samples
-        for (jj = 9; jj >= 0; jj--) {
-            IF_estimate_history[jj + 1] = IF_estimate_history[jj];
-        }
+// The hardware has stopped a scheduled receive window without seeing an SFD
+static void cb_timer_rx_window_end(void) {
+    if (radio_vars.rxFrameStarted) {
+        return;
+    }
+
+    radio_vars.stats.rx_timeouts++;
+    radio_rfOff();
+    radio_complete(RADIO_STATUS_TIMEOUT);
+}
 
-        // New sample
-        IF_estimate_history[0] = IF_estimate;
+// Whether the destination of the frame in buffer (PHY length byte first)
+// passes the address filter
+static bool radio_address_match(const uint8_t* buffer) {
+    uint16_t fcf = buffer[FCF_LBYTE_PKT_INDEX] |
+                   (buffer[FCF_HBYTE_PKT_INDEX] << 8);
+    ieee_802_15_4_frame_t view;
+    uint8_t index = PANID_LBYTE_PKT_INDEX;
+    uint8_t addr_len;
+    uint16_t value;
+
+    // Only the header fields the PAN ID presence depends on: the frame may
+    // still be arriving, too early for ieee_802_15_4_parse()
+    view.frame_version = (fcf >> IEEE_802_15_4_FCF_FRAME_VERSION_SHIFT) &
+                         IEEE_802_15_4_FCF_FIELD_MASK;
+    view.dst_addr_mode = (fcf >> IEEE_802_15_4_FCF_DST_ADDR_MODE_SHIFT) &
+                         IEEE_802_15_4_FCF_FIELD_MASK;
+    view.src_addr_mode = (fcf >> IEEE_802_15_4_FCF_SRC_ADDR_MODE_SHIFT) &
+                         IEEE_802_15_4_FCF_FIELD_MASK;
+    view.pan_id_compression = (fcf & IEEE_802_15_4_FCF_PAN_ID_COMPRESSION) != 0;
+    ieee_802_15_4_pan_ids_present(&view);
+
+    if (view.dst_addr_mode == IEEE_802_15_4_ADDR_MODE_NONE) {
+        return true;
+    }
 
-        // Do FIR convolution
-        for (jj = 0; jj <= 10; jj++) {
-            sum = sum + IF_estimate_history[jj] * FIR_coeff[jj];
+    addr_len = view.dst_addr_mode == IEEE_802_15_4_ADDR_MODE_EXTENDED
+                   ? IEEE_802_15_4_EXT_ADDR_LENGTH
+                   : 2;
+    if (view.frame_version == IEEE_802_15_4_FRAME_VERSION_2015 &&
+        (fcf & IEEE_802_15_4_FCF_SEQ_NUM_SUPPRESSION)) {
+        index--;
+    }
+
+    if (view.dst_pan_id_present) {
+        if (index + 2 + addr_len > buffer[LEN_PKT_INDEX] + 1) {
+            return false;
+        }
+        value = buffer[index] | (buffer[index + 1] << 8);
+        if (value != radio_vars.filter_pan_id &&
+            value != IEEE_802_15_4_BROADCAST_PAN_ID) {
+            return false;
         }
+        index += 2;
+    } else if (index + addr_len > buffer[LEN_PKT_INDEX] + 1) {
+        return false;
+    }
 
-        // Divide by 512 (sum of the coefficients) to scale output
-        IF_est_filtered = sum / 512;
-
-        // printf("%d - %d,
-        // %d\r\n",IF_estimate,IF_est_filtered,LQI_chip_errors);
-
-        // The LO frequency steps are about ~80-100 kHz, so make an adjustment
-        // only if the error is larger than that These hysteresis bounds (+/- X)
-        // have not been optimized Must wait long enough between changes for FIR
-        // to settle (at least as many packets as there are taps in the FIR) For
-        // now, assume that TX/RX should both be updated, even though the IF
-        // information is only from the RX code
-        if (radio_vars.frequency_update_cooldown_timer ==
-            radio_vars.frequency_update_rate) {
-            if (IF_est_filtered > 520) {
-                radio_vars
-                    .rx_channel_codes[radio_vars.current_frequency - 11]++;
-                radio_vars
-                    .tx_channel_codes[radio_vars.current_frequency - 11]++;
-            }
-            if (IF_est_filtered < 480) {
-                radio_vars
-                    .rx_channel_codes[radio_vars.current_frequency - 11]--;
-                radio_vars
-                    .tx_channel_codes[radio_vars.current_frequency - 11]--;
-            }
+    if (view.dst_addr_mode == IEEE_802_15_4_ADDR_MODE_SHORT) {
+        value = buffer[index] | (buffer[index + 1] << 8);
+        return value == radio_vars.filter_short_addr ||
+               value == IEEE_802_15_4_BROADCAST_ADDR;
+    }
+    if (view.dst_addr_mode == IEEE_802_15_4_ADDR_MODE_EXTENDED) {
+        return radio_vars.filter_ext_enabled &&
+               memcmp(&buffer[index], radio_vars.filter_ext_addr,
+                      IEEE_802_15_4_EXT_ADDR_LENGTH) == 0;
+    }
+    return false;
+}
 
-            // printf("--%d - %d\r\n",IF_estimate,IF_est_filtered);
+// The address fields of the frame being received are in the DMA buffer: stop
+// receiving it if it is not for us
+static void cb_timer_filter(void) {
+    const uint8_t* buffer = radio_vars.rx_ring[radio_vars.rx_ring_head].buffer;
 
-            radio_vars.frequency_update_cooldown_timer = 0;
-        }
+    rftimer_disable_interrupts_by_id(RADIO_RFTIMER_FILTER_ID);
+
+    if (!radio_vars.rxFrameStarted || radio_vars.radio_mode != RX_MODE ||
+        radio_vars.cca || buffer[LEN_PKT_INDEX] < FILTER_MIN_ABORT_LEN ||
+        buffer[LEN_PKT_INDEX] > MAXLENGTH_TRX_BUFFER - 1 ||
+        radio_address_match(buffer)) {
+        return;
     }
+
+    radio_vars.stats.rx_filtered++;
+    radio_vars.stats.rx_aborted++;
+    radio_vars.threshold_valid++;
+    radio_vars.demod_ok++;
+    radio_vars.rxFrameStarted = false;
+    radio_rx_resume();
 }
 
-void radio_enable_interrupts(void) {
-    // Enable radio interrupts in NVIC
-    NVIC_EnableIRQ(RF_IRQn);
+// Turn the radio around from RX to TX and send the reply requested by the RX
+// hook. This runs from the RX done interrupt, so the turnaround time is only
+// bounded by the work done here.
+static void radio_ack_start(void) {
+    radio_vars.ack_requested = false;
+    radio_vars.ack_in_flight = true;
+
+    // The frame has been received, the RX timeout must not cut the reply
+    if (radio_vars.rx_timeout) {
+        rftimer_disable_interrupts_by_id(RADIO_RFTIMER_RX_ID);
+    }
+
+    radio_rfOff();
+    setFrequencyTX(radio_vars.current_frequency);
+    radio_txEnable();
+
+    radio_vars.tx_desc_count = 0;
+    radio_vars.tx_chained = false;
+    radio_tx_queue(radio_vars.ack_desc.packet, radio_vars.ack_desc.len);
+
+    rftimer_set_callback_by_id(NULL, RADIO_RFTIMER_TX_ID);
+    if (!rftimer_setCompareAction_by_id(radio_vars.ack_ticks,
+                                        RADIO_RFTIMER_TX_ID,
+                                        RFTIMER_COMPARE_TX_SEND_ENABLE)) {
+        // Too late for the requested time, send as soon as it is loaded
+        radio_vars.tx_chained = true;
+    }
 }
 
-void radio_disable_interrupts(void) {
-    // Clear radio interrupts in NVIC
-    NVIC_DisableIRQ(RF_IRQn);
+// The reply is on the air: go back to the receive operation it interrupted
+static void radio_ack_done(void) {
+    radio_vars.ack_in_flight = false;
+    radio_vars.tx_desc_count = 0;
+    rftimer_disable_interrupts_by_id(RADIO_RFTIMER_TX_ID);
+
+    radio_rfOff();
+    if (radio_vars.ack_resume_rx && !radio_vars.rx_window) {
+        setFrequencyRX(radio_vars.current_frequency);
+        radio_vars.rxFrameStarted = false;
+        radio_rxEnable();
+        radio_rxNow();
+    } else if (radio_vars.ack_resume_rx) {
+        radio_complete(RADIO_STATUS_TIMEOUT);
+    } else {
+        radio_complete(RADIO_STATUS_RECEIVED);
+    }
 }
 
-bool radio_getCrcOk(void) { return radio_vars.crc_ok; }
+// Keep receiving after a frame that does not end the RX operation. The stop
+// of a scheduled receive window is cancelled by the SFD, so the window is
+// closed instead of leaving the receiver on without a bound.
+static void radio_rx_resume(void) {
+    if (radio_vars.rx_window) {
+        radio_rfOff();
+        radio_complete(RADIO_STATUS_TIMEOUT);
+        return;
+    }
+    radio_rx_rearm();
+}
 
-uint32_t radio_getIFestimate(void) { return read_IF_estimate(); }
+// Point the DMA at the current ring slot and start searching for the next
+// packet again.
+static void radio_rx_rearm(void) {
+    SCUM_DMA_RF_RX_ADDR =
+        (uint8_t *)radio_vars.rx_ring[radio_vars.rx_ring_head].buffer;
+    SCUM_RF->CONTROL = RF_RESET;
+    radio_rxNow();
+}
 
-uint32_t radio_getLQIchipErrors(void) { return SCUM_ANALOG_CFG_REG_21; }
+static inline uint8_t radio_rx_ring_next(uint8_t index) {
+    return (index + 1) % RADIO_RX_RING_SIZE;
+}
 
-int16_t radio_get_cdr_tau_value(void) { return SCUM_ANALOG_CFG_REG_25; }
+// Queue the next frame of the burst behind the one loaded. A frame that
+// cannot be queued ends the burst after those already queued.
+static void radio_burst_refill(void) {
+    const void* packet;
+    uint8_t pkt_len;
 
-//=========================== private =========================================
+    if (radio_vars.burst_next == NULL ||
+        radio_vars.tx_desc_count == RADIO_NUM_TX_DESC) {
+        return;
+    }
 
-// SCM has separate setFrequency functions for RX and TX because of the way the
-// radio is built. The LO needs to be set to a different frequency for TX vs RX.
-void setFrequencyRX(uint8_t channel) {
-    // Set LO code for RX channel
-    LC_monotonic(radio_vars.rx_channel_codes[channel - 11]);
+    packet = radio_vars.burst_next(&pkt_len);
+    if (packet == NULL || !radio_tx_queue(packet, pkt_len)) {
+        radio_vars.burst_next = NULL;
+    }
 }
 
-void setFrequencyTX(uint8_t channel) {
-    // Set LO code for TX channel
-    LC_monotonic(radio_vars.tx_channel_codes[channel - 11]);
+// Frame source of radio_tx_burst()
+static const void* radio_burst_next_frame(uint8_t* pkt_len) {
+    const radio_burst_frame_t* frame;
+
+    if (radio_vars.burst_index >= radio_vars.burst_num_frames) {
+        return NULL;
+    }
+
+    frame = &radio_vars.burst_frames[radio_vars.burst_index++];
+    *pkt_len = frame->pkt_len;
+    return frame->packet;
 }
 
-uint32_t build_RX_channel_table(uint32_t channel_11_LC_code) {
-    uint32_t count_LC[16];
-    uint32_t count_targets[17];
+// Load a frame into the TX FIFO
+static void radio_tx_desc_load(const radio_tx_desc_t* desc) {
+    SCUM_RF->TX_DATA_ADDR = (uint32_t)desc->packet;
+    SCUM_RF->TX_PACK_LEN = desc->len;
 
-    memset(count_LC, 0, sizeof(count_LC));
-    memset(count_targets, 0, sizeof(count_targets));
+    SCUM_RF->CONTROL = TX_LOAD;
+}
 
-    radio_vars.rx_channel_codes[0] = channel_11_LC_code;
+// Retire the frame that has just been sent. If another frame is queued behind
+// it, load it and have it sent on TX_LOAD_DONE; returns true in that case.
+static bool radio_tx_desc_done(void) {
+    if (radio_vars.tx_desc_count == 0) {
+        return false;
+    }
 
-    int32_t i = 0;
-    while (i < 16) {
-        LC_monotonic(radio_vars.rx_channel_codes[i]);
-        // analog_scan_chain_write_3B_fromFPGA(ASC);
-        // analog_scan_chain_load_3B_fromFPGA();
+    radio_vars.tx_desc_head = (radio_vars.tx_desc_head + 1) % RADIO_NUM_TX_DESC;
+    radio_vars.tx_desc_count--;
+
+    if (radio_vars.tx_desc_count == 0) {
+        return false;
+    }
 
-        // Reset all counters
-        SCUM_ANALOG_CFG_REG_0 = 0x0000;
+    radio_vars.tx_chained = true;
+    radio_tx_desc_load(&radio_vars.tx_desc[radio_vars.tx_desc_head]);
+    return true;
+}
 
-        // Enable all counters
-        SCUM_ANALOG_CFG_REG_0 = 0x3FFF;
+// Sleep until the pending asynchronous operation completes
+static void radio_wait_done(void) { radio_wait_while(&radio_vars.busy); }
 
-        // Count for some arbitrary amount of time
-        busy_wait_cycles(16000);
+// Recompute the LC register words of a channel after its codes changed
+static void radio_update_channel_words(uint8_t index) {
+    radio_vars.rx_channel_words[index] =
+        LC_monotonic_word(radio_vars.rx_channel_codes[index]);
+    radio_vars.tx_channel_words[index] =
+        LC_monotonic_word(radio_vars.tx_channel_codes[index]);
+}
 
-        // Disable all counters
-        SCUM_ANALOG_CFG_REG_0 = 0x007F;
+// Closed-loop IF and LO tracking. Adding a sample is O(1): it only overwrites
+// the oldest entry of a circular history. The FIR convolution is evaluated
+// once every frequency_update_rate samples, when a correction may be applied.
+static void radio_frequency_track(uint8_t channel, uint8_t packet_len,
+                                  uint32_t IF_estimate,
+                                  uint32_t LQI_chip_errors,
+                                  int16_t cdr_tau_value) {
+    radio_freq_filter_t* cdr = &radio_vars.cdr_filter;
+    radio_freq_filter_t* filter;
+    uint8_t index;
+    int32_t chip_rate_error_ppm_filtered;
+    uint32_t IF_est_filtered;
+    uint32_t IF_coarse;
+    uint32_t IF_fine;
+
+    if (!ieee_802_15_4_validate_channel(channel) || packet_len == 0 ||
+        packet_len >= MAXLENGTH_TRX_BUFFER) {
+        return;
+    }
 
-        // Read count result
-        count_LC[i] = SCUM_ANALOG_CFG_REG_10 + (SCUM_ANALOG_CFG_REG_11 << 16);
+    // A tau value of 0 indicates there is no rate mistmatch between the TX and
+    // RX chip clocks The cdr_tau_value corresponds to the number of samples
+    // that were added or dropped by the CDR Each sample point is 1/16MHz
+    // = 62.5ns Need to estimate ppm error for each packet, then FIR those
+    // values to make tuning decisions error_in_ppm = 1e6 * (#adjustments
+    // * 62.5ns) / (packet length (bytes) * 64 chips/byte * 500ns/chip) Which
+    // can be simplified to (#adjustments * 15625) / (packet length * 8)
+    // The division is replaced by the Q16 reciprocal table ppm_per_tau.
+    // The chip clock is shared by all channels, so there is a single filter.
+    cdr->history[cdr->head] =
+        ((int64_t)cdr_tau_value * ppm_per_tau[packet_len]) >> 16;
+    cdr->head = (cdr->head + 1) % FILTER_WINDOWS_LEN;
 
-        count_targets[i + 1] = ((961 + (i + 1) * 2) * count_LC[0]) / 961;
+    // The IF clock frequency steps are about 2000ppm, so make an adjustment
+    // only if the error is larger than 1000ppm Must wait long enough between
+    // changes for FIR to settle (at least 10 packets)
+    if (++cdr->cooldown >= radio_vars.frequency_update_rate) {
+        cdr->cooldown = 0;
+        chip_rate_error_ppm_filtered =
+            radio_fir(cdr->history, cdr->head) / FIR_COEFF_SCALE;
+
+        IF_coarse = scm3c_hw_interface_get_IF_coarse();
+        IF_fine = scm3c_hw_interface_get_IF_fine();
+        if (chip_rate_error_ppm_filtered > 1000 && IF_fine < 31) {
+            IF_fine++;
+        } else if (chip_rate_error_ppm_filtered < -1000 && IF_fine > 0) {
+            IF_fine--;
+        }
 
-        // Adjust LC_code to match new target
-        if (i > 0) {
-            if (count_LC[i] < (count_targets[i] - 20)) {
-                radio_vars.rx_channel_codes[i]++;
-            } else {
-                radio_vars.rx_channel_codes[i + 1] =
-                    radio_vars.rx_channel_codes[i] + 40;
-                i++;
-            }
+        if (IF_fine != scm3c_hw_interface_get_IF_fine()) {
+            set_IF_clock_frequency(IF_coarse, IF_fine, 0);
+            analog_scan_chain_write();
+            analog_scan_chain_load();
+            scm3c_hw_interface_set_IF_fine(IF_fine);
         }
+    }
 
-        if (i == 0) {
-            radio_vars.rx_channel_codes[i + 1] =
-                radio_vars.rx_channel_codes[i] + 40;
-            i++;
+    // The IF estimate reports how many zero crossings (both pos and neg) there
+    // were in a 100us period The IF should on average be 2.5 MHz, which means
+    // the IF estimate will return ~500 when there is no IF error Each tick is
+    // roughly 5 kHz of error
+
+    // Only make adjustments when the chip error rate is <10% (this value was
+    // picked as an arbitrary choice) While packets can be received at higher
+    // chip error rates, the average IF estimate tends to be less accurate
+    // Estimated chip_error_rate = LQI_chip_errors/256 (assuming the packet
+    // length was at least 8 Bytes)
+    if (LQI_chip_errors >= 25) {
+        return;
+    }
+
+    index = channel - IEEE_802_15_4_MIN_CHANNEL;
+    filter = &radio_vars.if_filters[index];
+    filter->history[filter->head] = IF_estimate;
+    filter->head = (filter->head + 1) % FILTER_WINDOWS_LEN;
+
+    // The LO frequency steps are about ~80-100 kHz, so make an adjustment only
+    // if the error is larger than that These hysteresis bounds (+/- X) have
+    // not been optimized Must wait long enough between changes for FIR to
+    // settle (at least as many packets as there are taps in the FIR) For now,
+    // assume that TX/RX should both be updated, even though the IF information
+    // is only from the RX code
+    if (++filter->cooldown < radio_vars.frequency_update_rate) {
+        return;
+    }
+    filter->cooldown = 0;
+
+    IF_est_filtered =
+        radio_fir(filter->history, filter->head) / FIR_COEFF_SCALE;
+    if (IF_est_filtered > 520) {
+        radio_vars.rx_channel_codes[index]++;
+        radio_vars.tx_channel_codes[index]++;
+    } else if (IF_est_filtered < 480) {
+        radio_vars.rx_channel_codes[index]--;
+        radio_vars.tx_channel_codes[index]--;
+    } else {
+        return;
+    }
+    radio_update_channel_words(index);
+
+    // Retune right away if the LO sits on this channel, unless a frame is on
+    // the air; otherwise the new code is used by the next radio_setFrequency()
+    if (channel == radio_vars.current_frequency &&
+        (!radio_vars.busy ||
+         (radio_vars.radio_mode == RX_MODE && !radio_vars.rxFrameStarted))) {
+        if (radio_vars.current_freq_mode == FREQ_TX) {
+            setFrequencyTX(channel);
+        } else {
+            setFrequencyRX(channel);
         }
     }
+}
+
+// Apply FIR_coeff to a circular history whose oldest sample is at head
+static int32_t radio_fir(const int32_t* history, uint8_t head) {
+    int32_t sum = 0;
+    uint8_t jj;
 
-    for (i = 0; i < 16; i++) {
-        //        printf(
-        //            "\r\nRX ch=%d, count_LC=%d, count_targets=%d,
-        //            rx_channel_codes=%d", i+11,count_LC[i],count_targets[i],
-        //            radio_vars.rx_channel_codes[i]
-        //        );
+    // FIR_coeff[0] weighs the newest sample
+    for (jj = 0; jj < FILTER_WINDOWS_LEN; jj++) {
+        head = head ? head - 1 : FILTER_WINDOWS_LEN - 1;
+        sum += history[head] * FIR_coeff[jj];
     }
+    return sum;
+}
 
-    return count_LC[0];
+// SCM has separate setFrequency functions for RX and TX because of the way the
+// radio is built. The LO needs to be set to a different frequency for TX vs RX.
+void setFrequencyRX(uint8_t channel) {
+    // Set LO code for RX channel
+    LC_set_word(
+        radio_vars.rx_channel_words[channel - IEEE_802_15_4_MIN_CHANNEL]);
 }
 
-void build_TX_channel_table(unsigned int channel_11_LC_code,
-                            unsigned int count_LC_RX_ch11) {
-    int i = 0;
-    unsigned int count_LC[16] = {0};
-    unsigned int count_targets[17] = {0};
+void setFrequencyTX(uint8_t channel) {
+    // Set LO code for TX channel
+    LC_set_word(
+        radio_vars.tx_channel_words[channel - IEEE_802_15_4_MIN_CHANNEL]);
+}
 
-    unsigned short nums[16] = {802, 904, 929, 269, 949, 434, 369, 578,
-                               455, 970, 139, 297, 587, 109, 373, 159};
-    unsigned short dens[16] = {801, 901, 924, 267, 940, 429, 364, 569,
-                               447, 951, 136, 290, 572, 106, 362, 154};
+// Build the RX and TX channel tables, sleeping until they are complete. The
+// radio must be in RX mode.
+void radio_build_channel_table(uint32_t channel_11_LC_code) {
+    if (radio_build_channel_table_async(channel_11_LC_code, NULL)) {
+        radio_wait_while(&radio_vars.table_building);
+    }
+}
+
+// Build the RX and TX channel tables in the background, starting from the LC
+// code of channel 11. Each step tunes the LO, counts its output for
+// TABLE_COUNT_TICKS and adjusts one LC code from the RF timer interrupt, so the
+// core is free to run or sleep in between. The radio must be in RX mode. cb,
+// if not NULL, is called from interrupt context once both tables are built and
+// the radio is off again. Returns false if a build is already in progress.
+bool radio_build_channel_table_async(uint32_t channel_11_LC_code,
+                                     radio_table_done_cbt cb) {
+    if (radio_vars.table_building) {
+        return false;
+    }
 
-    // Need to adjust here for shift from PA
+    radio_vars.table_building = true;
+    radio_vars.table_tx = false;
+    radio_vars.table_channel = 0;
+    radio_vars.table_done_cb = cb;
+    radio_vars.rx_channel_codes[0] = channel_11_LC_code;
     radio_vars.tx_channel_codes[0] = channel_11_LC_code;
 
-    // for(i=0; i<16; i++){
-    while (i < 16) {
-        LC_monotonic(radio_vars.tx_channel_codes[i]);
-        // analog_scan_chain_write_3B_fromFPGA(ASC);
-        // analog_scan_chain_load_3B_fromFPGA();
+    rftimer_set_callback_by_id(cb_timer_table, RADIO_RFTIMER_TABLE_ID);
+    radio_table_count_start();
+    return true;
+}
+
+bool radio_channel_table_building(void) { return radio_vars.table_building; }
+
+// Tune the LO to the code under test and open the counter gate
+static void radio_table_count_start(void) {
+    uint32_t* codes = radio_vars.table_tx ? radio_vars.tx_channel_codes
+                                          : radio_vars.rx_channel_codes;
 
-        // Reset all counters
-        SCUM_ANALOG_CFG_REG_0 = 0x0000;
+    LC_monotonic(codes[radio_vars.table_channel]);
 
-        // Enable all counters
-        SCUM_ANALOG_CFG_REG_0 = 0x3FFF;
+    // Reset all counters
+    SCUM_ANALOG_CFG_REG_0 = 0x0000;
 
-        // Count for some arbitrary amount of time
-        busy_wait_cycles(16000);
+    // Enable all counters
+    SCUM_ANALOG_CFG_REG_0 = 0x3FFF;
 
-        // Disable all counters
-        SCUM_ANALOG_CFG_REG_0 = 0x007F;
+    rftimer_setCompareIn_by_id(rftimer_readCounter() + TABLE_COUNT_TICKS,
+                               RADIO_RFTIMER_TABLE_ID);
+}
+
+// Close the counter gate, then either nudge the current LC code up or accept
+// it and move on to the next channel
+static void cb_timer_table(void) {
+    uint8_t i = radio_vars.table_channel;
+    uint32_t* codes;
+    uint32_t count_LC;
+    uint32_t count_target;
 
-        // Read count result
-        count_LC[i] = SCUM_ANALOG_CFG_REG_10 + (SCUM_ANALOG_CFG_REG_11 << 16);
+    // Disable all counters
+    SCUM_ANALOG_CFG_REG_0 = 0x007F;
 
-        // Until figure out why modulation spacing is only 800kHz, only set
-        // 400khz above RF channel
-        count_targets[i] = (nums[i] * count_LC_RX_ch11) / dens[i];
-        // count_targets[i] = ((24054 + i*50) * count_LC_RX_ch11) / 24025;
-        // count_targets[i] = ((24055 + i*50) * count_LC_RX_ch11) / 24025;
+    // Read count result
+    count_LC = SCUM_ANALOG_CFG_REG_10 + (SCUM_ANALOG_CFG_REG_11 << 16);
 
-        if (count_LC[i] < (count_targets[i] - 5)) {
-            radio_vars.tx_channel_codes[i]++;
+    if (!radio_vars.table_tx) {
+        codes = radio_vars.rx_channel_codes;
+        if (i == 0) {
+            // Channel 11 is the reference for every other target
+            radio_vars.table_count_rx_ch11 = count_LC;
+            count_target = 0;
         } else {
-            radio_vars.tx_channel_codes[i + 1] =
-                radio_vars.tx_channel_codes[i] + 40;
-            i++;
+            count_target =
+                ((961 + i * 2) * radio_vars.table_count_rx_ch11) / 961 -
+                TABLE_RX_COUNT_MARGIN;
         }
+    } else {
+        codes = radio_vars.tx_channel_codes;
+        count_target = (table_tx_nums[i] * radio_vars.table_count_rx_ch11) /
+                           table_tx_dens[i] -
+                       TABLE_TX_COUNT_MARGIN;
     }
 
-    // for(i=0; i<16; i++){
-    //     printf("\r\nTX ch=%d,  count_LC=%d,  count_targets=%d,
-    //     radio_vars.tx_channel_codes=%d",i+11,count_LC[i],count_targets[i],radio_vars.tx_channel_codes[i]);
-    // }
-}
+    // Adjust LC_code to match new target
+    if (count_LC < count_target) {
+        codes[i]++;
+    } else {
+        i++;
+        if (i < IEEE_802_15_4_NUM_CHANNELS) {
+            codes[i] = codes[i - 1] + LC_CODE_CHANNEL_STEP;
+        }
+    }
+    radio_vars.table_channel = i;
 
-void radio_build_channel_table(uint32_t channel_11_LC_code) {
-    unsigned int count_LC_RX_ch11;
+    if (i < IEEE_802_15_4_NUM_CHANNELS) {
+        radio_table_count_start();
+        return;
+    }
 
-    // Make sure in RX mode first
+    if (!radio_vars.table_tx) {
+        radio_table_switch_to_tx();
+        radio_table_count_start();
+        return;
+    }
 
-    count_LC_RX_ch11 = build_RX_channel_table(channel_11_LC_code);
+    // Both tables are built
+    rftimer_disable_interrupts_by_id(RADIO_RFTIMER_TABLE_ID);
+    for (i = 0; i < IEEE_802_15_4_NUM_CHANNELS; i++) {
+        radio_update_channel_words(i);
+    }
+    radio_rfOff();
 
-    // printf("--\r\n");
+    radio_vars.table_building = false;
+    if (radio_vars.table_done_cb != NULL) {
+        radio_vars.table_done_cb();
+    }
+}
 
-    // Switch over to TX mode
+// Switch over to TX mode
+static void radio_table_switch_to_tx(void) {
+    radio_vars.table_tx = true;
+    radio_vars.table_channel = 0;
 
     // Turn polyphase off for TX
     clear_asc_bit(971);
@@ -839,10 +2117,6 @@ void radio_build_channel_table(uint32_t channel_11_LC_code) {
     clear_asc_bit(504);  // = gpio_pon_en_if
     set_asc_bit(506);    // = gpio_pon_en_lo
     set_asc_bit(508);    // = gpio_pon_en_pa
-
-    build_TX_channel_table(channel_11_LC_code, count_LC_RX_ch11);
-
-    radio_rfOff();
 }
 
 //=========================== intertupt =======================================
@@ -851,153 +2125,144 @@ void RF_Handler(void) {
     unsigned int interrupt = SCUM_RF->INT;
     unsigned int error = SCUM_RF->ERROR;
 
-    printf("%08x\r\n",interrupt);
-
     gpio_2_set();
     gpio_6_set();
 
-    radio_vars.crc_ok = true;
+    radio_vars.crc_ok = (error & RX_CRC_ERROR) == 0;
     if (error != 0) {
-#ifdef ENABLE_PRINTF
-        printf("Radio ERROR\r\n");
-#endif
-
-        if (error & 0x00000001) {
-#ifdef ENABLE_PRINTF
-            printf("TX OVERFLOW ERROR\r\n");
-#endif
+        if (error & TX_OVERFLOW_ERROR) {
+            radio_vars.stats.tx_overflow++;
         }
-        if (error & 0x00000002) {
-#ifdef ENABLE_PRINTF
-            printf("TX CUTOFF ERROR\r\n");
-#endif
+        if (error & TX_CUTOFF_ERROR) {
+            radio_vars.stats.tx_cutoff++;
         }
-        if (error & 0x00000004) {
-#ifdef ENABLE_PRINTF
-            printf("RX OVERFLOW ERROR\r\n");
-#endif
+        if (error & RX_OVERFLOW_ERROR) {
+            radio_vars.stats.rx_overflow++;
         }
-
-        if (error & 0x00000008) {
-#ifdef ENABLE_PRINTF
-            printf("RX CRC ERROR\r\n");
-#endif
-            radio_vars.crc_ok = false;
+        if (error & RX_CRC_ERROR) {
+            radio_vars.stats.rx_crc++;
         }
-        if (error & 0x00000010) {
-#ifdef ENABLE_PRINTF
-            printf("RX CUTOFF ERROR\r\n");
-#endif
+        if (error & RX_CUTOFF_ERROR) {
+            radio_vars.stats.rx_cutoff++;
         }
+        SCUM_RF->ERROR_CLEAR = error;
     }
-    SCUM_RF->ERROR_CLEAR = error;
 
-    if (interrupt & 0x00000001) {
-#ifdef ENABLE_PRINTF
-        printf("TX LOAD DONE\r\n");
-#endif
+    if (interrupt & TX_LOAD_DONE_INT) {
+        // Send a chained frame as soon as it is in the FIFO
+        if (radio_vars.tx_chained) {
+            radio_vars.tx_chained = false;
+            radio_txNow();
+        }
 
-        SCUM_RF->INT_CLEAR |= 0x00000001;
+        SCUM_RF->INT_CLEAR |= TX_LOAD_DONE_INT;
     }
 
-    if (interrupt & 0x00000002) {
-#ifdef ENABLE_PRINTF
-        printf("TX SFD DONE\r\n");
-#endif
+    if (interrupt & TX_SFD_DONE_INT) {
+        uint32_t sfd = SCUM_RFTIMER->CAPTURE[RADIO_CAPTURE_TX_SFD];
+
+        if (!radio_vars.ack_in_flight) {
+            if (radio_vars.tx_last_end_valid &&
+                sfd - radio_vars.tx_last_end <= TX_GAP_MAX_TICKS) {
+                radio_vars.stats.tx_gap_ticks += sfd - radio_vars.tx_last_end;
+                radio_vars.stats.tx_gaps++;
+            }
+            if (radio_vars.burst && radio_vars.burst_sent == 0) {
+                radio_vars.burst_start = sfd;
+            }
+        }
 
-        if (radio_vars.startFrame_tx_cb != 0) {
-            radio_vars.startFrame_tx_cb(SCUM_RFTIMER->COUNTER);
+        if (!radio_vars.ack_in_flight && radio_vars.startFrame_tx_cb != 0) {
+            radio_vars.startFrame_tx_cb(sfd);
         }
 
-        SCUM_RF->INT_CLEAR |= 0x00000002;
+        SCUM_RF->INT_CLEAR |= TX_SFD_DONE_INT;
     }
 
-    if (interrupt & 0x00000004) {
-#ifdef ENABLE_PRINTF
-        printf("TX SEND DONE\r\n");
-#endif
+    if (interrupt & TX_SEND_DONE_INT) {
+        uint32_t end = SCUM_RFTIMER->CAPTURE[RADIO_CAPTURE_TX_SEND_DONE];
+
+        radio_vars.stats.tx_frames++;
 
-        if (radio_vars.endFrame_tx_cb != 0) {
-            radio_vars.endFrame_tx_cb(SCUM_RFTIMER->COUNTER);
+        if (radio_vars.ack_in_flight) {
+            radio_ack_done();
+        } else {
+            radio_vars.tx_last_end = end;
+            radio_vars.tx_last_end_valid = true;
+            if (radio_vars.burst) {
+                radio_vars.burst_sent++;
+            }
+
+            if (radio_tx_desc_done()) {
+                // The next frame is loading, queue the one after it
+                if (radio_vars.burst) {
+                    radio_burst_refill();
+                }
+            } else {
+                if (radio_vars.burst) {
+                    radio_vars.burst = false;
+                    radio_vars.stats.burst_frames = radio_vars.burst_sent;
+                    radio_vars.stats.burst_ticks = end - radio_vars.burst_start;
+                }
+                if (radio_vars.endFrame_tx_cb != 0) {
+                    radio_vars.endFrame_tx_cb(end);
+                }
+            }
         }
 
-        SCUM_RF->INT_CLEAR |= 0x00000004;
+        SCUM_RF->INT_CLEAR |= TX_SEND_DONE_INT;
     }
 
-    if (interrupt & 0x00000008) {
-#ifdef ENABLE_PRINTF
-        printf("RX SFD DONE\r\n");
-#endif
+    if (interrupt & RX_SFD_DONE_INT) {
+        radio_vars.stats.rx_sfd++;
+        radio_vars.threshold_sfd++;
+        radio_threshold_update();
 
         if (radio_vars.startFrame_rx_cb != 0) {
-            radio_vars.startFrame_rx_cb(SCUM_RFTIMER->COUNTER);
+            radio_vars.startFrame_rx_cb(
+                SCUM_RFTIMER->CAPTURE[RADIO_CAPTURE_RX_SFD]);
         }
 
-        SCUM_RF->INT_CLEAR |= 0x00000008;
+        SCUM_RF->INT_CLEAR |= RX_SFD_DONE_INT;
     }
 
-    if (interrupt & 0x00000010) {
-#ifdef ENABLE_PRINTF
-        printf("RX DONE\r\n");
-#endif
+    if (interrupt & RX_DONE_INT) {
+        if (radio_vars.crc_ok) {
+            radio_vars.stats.rx_frames++;
+            radio_vars.threshold_valid++;
+            radio_vars.demod_ok++;
+        } else {
+            radio_vars.demod_crc++;
+        }
 
         if (radio_vars.endFrame_rx_cb != 0) {
-            radio_vars.endFrame_rx_cb(SCUM_RFTIMER->COUNTER);
+            radio_vars.endFrame_rx_cb(
+                SCUM_RFTIMER->CAPTURE[RADIO_CAPTURE_RX_DONE]);
         }
 
-        SCUM_RF->INT_CLEAR |= 0x00000010;
+        SCUM_RF->INT_CLEAR |= RX_DONE_INT;
     }
 
-    //    SCUM_RF->INT_CLEAR = interrupt;
-
     gpio_2_clr();
     gpio_6_clr();
 }
 
 // This ISR goes off when the raw chip shift register interrupt goes high
-// It reads the current 32 bits and then prints them out after N cycles
+// It pushes the current 32 bits into the raw chip ring
 void RAWCHIPS_32_Handler(void) {
-
-    // Read 32bit val
-    unsigned int rdata_lsb = SCUM_ANALOG_CFG_REG_17;
-    unsigned int rdata_msb = SCUM_ANALOG_CFG_REG_18;
-    chips[chip_index] = rdata_lsb + (rdata_msb << 16);
-
-    chip_index++;
-
-    // printf("x1\r\n");
+    radio_rawchips_push();
 
     // Clear the interrupt
-    // SCUM_ANALOG_CFG_REG_0 = 1;
-    // SCUM_ANALOG_CFG_REG_0 = 0;
     acfg3_val |= 0x20;
     SCUM_ANALOG_CFG_REG_3 = acfg3_val;
     acfg3_val &= ~(0x20);
     SCUM_ANALOG_CFG_REG_3 = acfg3_val;
-
-    if (chip_index == 10) {
-        for (uint8_t jj = 1; jj < 10; jj++) {
-            printf("%X\r\n", chips[jj]);
-        }
-
-        NVIC_DisableIRQ(RAWCHIPS_STARTVAL_IRQn);
-        NVIC_EnableIRQ(RAWCHIPS_32_IRQn);
-        chip_index = 0;
-
-        // Wait for print to complete
-        busy_wait_cycles(10000);
-
-        // Execute soft reset
-        *(volatile unsigned int*)(0xE000ED0C) = 0x05FA0004;
-    }
 }
 
 // With HCLK = 5MHz, data rate of 1.25MHz tested OK
 // For faster data rate, will need to raise the HCLK frequency
 // This ISR goes off when the input register matches the target value
 void RAWCHIPS_STARTVAL_Handler(void) {
-    unsigned int rdata_lsb, rdata_msb;
-
     // Clear all interrupts
     acfg3_val |= 0x60;
     SCUM_ANALOG_CFG_REG_3 = acfg3_val;
@@ -1009,11 +2274,261 @@ void RAWCHIPS_STARTVAL_Handler(void) {
     NVIC_DisableIRQ(RAWCHIPS_STARTVAL_IRQn);
     NVIC_ClearPendingIRQ(RAWCHIPS_32_IRQn);
 
-    // Read 32bit val
-    rdata_lsb = SCUM_ANALOG_CFG_REG_17;
-    rdata_msb = SCUM_ANALOG_CFG_REG_18;
-    chips[chip_index] = rdata_lsb + (rdata_msb << 16);
-    chip_index++;
+    radio_rawchips_push();
+}
+
+// Adjust the packet detection threshold once enough evidence has built up
+static void radio_threshold_update(void) {
+    uint8_t threshold = radio_vars.stats.correlation_threshold;
+    uint16_t false_sfd;
+
+    if (!radio_vars.threshold_adaptive) {
+        return;
+    }
+
+    if (radio_vars.threshold_missed >= THRESHOLD_MISSED_TRIGGER) {
+        threshold++;
+    } else if (radio_vars.threshold_sfd >= THRESHOLD_WINDOW_SFDS) {
+        false_sfd = radio_vars.threshold_valid < radio_vars.threshold_sfd
+                        ? radio_vars.threshold_sfd - radio_vars.threshold_valid
+                        : 0;
+        if (false_sfd * 100 >
+            THRESHOLD_FALSE_HIGH_PCT * radio_vars.threshold_sfd) {
+            threshold--;
+        } else if (false_sfd * 100 <
+                   THRESHOLD_FALSE_LOW_PCT * radio_vars.threshold_sfd) {
+            threshold++;
+        }
+    } else {
+        return;
+    }
+
+    radio_vars.threshold_sfd = 0;
+    radio_vars.threshold_valid = 0;
+    radio_vars.threshold_missed = 0;
+
+    if (threshold < radio_vars.threshold_min) {
+        threshold = radio_vars.threshold_min;
+    } else if (threshold > radio_vars.threshold_max) {
+        threshold = radio_vars.threshold_max;
+    }
+    if (threshold != radio_vars.stats.correlation_threshold) {
+        radio_vars.stats.threshold_changes++;
+        radio_set_correlation_threshold(threshold);
+    }
+}
+
+// Whether a write to the analog scan chain must wait: the chain load disturbs
+// the baseband, so it is not shifted while the radio is sending, receiving a
+// frame, in a scheduled receive window or sending an ACK
+static bool radio_asc_deferred(void) {
+    return radio_vars.busy &&
+           (radio_vars.radio_mode != RX_MODE || radio_vars.rxFrameStarted ||
+            radio_vars.rx_window || radio_vars.ack_in_flight);
+}
+
+// Restart a listening receiver after a scan chain write, dropping the
+// interrupts the load may have raised
+static void radio_asc_rearm(void) {
+    if (radio_vars.busy) {
+        radio_rx_rearm();
+        SCUM_RF->INT_CLEAR |= RX_SFD_DONE_INT | RX_DONE_INT;
+        NVIC_ClearPendingIRQ(RF_IRQn);
+    }
+}
+
+// Reprogram the receiver for demod, or leave the switch pending while a frame
+// is in flight. The scan chain is shifted with the radio interrupt masked so
+// that no frame starts meanwhile; a receiver left on is re-armed afterwards,
+// as the chain load disturbs the baseband.
+static bool radio_demod_apply(radio_demod_t demod) {
+    radio_disable_interrupts();
+    if (radio_asc_deferred()) {
+        radio_vars.demod_target = demod;
+        radio_vars.demod_pending = true;
+        radio_enable_interrupts();
+        return false;
+    }
+    radio_vars.demod_pending = false;
+
+    if (demod != radio_vars.stats.demodulator) {
+        if (demod == RADIO_DEMOD_ZCC) {
+            radio_switch_rx_ZCC();
+        } else {
+            radio_switch_rx_MF();
+        }
+        radio_set_correlation_threshold(
+            radio_vars.stats.correlation_threshold);
+        radio_vars.stats.demodulator = demod;
+        radio_vars.stats.demod_switches++;
+
+        // The RX init functions restore the highest IF level
+        if (radio_vars.stats.if_level != RADIO_IF_LEVEL_MAX) {
+            radio_if_level_write(radio_vars.stats.if_level);
+        }
+
+        radio_asc_rearm();
+    }
+
+    // Start a fresh window on the new demodulator
+    radio_vars.demod_ok = 0;
+    radio_vars.demod_crc = 0;
+    radio_vars.demod_missed = 0;
+    radio_vars.demod_probe_start = rftimer_readCounter();
+    radio_enable_interrupts();
+    return true;
+}
+
+// Score the current demodulator once its window is complete and decide
+// whether to probe or go back to the other one. Thread context only.
+static void radio_demod_update(void) {
+    radio_demod_t current = (radio_demod_t)radio_vars.stats.demodulator;
+    radio_demod_t other =
+        current == RADIO_DEMOD_MF ? RADIO_DEMOD_ZCC : RADIO_DEMOD_MF;
+    uint16_t ok;
+    uint16_t crc;
+    uint16_t missed;
+    uint32_t attempts;
+    bool expired;
+
+    if (radio_vars.demod_pending) {
+        radio_demod_apply(radio_vars.demod_target);
+        return;
+    }
+    if (!radio_vars.demod_auto) {
+        return;
+    }
+
+    radio_disable_interrupts();
+    ok = radio_vars.demod_ok;
+    crc = radio_vars.demod_crc;
+    missed = radio_vars.demod_missed;
+    attempts = (uint32_t)ok + crc + missed;
+    expired = radio_vars.demod_probing &&
+              rftimer_readCounter() - radio_vars.demod_probe_start >
+                  DEMOD_PROBE_TIMEOUT_TICKS;
+    if (attempts < radio_vars.demod_window && !expired) {
+        radio_enable_interrupts();
+        return;
+    }
+    radio_vars.demod_ok = 0;
+    radio_vars.demod_crc = 0;
+    radio_vars.demod_missed = 0;
+    radio_enable_interrupts();
+
+    // A demodulator that heard nothing during its probe scores worst
+    radio_vars.stats.demod_per[current] =
+        attempts ? (uint16_t)(((uint32_t)crc + missed) * 1000 / attempts)
+                 : 1000;
+    radio_vars.stats.demod_crc_fail[current] =
+        ok + crc ? (uint16_t)((uint32_t)crc * 1000 / (ok + crc)) : 0;
+
+    if (radio_vars.demod_probing) {
+        radio_vars.demod_probing = false;
+        radio_vars.demod_hold = DEMOD_HOLD_WINDOWS;
+        if (radio_vars.stats.demod_per[other] <
+                radio_vars.stats.demod_per[current] ||
+            (radio_vars.stats.demod_per[other] ==
+                 radio_vars.stats.demod_per[current] &&
+             radio_vars.stats.demod_crc_fail[other] <
+                 radio_vars.stats.demod_crc_fail[current])) {
+            radio_demod_apply(other);
+        }
+        return;
+    }
+
+    if (radio_vars.demod_hold > 0) {
+        radio_vars.demod_hold--;
+        return;
+    }
+
+    radio_vars.demod_probing = true;
+    radio_demod_apply(other);
+}
+
+// Program the IF gain and LDO settings of level into the analog scan chain
+static void radio_if_level_write(uint8_t level) {
+    const radio_if_level_t* settings = &if_levels[level];
+
+    set_IF_gain_ASC(settings->gain, settings->gain);
+    set_IF_stg3gm_ASC(settings->stg3gm, settings->stg3gm);
+    set_IF_LDO_voltage(settings->ldo);
+    analog_scan_chain_write();
+    analog_scan_chain_load();
+}
+
+// Move the wanted IF level according to the chip errors of a received frame
+static void radio_if_power_track(const radio_rx_slot_t* slot) {
+    uint8_t target = radio_vars.if_chip_errors_target;
+    uint8_t chip_errors = slot->LQI_chip_errors & 0xFF;
+    uint8_t step;
+
+    if (slot->crc_ok && slot->length < IF_POWER_MIN_LENGTH) {
+        return;
+    }
+
+    if (!slot->crc_ok || chip_errors > target) {
+        step = (!slot->crc_ok || chip_errors > 2 * target) ? 2 : 1;
+        radio_vars.if_level =
+            radio_vars.if_level + step < RADIO_IF_LEVEL_MAX
+                ? radio_vars.if_level + step
+                : RADIO_IF_LEVEL_MAX;
+        radio_vars.if_good_frames = 0;
+    } else if (chip_errors <= target / 2 &&
+               slot->rssi >= IF_POWER_DOWN_MIN_RSSI) {
+        if (++radio_vars.if_good_frames >= IF_POWER_DOWN_FRAMES) {
+            radio_vars.if_good_frames = 0;
+            if (radio_vars.if_level > 0) {
+                radio_vars.if_level--;
+            }
+        }
+    } else {
+        radio_vars.if_good_frames = 0;
+    }
+}
+
+// Raise the IF level for frames reported missed and program the wanted level
+// if it changed, unless radio_asc_deferred(). Thread context only.
+static void radio_if_power_update(void) {
+    uint16_t missed;
+
+    radio_disable_interrupts();
+    missed = radio_vars.if_missed;
+    radio_vars.if_missed = 0;
+    if (missed > 0 && radio_vars.if_power_control) {
+        radio_vars.if_level = radio_vars.if_level < RADIO_IF_LEVEL_MAX
+                                  ? radio_vars.if_level + 1
+                                  : RADIO_IF_LEVEL_MAX;
+        radio_vars.if_good_frames = 0;
+    }
+
+    if (radio_vars.if_level != radio_vars.stats.if_level &&
+        !radio_asc_deferred()) {
+        radio_if_level_write(radio_vars.if_level);
+        radio_asc_rearm();
+        radio_vars.stats.if_level = radio_vars.if_level;
+        radio_vars.stats.if_level_changes++;
+    }
+    radio_enable_interrupts();
+}
+
+// Push the 32 chips in the shift register into the raw chip ring
+static void radio_rawchips_push(void) {
+    uint32_t word = SCUM_ANALOG_CFG_REG_17 | (SCUM_ANALOG_CFG_REG_18 << 16);
+    uint16_t head = radio_vars.rawchips_head;
+    uint16_t next = (head + 1) & (RADIO_RAWCHIPS_RING_SIZE - 1);
+
+    // Once the ring has overflowed, keep dropping until the reader reaches
+    // the gap, so that the single recorded gap covers every word lost
+    if (radio_vars.rawchips_gap || next == radio_vars.rawchips_tail) {
+        if (!radio_vars.rawchips_gap) {
+            radio_vars.rawchips_gap = true;
+            radio_vars.rawchips_gap_at = head;
+        }
+        radio_vars.rawchips_dropped++;
+        return;
+    }
 
-    // printf("x2\r\n");
+    radio_vars.rawchips_ring[head] = word;
+    radio_vars.rawchips_head = next;
 }
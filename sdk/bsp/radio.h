@@ -4,9 +4,35 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "ieee_802_15_4.h"
+
 //=========================== define ==========================================
 
 #define LENGTH_CRC 2
+#define MAXLENGTH_TRX_BUFFER 128  // 1B length, 125B data, 2B CRC
+
+// Number of slots in the RX descriptor ring. One slot is always owned by the
+// radio DMA, so up to RADIO_RX_RING_SIZE - 1 frames can wait to be drained.
+#ifndef RADIO_RX_RING_SIZE
+#define RADIO_RX_RING_SIZE 4
+#endif
+
+// Number of 32-chip words in the raw chip capture ring, a power of 2. Raw
+// chip capture is left out, and takes no RAM, unless the application sets it,
+// e.g. to 1024 (4 KB).
+#ifndef RADIO_RAWCHIPS_RING_SIZE
+#define RADIO_RAWCHIPS_RING_SIZE 0
+#endif
+
+// Number of TX descriptors: one frame on the air and one waiting behind it.
+#define RADIO_NUM_TX_DESC 2
+
+#define RADIO_NUM_DEMODS 2
+
+// Number of IF gain and LDO levels, from 0 (lowest power) to
+// RADIO_IF_LEVEL_MAX, the radio_init_rx_MF() settings.
+#define RADIO_NUM_IF_LEVELS 6
+#define RADIO_IF_LEVEL_MAX (RADIO_NUM_IF_LEVELS - 1)
 
 //=========================== typedef =======================
 typedef enum {
@@ -24,14 +50,104 @@ typedef enum {
     FIXED = 0x02,
 } repeat_mode_t;
 
+// Completion status of an asynchronous radio operation.
+typedef enum {
+    RADIO_STATUS_SENT = 0x01,
+    RADIO_STATUS_RECEIVED = 0x02,
+    RADIO_STATUS_TIMEOUT = 0x03,
+    RADIO_STATUS_CRC_FAIL = 0x04,
+    RADIO_STATUS_CCA_CLEAR = 0x05,
+    RADIO_STATUS_CCA_BUSY = 0x06,
+    RADIO_STATUS_RX_DROPPED = 0x07,  // received, but the RX ring was full
+} radio_status_t;
+
+// Receiver demodulator.
+typedef enum {
+    RADIO_DEMOD_MF = 0x00,   // matched filter
+    RADIO_DEMOD_ZCC = 0x01,  // zero-crossing
+} radio_demod_t;
+
+// Outcome of an RX hook for a received frame.
+typedef enum {
+    RADIO_RX_HOOK_QUEUE = 0x00,    // queue the frame in the RX ring
+    RADIO_RX_HOOK_DROP = 0x01,     // discard it and keep listening
+    RADIO_RX_HOOK_CONSUME = 0x02,  // discard it, it was handled by the hook
+} radio_rx_verdict_t;
+
+// Frame of a TX burst. packet must be 4-byte aligned.
+typedef struct {
+    const void* packet;
+    uint8_t pkt_len;  // including CRC
+} radio_burst_frame_t;
+
 typedef struct {
     uint8_t cfg_coarse;
     uint8_t cfg_mid;
     uint8_t cfg_fine;
 } repeat_rx_tx_state_t;
 
+// RX descriptor ring slot. The radio DMA writes the frame straight into
+// buffer, whose first byte is the PHY length; the payload follows it.
+typedef struct {
+    uint8_t buffer[MAXLENGTH_TRX_BUFFER] __attribute__((aligned(4)));
+    uint32_t timestamp;  // RF timer count at the SFD
+    uint32_t IF_estimate;
+    uint32_t LQI_chip_errors;
+    int16_t cdr_tau_value;
+    uint8_t length;  // PHY length, including CRC
+    int8_t rssi;
+    uint8_t lqi;
+    uint8_t channel;
+    bool crc_ok;
+} radio_rx_slot_t;
+
+// Radio event counters, updated from interrupt context.
+typedef struct {
+    uint32_t tx_frames;  // frames sent, chained frames included
+    uint32_t rx_frames;  // frames received with a valid CRC
+    uint32_t tx_overflow;
+    uint32_t tx_cutoff;
+    uint32_t rx_overflow;
+    uint32_t rx_crc;
+    uint32_t rx_cutoff;
+    uint32_t rx_timeouts;  // receive timeouts and empty receive windows
+    uint32_t rx_drops;     // frames lost because the RX ring was full
+    uint32_t rx_filtered;  // frames not addressed to us
+    uint32_t rx_aborted;   // of which aborted after the address fields
+    uint32_t rx_sfd;       // SFDs detected, false detections included
+    uint32_t rx_missed;    // frames reported missed by the upper layers
+    uint32_t threshold_changes;
+    uint8_t correlation_threshold;  // current packet detection threshold
+    uint32_t demod_switches;
+    // Last measured packet error and CRC failure rates of each demodulator,
+    // in per mille, see radio_set_demod_auto()
+    uint16_t demod_per[RADIO_NUM_DEMODS];
+    uint16_t demod_crc_fail[RADIO_NUM_DEMODS];
+    uint8_t demodulator;  // current radio_demod_t
+    uint32_t if_level_changes;
+    uint8_t if_level;  // current IF gain and LDO level
+    // Time between the end of a frame and the SFD of the next one sent, its
+    // preamble included, summed over tx_gaps back-to-back frames
+    uint32_t tx_gap_ticks;
+    uint32_t tx_gaps;
+    uint32_t burst_frames;  // frames of the last TX burst
+    uint32_t burst_ticks;   // first SFD to last frame end of the last burst
+} radio_stats_t;
+
+// Calibrated LC codes of the 802.15.4 channels 11 to 26, indexed from
+// channel 11.
+typedef struct {
+    uint32_t rx_codes[IEEE_802_15_4_NUM_CHANNELS];
+    uint32_t tx_codes[IEEE_802_15_4_NUM_CHANNELS];
+} radio_channel_table_t;
+
 typedef void (*radio_capture_cbt)(uint32_t timestamp);
 typedef void (*radio_rx_cbt)(uint8_t* packet, uint8_t packet_len);
+typedef void (*radio_done_cbt)(radio_status_t status);
+typedef void (*radio_table_done_cbt)(void);
+typedef const void* (*radio_burst_next_cbt)(uint8_t* pkt_len);
+typedef radio_rx_verdict_t (*radio_rx_hook_cbt)(radio_rx_slot_t* slot,
+                                                uint32_t timestamp);
 typedef void (*fill_tx_packet_t)(uint8_t* packet, uint8_t packet_len,
                                  repeat_rx_tx_state_t repeat_rx_tx_state);
 
@@ -70,6 +186,64 @@ void cb_timer_radio(void);
 void radio_setRxCb(radio_rx_cbt radio_rx_cb);
 void repeat_rx_tx(repeat_rx_tx_params_t repeat_rx_tx_params);
 
+//==== async
+bool radio_tx_async(void* packet, uint8_t pkt_len, radio_done_cbt cb);
+bool radio_rx_async(uint32_t timeout, radio_done_cbt cb);
+bool radio_busy(void);
+void radio_wait_while(volatile bool* flag);
+bool radio_rx_listen(void);
+bool radio_cca_async(uint32_t duration, int8_t threshold, radio_done_cbt cb);
+void radio_rx_cancel(void);
+
+//==== burst
+bool radio_tx_burst_async(radio_burst_next_cbt next, radio_done_cbt cb);
+bool radio_tx_burst(const radio_burst_frame_t* frames, uint16_t num_frames);
+
+//==== hardware-timed
+bool radio_schedule_tx_at(uint32_t ticks, radio_done_cbt cb);
+bool radio_schedule_rx_window(uint32_t start, uint32_t stop,
+                              radio_done_cbt cb);
+
+//==== address filter
+void radio_set_address_filter(uint16_t pan_id, uint16_t short_addr,
+                              const uint8_t* ext_addr);
+void radio_clear_address_filter(void);
+
+//==== rx hook
+void radio_set_rx_hook(radio_rx_hook_cbt hook);
+bool radio_reply_at(const void* packet, uint8_t pkt_len, uint32_t ticks);
+
+//==== rx ring
+radio_rx_slot_t* radio_rx_peek(void);
+void radio_rx_release(void);
+uint8_t radio_rx_drain(void);
+uint32_t radio_rx_drop_count(void);
+
+//==== raw chips
+void radio_rawchips_start(void);
+void radio_rawchips_stop(void);
+uint16_t radio_rawchips_read(uint32_t* words, uint16_t max, bool* gap);
+uint32_t radio_rawchips_dropped(void);
+
+//==== packet detection threshold
+void radio_set_correlation_threshold(uint8_t threshold);
+void radio_set_adaptive_threshold(bool enable, uint8_t min, uint8_t max);
+void radio_report_missed_frames(uint16_t count);
+
+//==== demodulator
+bool radio_set_demodulator(radio_demod_t demod);
+radio_demod_t radio_get_demodulator(void);
+void radio_set_demod_auto(bool enable, uint16_t window);
+
+//==== IF power control
+void radio_set_if_power_control(bool enable, uint8_t chip_error_target);
+bool radio_set_if_level(uint8_t level);
+uint8_t radio_get_if_level(void);
+
+//==== statistics
+void radio_get_stats(radio_stats_t* stats);
+void radio_reset_stats(void);
+
 void radio_init(void);
 void radio_setStartFrameTxCb(radio_capture_cbt cb);
 void radio_setEndFrameTxCb(radio_capture_cbt cb);
@@ -87,16 +261,26 @@ bool radio_getCrcOk(void);
 uint32_t radio_getIFestimate(void);
 uint32_t radio_getLQIchipErrors(void);
 int16_t radio_get_cdr_tau_value(void);
+int8_t radio_get_rssi(void);
 
 //==== frequency
 void radio_frequency_housekeeping(uint32_t IF_estimate,
                                   uint32_t LQI_chip_errors,
                                   int16_t cdr_tau_value);
-void radio_setFrequency(uint8_t frequency, radio_freq_t tx_or_rx);
+void radio_set_frequency_tracking(bool enable);
+bool radio_setFrequency(uint8_t channel, radio_freq_t tx_or_rx);
+uint8_t radio_getFrequency(void);
 void radio_build_channel_table(uint32_t channel_11_LC_code);
+bool radio_build_channel_table_async(uint32_t channel_11_LC_code,
+                                     radio_table_done_cbt cb);
+bool radio_channel_table_building(void);
+void radio_load_channel_table(const radio_channel_table_t* table);
+void radio_export_channel_table(radio_channel_table_t* table);
 
 //==== tx
 void radio_loadPacket(void* packet, uint16_t len);
+bool radio_tx_queue(const void* packet, uint16_t len);
+uint8_t radio_tx_pending(void);
 void radio_txEnable(void);
 void radio_txNow(void);
 
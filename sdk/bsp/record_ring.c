@@ -0,0 +1,68 @@
+#include "record_ring.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//=========================== prototypes ======================================
+
+static void record_ring_put(record_ring_t* ring, uint8_t byte);
+
+//=========================== public ==========================================
+
+// Set up an empty ring over buffer, of size bytes, a power of 2
+void record_ring_init(record_ring_t* ring, uint8_t* buffer, uint16_t size) {
+    ring->buffer = buffer;
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+// Frame the record body with the sync bytes and the sum, and queue it.
+// Returns false, and queues nothing, if the ring has no room for it.
+bool record_ring_push(record_ring_t* ring, const uint8_t* body,
+                      uint16_t body_len) {
+    uint16_t free_space = (ring->tail - ring->head - 1) & (ring->size - 1);
+    uint8_t sum = 0;
+    uint16_t i;
+
+    if (free_space < body_len + 3) {
+        return false;
+    }
+
+    record_ring_put(ring, RECORD_RING_SYNC_0);
+    record_ring_put(ring, RECORD_RING_SYNC_1);
+    for (i = 0; i < body_len; i++) {
+        sum += body[i];
+        record_ring_put(ring, body[i]);
+    }
+    record_ring_put(ring, sum);
+    return true;
+}
+
+// Write up to max_bytes queued bytes to the UART
+void record_ring_send(record_ring_t* ring, uint16_t max_bytes) {
+    uint16_t count = (ring->head - ring->tail) & (ring->size - 1);
+    uint16_t contiguous = ring->size - ring->tail;
+
+    if (count > max_bytes) {
+        count = max_bytes;
+    }
+    if (count > contiguous) {
+        count = contiguous;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    fwrite(&ring->buffer[ring->tail], 1, count, stdout);
+    fflush(stdout);
+    ring->tail = (ring->tail + count) & (ring->size - 1);
+}
+
+//=========================== private =========================================
+
+static void record_ring_put(record_ring_t* ring, uint8_t byte) {
+    ring->buffer[ring->head] = byte;
+    ring->head = (ring->head + 1) & (ring->size - 1);
+}
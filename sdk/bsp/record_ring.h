@@ -0,0 +1,35 @@
+// Ring of framed records waiting for the UART, as kept by the samples that
+// stream binary records to a host script. Each record is sent as two sync
+// bytes, its body and an 8-bit sum of the body. The ring is written a few
+// bytes at a time from the main loop, so that the radio RX ring is drained
+// between two chunks. The ring is not locked: it is filled and emptied from
+// thread context only.
+
+#ifndef __RECORD_RING_H
+#define __RECORD_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//=========================== define ==========================================
+
+#define RECORD_RING_SYNC_0 0xA5
+#define RECORD_RING_SYNC_1 0x5A
+
+//=========================== typedef =========================================
+
+typedef struct {
+    uint8_t* buffer;
+    uint16_t size;  // a power of 2
+    uint16_t head;
+    uint16_t tail;
+} record_ring_t;
+
+//=========================== prototypes ======================================
+
+void record_ring_init(record_ring_t* ring, uint8_t* buffer, uint16_t size);
+bool record_ring_push(record_ring_t* ring, const uint8_t* body,
+                      uint16_t body_len);
+void record_ring_send(record_ring_t* ring, uint16_t max_bytes);
+
+#endif
@@ -82,6 +82,32 @@ void rftimer_setCompareIn_by_id(uint32_t val, uint8_t id) {
     SCUM_RFTIMER->COMPARE[id] = val & RFTIMER_MAX_COUNT;
 }
 
+// Arm compare register id so that the RF timer itself triggers the radio
+// actions in actions (RFTIMER_COMPARE_TX_LOAD_ENABLE,
+// RFTIMER_COMPARE_TX_SEND_ENABLE, RFTIMER_COMPARE_RX_START_ENABLE and/or
+// RFTIMER_COMPARE_RX_STOP_ENABLE) when the counter reaches val, without any
+// software latency. The compare interrupt is enabled as well if a callback is
+// set for id. Unlike rftimer_setCompareIn_by_id(), a value in the past is not
+// armed; false is returned instead so that the caller can decide what to do.
+bool rftimer_setCompareAction_by_id(uint32_t val, uint8_t id,
+                                    uint32_t actions) {
+    uint32_t control = RFTIMER_COMPARE_ENABLE | actions;
+
+    if ((val & RFTIMER_MAX_COUNT) - SCUM_RFTIMER->COUNTER >= LARGEST_INTERVAL) {
+        return false;
+    }
+
+    if (rftimer_vars.rftimer_cbs[id] != NULL) {
+        control |= RFTIMER_COMPARE_INTERRUPT_ENABLE;
+        rftimer_enable_interrupts();
+    }
+
+    rftimer_clear_interrupts_by_id(id);
+    SCUM_RFTIMER->COMPARE[id] = val & RFTIMER_MAX_COUNT;
+    SCUM_RFTIMER->COMPARE_CONTROL[id] = control;
+    return true;
+}
+
 uint32_t rftimer_readCounter(void) { return SCUM_RFTIMER->COUNTER; }
 
 // Enables the RF timer interrupt, which is required for individually enabled
@@ -171,7 +197,10 @@ void RFTIMER_Handler(void) {
     interrupt = SCUM_RFTIMER->INT;
 
     for (i = 0; i < 8; i++) {
-        if (interrupt & interrupt_id) {
+        // Compares armed for hardware actions only have no handler to run
+        if ((interrupt & interrupt_id) &&
+            (SCUM_RFTIMER->COMPARE_CONTROL[i] &
+             RFTIMER_COMPARE_INTERRUPT_ENABLE)) {
 #ifdef ENABLE_PRINTF
             printf("COMPARE%d MATCH\r\n", i);
 #endif
@@ -8,6 +8,18 @@
 
 #define RFTIMER_MAX_COUNT 0xffffffff
 
+// Compare channels used by the SDK drivers:
+//   0: radio RX timeout
+//   1: radio scheduled RX start (hardware action)
+//   2: radio TX start / scheduled TX send (hardware action)
+//   3: radio scheduled RX stop (hardware action)
+//   4: MAC layer timer (CSMA-CA backoffs, TSCH timeslots or LPL wake-ups)
+//   5: radio address filter early check
+//   6: radio channel table builder
+// Applications are free to use the remaining channels.
+// All four capture channels are used by the radio driver to timestamp
+// TX SFD, TX send done, RX SFD and RX done (in that order).
+
 //=========================== typedef =========================================
 
 typedef void (*rftimer_cbt)(void);
@@ -19,6 +31,7 @@ typedef void (*rftimer_cbt)(void);
 void rftimer_init(void);
 void rftimer_setCompareIn(uint32_t val);
 void rftimer_setCompareIn_by_id(uint32_t val, uint8_t id);
+bool rftimer_setCompareAction_by_id(uint32_t val, uint8_t id, uint32_t actions);
 void rftimer_set_callback(rftimer_cbt cb);
 void rftimer_set_callback_by_id(rftimer_cbt cb, uint8_t id);
 uint32_t rftimer_readCounter(void);
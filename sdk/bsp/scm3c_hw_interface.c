@@ -24,6 +24,14 @@
 #define INIT_IF_COARSE 22
 #define INIT_IF_FINE 18
 
+// The ZCC demodulator runs on the IF clock divided down to the 2 MHz chip
+// rate, and its counter threshold was tuned to 13 at a 76 MHz IF clock. When
+// the application sets a ZCC IF clock target, counted over 100 ms like the
+// 2 MHz clock (200000 counts), runtime switches to ZCC derive both from it.
+#define ZCC_CHIP_RATE_COUNTS 200000
+#define ZCC_THRESHOLD_REF 13
+#define ZCC_THRESHOLD_REF_COUNTS 7600000
+
 // CRC
 #define CRC_VALUE (*((volatile unsigned int*)0x0000FFFC))
 #define CODE_LENGTH (*((volatile unsigned int*)0x0000FFF8))
@@ -52,12 +60,18 @@ typedef struct {
     uint32_t IF_clk_target;
     uint32_t IF_coarse;
     uint32_t IF_fine;
+
+    // IF clock the ZCC demodulator runs on, 0 if not set
+    uint32_t ZCC_IF_clk_target;
 } scm3c_hw_interface_vars_t;
 
 scm3c_hw_interface_vars_t scm3c_hw_interface_vars;
 
 //=========================== prototype =======================================
 
+static bool radio_switch_rx_demod(bool zcc);
+static void radio_set_ZCC_IF_clk(uint32_t IF_clk_target);
+
 //=========================== public ==========================================
 
 //==== admin
@@ -113,6 +127,9 @@ uint32_t scm3c_hw_interface_get_IF_coarse(void) {
 uint32_t scm3c_hw_interface_get_IF_fine(void) {
     return scm3c_hw_interface_vars.IF_fine;
 }
+uint32_t scm3c_hw_interface_get_ZCC_IF_clk_target(void) {
+    return scm3c_hw_interface_vars.ZCC_IF_clk_target;
+}
 
 //===== set function
 
@@ -140,6 +157,9 @@ void scm3c_hw_interface_set_IF_coarse(uint32_t value) {
 void scm3c_hw_interface_set_IF_fine(uint32_t value) {
     scm3c_hw_interface_vars.IF_fine = value;
 }
+void scm3c_hw_interface_set_ZCC_IF_clk_target(uint32_t value) {
+    scm3c_hw_interface_vars.ZCC_IF_clk_target = value;
+}
 
 void scm3c_hw_interface_set_asc(uint32_t* asc_profile) {
     memcpy(&scm3c_hw_interface_vars.ASC[0], asc_profile,
@@ -794,7 +814,7 @@ void radio_init_rx_MF() {
     // Threshold used for packet detection
     // This number corresponds to the Hamming distance threshold for determining
     // if incoming 15.4 chip stream is a packet
-    correlation_threshold = 5;
+    correlation_threshold = CORRELATION_THRESHOLD_DEFAULT;
     SCUM_ANALOG_CFG_REG_9 = correlation_threshold;
 
     // Mux select bits to choose internal demod or external clk/data from gpio
@@ -890,7 +910,7 @@ void radio_init_rx_ZCC() {
     set_asc_bit(132);
 
     // Threshold used for packet detection
-    correlation_threshold = 5;
+    correlation_threshold = CORRELATION_THRESHOLD_DEFAULT;
     SCUM_ANALOG_CFG_REG_9 = correlation_threshold;
 
     // Trim comparator offset
@@ -908,6 +928,19 @@ void radio_init_rx_ZCC() {
     SCUM_ANALOG_CFG_REG_4 = 0x2800;
 }
 
+// Switch a running receiver over to the matched filter demodulator. Unlike
+// radio_init_rx_MF(), the calibrated IF clock is kept, the zero-crossing
+// demodulator is turned off and the scan chain is reprogrammed, only if the
+// ASC changed. Memory-mapped RX settings, such as the packet detection
+// threshold, are reset to their defaults. Returns whether the scan chain was
+// reprogrammed.
+bool radio_switch_rx_MF(void) { return radio_switch_rx_demod(false); }
+
+// Same as radio_switch_rx_MF(), for the zero-crossing demodulator. Its clock
+// divider and counter threshold are derived from the ZCC IF clock target, if
+// one was set, else left at the radio_init_rx_ZCC() defaults.
+bool radio_switch_rx_ZCC(void) { return radio_switch_rx_demod(true); }
+
 void radio_init_tx() {
     // Set up 15.4 modulation source
     // ----
@@ -1022,9 +1055,10 @@ unsigned int read_IF_estimate() {
 // Read Link Quality Indicator
 unsigned int read_LQI() { return SCUM_ANALOG_CFG_REG_21 & 0xFF; }
 
-// Read RSSI - the gain control settings
+// Read RSSI - the gain control settings, 6 bits (63 is the max gain, i.e.
+// the weakest signal)
 
-unsigned int read_RSSI() { return SCUM_ANALOG_CFG_REG_15 & 0xF; }
+unsigned int read_RSSI() { return SCUM_ANALOG_CFG_REG_15 & 0x3F; }
 
 // set IF clock frequency
 void set_IF_clock_frequency(int coarse, int fine, int high_range) {
@@ -1423,13 +1457,20 @@ void clear_asc_bit(unsigned int position) {
 //==== from bucket_o_functions.h
 
 void LC_FREQCHANGE(int coarse, int mid, int fine) {
+    LC_set_word(LC_word(coarse, mid, fine));
+}
+
+// Encode an LC setting into the word written by LC_set_word(). The low half
+// holds ACFG_LO_ADDR and bit 16 holds the LSB of the fine DAC (ACFG_LO_ADDR_2),
+// so that a precomputed word can be applied without any arithmetic.
+unsigned int LC_word(int coarse, int mid, int fine) {
     //    Inputs:
     //        coarse: 5-bit code (0-31) to control the ~15 MHz step frequency
     //        DAC mid: 5-bit code (0-31) to control the ~800 kHz step frequency
     //        DAC fine: 5-bit code (0-31) to control the ~100 kHz step frequency
     //        DAC
     //    Outputs:
-    //        none, it programs the LC radio frequency immediately
+    //        the register word, see LC_set_word()
 
     // mask to ensure that the coarse, mid, and fine are actually 5-bit
     // 1.1V (NOP)
@@ -1473,11 +1514,20 @@ void LC_FREQCHANGE(int coarse, int mid, int fine) {
     // c0 | c1 | c2 | c3 | c4 ] ACFG_LO_ADDR_2 = [ xx | xx | xx | xx | xx | xx |
     // xx | xx | xx | xx | xx | xx | xx | xx | fd | f0 ]
 
+    return fcode | (fcode2 << 16);
+}
+
+// Program an LC word computed by LC_word() or LC_monotonic_word()
+void LC_set_word(unsigned int word) {
     // set the memory and prevent any overwriting of other analog config
-    SCUM_ANALOG_CFG_REG_7 = fcode;
-    SCUM_ANALOG_CFG_REG_8 = fcode2;
+    SCUM_ANALOG_CFG_REG_7 = word & 0xFFFF;
+    SCUM_ANALOG_CFG_REG_8 = word >> 16;
 }
-void LC_monotonic(int LC_code) {
+
+void LC_monotonic(int LC_code) { LC_set_word(LC_monotonic_word(LC_code)); }
+
+// Map a monotonic LC code onto its coarse/mid/fine word
+unsigned int LC_monotonic_word(int LC_code) {
     // int coarse_divs = 440;
     // int mid_divs = 31; // For full fine code sweeps
 
@@ -1510,7 +1560,7 @@ void LC_monotonic(int LC_code) {
     };
 
     // coarse=24, mid=0, fine=10 worked at Inria for Tx Frequency
-    LC_FREQCHANGE(coarse, mid, fine);
+    return LC_word(coarse, mid, fine);
 }
 
 void set_LC_current(unsigned int current) {
@@ -1673,3 +1723,50 @@ void divProgram(unsigned int div_ratio, unsigned int reset,
     SCUM_ANALOG_CFG_REG_5 = ~div_code_1;
     SCUM_ANALOG_CFG_REG_6 = ~div_code_2;
 }
+
+//=========================== private =========================================
+
+static bool radio_switch_rx_demod(bool zcc) {
+    uint32_t asc[ASC_LEN];
+
+    memcpy(asc, scm3c_hw_interface_vars.ASC, sizeof(asc));
+
+    if (zcc) {
+        radio_init_rx_ZCC();
+        if (scm3c_hw_interface_vars.ZCC_IF_clk_target != 0) {
+            radio_set_ZCC_IF_clk(scm3c_hw_interface_vars.ZCC_IF_clk_target);
+        }
+    } else {
+        radio_init_rx_MF();
+
+        // Turn the ZCC demod off and release its input mux
+        clear_asc_bit(132);
+        clear_asc_bit(238);
+        clear_asc_bit(239);
+    }
+
+    // The RX init functions overwrite the IF clock tuning bits
+    set_IF_clock_frequency(scm3c_hw_interface_vars.IF_coarse,
+                           scm3c_hw_interface_vars.IF_fine, 0);
+
+    if (memcmp(asc, scm3c_hw_interface_vars.ASC, sizeof(asc)) == 0) {
+        return false;
+    }
+
+    analog_scan_chain_write();
+    analog_scan_chain_load();
+    return true;
+}
+
+// Scale the ZCC clock divider and counter threshold to IF clock
+// IF_clk_target, counts per 100 ms
+static void radio_set_ZCC_IF_clk(uint32_t IF_clk_target) {
+    uint32_t zcc_threshold;
+
+    zcc_threshold = (ZCC_THRESHOLD_REF * IF_clk_target +
+                     ZCC_THRESHOLD_REF_COUNTS / 2) /
+                    ZCC_THRESHOLD_REF_COUNTS;
+    set_zcc_demod_threshold(zcc_threshold > 0 ? zcc_threshold : 1);
+    set_IF_ZCC_clkdiv((IF_clk_target + ZCC_CHIP_RATE_COUNTS / 2) /
+                      ZCC_CHIP_RATE_COUNTS);
+}
@@ -1,10 +1,16 @@
 #ifndef __SCM3C_HW_INTERFACE_H
 #define __SCM3C_HW_INTERFACE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 //=========================== define ==========================================
 
+// Packet detection threshold written to ANALOG_CFG_REG_9 by the RX init
+// functions: the Hamming distance below which the incoming chip stream is
+// taken as a packet. Lower is stricter.
+#define CORRELATION_THRESHOLD_DEFAULT 5
+
 //=========================== typedef =========================================
 
 //=========================== variables =======================================
@@ -23,6 +29,7 @@ uint32_t scm3c_hw_interface_get_RC2M_superfine(void);
 uint32_t scm3c_hw_interface_get_IF_clk_target(void);
 uint32_t scm3c_hw_interface_get_IF_coarse(void);
 uint32_t scm3c_hw_interface_get_IF_fine(void);
+uint32_t scm3c_hw_interface_get_ZCC_IF_clk_target(void);
 
 //===== set function
 
@@ -34,6 +41,7 @@ void scm3c_hw_interface_set_RC2M_superfine(uint32_t value);
 void scm3c_hw_interface_set_IF_clk_target(uint32_t value);
 void scm3c_hw_interface_set_IF_coarse(uint32_t value);
 void scm3c_hw_interface_set_IF_fine(uint32_t value);
+void scm3c_hw_interface_set_ZCC_IF_clk_target(uint32_t value);
 
 void scm3c_hw_interface_set_asc(uint32_t* asc_profile);
 
@@ -46,6 +54,8 @@ void init_ldo_control(void);
 unsigned int sram_test(unsigned int* baseAddress, unsigned int num_dwords);
 void radio_init_rx_MF(void);
 void radio_init_rx_ZCC(void);
+bool radio_switch_rx_MF(void);
+bool radio_switch_rx_ZCC(void);
 void radio_init_tx(void);
 void radio_init_divider(unsigned int div_value);
 void radio_disable_all(void);
@@ -110,6 +120,9 @@ void set_DIV_supply(unsigned int code, unsigned char panic);
 void prescaler(int code);
 void LC_monotonic(int LC_code);
 void LC_FREQCHANGE(int coarse, int mid, int fine);
+unsigned int LC_monotonic_word(int LC_code);
+unsigned int LC_word(int coarse, int mid, int fine);
+void LC_set_word(unsigned int word);
 void divProgram(unsigned int div_ratio, unsigned int reset,
                 unsigned int enable);
 
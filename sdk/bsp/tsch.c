@@ -0,0 +1,439 @@
+#include "tsch.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "scum.h"
+#include "autoack.h"
+#include "ieee_802_15_4.h"
+#include "radio.h"
+#include "rftimer.h"
+
+//=========================== define ==========================================
+
+#define TSCH_RFTIMER_ID 4
+
+//===== enhanced beacon
+// FCF: beacon, IE present, frame version 2015, no destination address, short
+// source address. It is followed by the sequence number, source PAN ID and
+// source address, a header IE termination and an MLME payload IE holding the
+// TSCH synchronization sub-IE (ASN and join metric).
+#define TSCH_EB_FCF_LOW 0x00
+#define TSCH_EB_FCF_HIGH 0xA2
+#define TSCH_EB_PAN_ID_OFFSET 3
+#define TSCH_EB_SRC_ADDR_OFFSET 5
+#define TSCH_EB_IES_OFFSET 7
+#define TSCH_EB_ASN_OFFSET 13
+#define TSCH_EB_JOIN_METRIC_OFFSET 18
+#define TSCH_EB_LENGTH 19  // without FCS
+
+//=========================== variables =======================================
+
+// Header IE termination 1, MLME payload IE (8 bytes), TSCH synchronization
+// sub-IE (6 bytes)
+static const uint8_t tsch_eb_ies[TSCH_EB_ASN_OFFSET - TSCH_EB_IES_OFFSET] = {
+    0x00, 0x3F, 0x08, 0x88, 0x06, 0x1A};
+
+// Default 16-channel hopping sequence
+static const uint8_t tsch_hopping_sequence[IEEE_802_15_4_NUM_CHANNELS] = {
+    16, 17, 23, 18, 26, 15, 25, 22, 19, 11, 12, 13, 24, 14, 20, 21};
+
+typedef struct {
+    uint16_t pan_id;
+    uint16_t short_addr;
+
+    // Schedule
+    uint16_t slotframe_length;
+    tsch_cell_t cells[TSCH_MAX_CELLS];
+    uint8_t num_cells;
+
+    // Timeslot state. slot_start is the RF timer count at the start of the
+    // timeslot identified by asn.
+    bool running;
+    bool coordinator;
+    volatile bool synchronized;
+    uint8_t scan_channel;
+    uint64_t asn;
+    uint16_t slot_offset;
+    uint32_t slot_start;
+    uint32_t next_slot_start;
+    uint32_t slots_since_sync;
+    uint8_t channel;
+    uint32_t tx_start;
+
+    uint8_t eb[TSCH_EB_LENGTH + 1] __attribute__((aligned(4)));
+    bool tx_eb;
+
+    // Frame waiting for a TX cell
+    uint8_t* tx_packet;
+    uint8_t tx_len;
+    uint8_t tx_retries;
+    tsch_tx_cbt tx_cb;
+} tsch_vars_t;
+
+tsch_vars_t tsch_vars;
+
+//=========================== prototypes ======================================
+
+static radio_rx_verdict_t tsch_rx_hook(radio_rx_slot_t* slot,
+                                       uint32_t timestamp);
+static void tsch_sync(uint32_t sfd_timestamp, const uint8_t* asn);
+static void tsch_scan(void);
+static const tsch_cell_t* tsch_find_cell(uint16_t slot_offset);
+static void tsch_tx(uint8_t* packet, uint8_t pkt_len);
+static void tsch_rx(void);
+static void tsch_tx_finish(tsch_status_t status);
+static void cb_tsch_slot(void);
+static void cb_tsch_scan_done(radio_status_t status);
+static void cb_tsch_tx_done(radio_status_t status);
+static void cb_tsch_ack_done(radio_status_t status);
+
+//=========================== public ==========================================
+
+// Initialize the TSCH engine with an empty schedule. Frames are acknowledged
+// through the autoack module, which is initialized here.
+void tsch_init(uint16_t pan_id, uint16_t short_addr) {
+    memset(&tsch_vars, 0, sizeof(tsch_vars_t));
+
+    tsch_vars.pan_id = pan_id;
+    tsch_vars.short_addr = short_addr;
+    tsch_vars.slotframe_length = 1;
+
+    tsch_vars.eb[0] = TSCH_EB_FCF_LOW;
+    tsch_vars.eb[1] = TSCH_EB_FCF_HIGH;
+    tsch_vars.eb[TSCH_EB_PAN_ID_OFFSET] = pan_id & 0xFF;
+    tsch_vars.eb[TSCH_EB_PAN_ID_OFFSET + 1] = pan_id >> 8;
+    tsch_vars.eb[TSCH_EB_SRC_ADDR_OFFSET] = short_addr & 0xFF;
+    tsch_vars.eb[TSCH_EB_SRC_ADDR_OFFSET + 1] = short_addr >> 8;
+    memcpy(&tsch_vars.eb[TSCH_EB_IES_OFFSET], tsch_eb_ies,
+           sizeof(tsch_eb_ies));
+
+    autoack_init();
+    autoack_set_address(pan_id, short_addr, NULL);
+}
+
+// Set the number of timeslots in the slotframe. Only allowed while stopped.
+bool tsch_set_slotframe(uint16_t length) {
+    if (tsch_vars.running || length == 0) {
+        return false;
+    }
+    tsch_vars.slotframe_length = length;
+    return true;
+}
+
+// Add a cell to the schedule. Returns false if the schedule is full, the cell
+// lies outside the slotframe or its timeslot is already scheduled.
+bool tsch_add_cell(const tsch_cell_t* cell) {
+    if (tsch_vars.num_cells == TSCH_MAX_CELLS ||
+        cell->slot_offset >= tsch_vars.slotframe_length ||
+        tsch_find_cell(cell->slot_offset) != NULL) {
+        return false;
+    }
+    tsch_vars.cells[tsch_vars.num_cells++] = *cell;
+    return true;
+}
+
+void tsch_clear_cells(void) { tsch_vars.num_cells = 0; }
+
+// Start a network as its time source: the slotframe starts now with ASN 0,
+// and an enhanced beacon is sent in every EB cell.
+void tsch_start_coordinator(void) {
+    tsch_vars.running = true;
+    tsch_vars.coordinator = true;
+    tsch_vars.synchronized = true;
+    tsch_vars.asn = 0;
+    tsch_vars.slot_offset = 0;
+    tsch_vars.slot_start = rftimer_readCounter();
+    tsch_vars.next_slot_start = tsch_vars.slot_start + TSCH_SLOT_TICKS;
+
+    radio_set_rx_hook(tsch_rx_hook);
+    autoack_set_turnaround(TSCH_TX_ACK_DELAY_TICKS);
+
+    rftimer_set_callback_by_id(cb_tsch_slot, TSCH_RFTIMER_ID);
+    rftimer_setCompareIn_by_id(tsch_vars.next_slot_start, TSCH_RFTIMER_ID);
+}
+
+// Join a network: listen on scan_channel until an enhanced beacon of our PAN
+// is received, then follow the schedule from the ASN it carries. The timeslot
+// boundaries are corrected with the SFD timestamp of every later beacon.
+void tsch_start_join(uint8_t scan_channel) {
+    tsch_vars.running = true;
+    tsch_vars.coordinator = false;
+    tsch_vars.synchronized = false;
+    tsch_vars.scan_channel = scan_channel;
+
+    radio_set_rx_hook(tsch_rx_hook);
+    autoack_set_turnaround(TSCH_TX_ACK_DELAY_TICKS);
+
+    tsch_scan();
+}
+
+void tsch_stop(void) {
+    tsch_vars.running = false;
+    tsch_vars.synchronized = false;
+    rftimer_disable_interrupts_by_id(TSCH_RFTIMER_ID);
+    radio_rx_cancel();
+
+    radio_set_rx_hook(autoack_rx_hook);
+    autoack_set_turnaround(AUTOACK_TURNAROUND_TICKS);
+}
+
+bool tsch_is_synchronized(void) { return tsch_vars.synchronized; }
+
+// The ASN is incremented by the slot interrupt and takes two loads to read
+uint64_t tsch_get_asn(void) {
+    uint64_t asn;
+
+    __disable_irq();
+    asn = tsch_vars.asn;
+    __enable_irq();
+    return asn;
+}
+
+// Queue a frame for the next TX cell. pkt_len includes the CRC. A frame with
+// the ACK request bit set is retried in the following TX cells, up to
+// TSCH_MAX_RETRIES times, until it is acknowledged. cb is called from
+// interrupt context. Returns false if a frame is already queued.
+bool tsch_send_async(void* packet, uint8_t pkt_len, tsch_tx_cbt cb) {
+    if (tsch_vars.tx_packet != NULL) {
+        return false;
+    }
+
+    tsch_vars.tx_len = pkt_len;
+    tsch_vars.tx_retries = 0;
+    tsch_vars.tx_cb = cb;
+    tsch_vars.tx_packet = packet;
+    return true;
+}
+
+bool tsch_tx_pending(void) { return tsch_vars.tx_packet != NULL; }
+
+//=========================== private =========================================
+
+// Enhanced beacons are consumed here; every other frame goes through the
+// auto-ACK engine.
+static radio_rx_verdict_t tsch_rx_hook(radio_rx_slot_t* slot,
+                                       uint32_t timestamp) {
+    const uint8_t* frame = &slot->buffer[1];
+
+    if (slot->length == TSCH_EB_LENGTH + LENGTH_CRC &&
+        frame[0] == TSCH_EB_FCF_LOW && frame[1] == TSCH_EB_FCF_HIGH &&
+        frame[TSCH_EB_PAN_ID_OFFSET] == (tsch_vars.pan_id & 0xFF) &&
+        frame[TSCH_EB_PAN_ID_OFFSET + 1] == (tsch_vars.pan_id >> 8) &&
+        memcmp(&frame[TSCH_EB_IES_OFFSET], tsch_eb_ies,
+               sizeof(tsch_eb_ies)) == 0) {
+        if (!tsch_vars.coordinator) {
+            tsch_sync(slot->timestamp, &frame[TSCH_EB_ASN_OFFSET]);
+        }
+        return RADIO_RX_HOOK_CONSUME;
+    }
+
+    return autoack_rx_hook(slot, timestamp);
+}
+
+// The beacon was sent TSCH_TX_OFFSET_TICKS into its timeslot, which gives the
+// start of that timeslot from the SFD timestamp
+static void tsch_sync(uint32_t sfd_timestamp, const uint8_t* asn) {
+    uint32_t slot_start =
+        sfd_timestamp - TSCH_TX_OFFSET_TICKS - TSCH_SFD_TICKS;
+    int32_t error;
+    uint8_t i;
+
+    tsch_vars.slots_since_sync = 0;
+
+    if (!tsch_vars.synchronized) {
+        tsch_vars.asn = 0;
+        for (i = 0; i < 5; i++) {
+            tsch_vars.asn |= (uint64_t)asn[i] << (8 * i);
+        }
+        tsch_vars.slot_offset = tsch_vars.asn % tsch_vars.slotframe_length;
+        tsch_vars.slot_start = slot_start;
+        tsch_vars.next_slot_start = slot_start + TSCH_SLOT_TICKS;
+        tsch_vars.synchronized = true;
+        return;
+    }
+
+    // Drift correction: move the next timeslot boundary by the offset
+    // between the expected and the measured start of this one
+    error = (int32_t)(slot_start - tsch_vars.slot_start);
+    if (error > TSCH_RX_WAIT_TICKS / 2 || error < -TSCH_RX_WAIT_TICKS / 2) {
+        return;
+    }
+    tsch_vars.slot_start += error;
+    tsch_vars.next_slot_start += error;
+    rftimer_setCompareIn_by_id(tsch_vars.next_slot_start, TSCH_RFTIMER_ID);
+}
+
+static void tsch_scan(void) {
+    radio_setFrequency(tsch_vars.scan_channel, FREQ_RX);
+    radio_rx_async(0, cb_tsch_scan_done);
+}
+
+static const tsch_cell_t* tsch_find_cell(uint16_t slot_offset) {
+    uint8_t i;
+
+    for (i = 0; i < tsch_vars.num_cells; i++) {
+        if (tsch_vars.cells[i].slot_offset == slot_offset) {
+            return &tsch_vars.cells[i];
+        }
+    }
+    return NULL;
+}
+
+// Load the frame now and have the RF timer start it at TsTxOffset
+static void tsch_tx(uint8_t* packet, uint8_t pkt_len) {
+    radio_setFrequency(tsch_vars.channel, FREQ_TX);
+    radio_loadPacket(packet, pkt_len);
+    radio_txEnable();
+
+    tsch_vars.tx_start = tsch_vars.slot_start + TSCH_TX_OFFSET_TICKS;
+    if (!radio_schedule_tx_at(tsch_vars.tx_start, cb_tsch_tx_done)) {
+        radio_rfOff();
+        tsch_vars.tx_eb = false;
+    }
+}
+
+// Listen from TsRxOffset for TsRxWait; the window stays open once an SFD is
+// detected
+static void tsch_rx(void) {
+    uint32_t start = tsch_vars.slot_start + TSCH_RX_OFFSET_TICKS;
+
+    radio_setFrequency(tsch_vars.channel, FREQ_RX);
+    radio_rxEnable();
+    if (!radio_schedule_rx_window(start, start + TSCH_RX_WAIT_TICKS, NULL)) {
+        radio_rfOff();
+    }
+}
+
+static void tsch_tx_finish(tsch_status_t status) {
+    tsch_tx_cbt cb = tsch_vars.tx_cb;
+
+    tsch_vars.tx_cb = NULL;
+    tsch_vars.tx_packet = NULL;
+
+    if (cb != NULL) {
+        cb(status);
+    }
+}
+
+// Start of a timeslot
+static void cb_tsch_slot(void) {
+    const tsch_cell_t* cell;
+    uint8_t i;
+
+    if (!tsch_vars.running) {
+        return;
+    }
+
+    tsch_vars.slot_start = tsch_vars.next_slot_start;
+    tsch_vars.next_slot_start += TSCH_SLOT_TICKS;
+    rftimer_setCompareIn_by_id(tsch_vars.next_slot_start, TSCH_RFTIMER_ID);
+
+    tsch_vars.asn++;
+    tsch_vars.slot_offset++;
+    if (tsch_vars.slot_offset == tsch_vars.slotframe_length) {
+        tsch_vars.slot_offset = 0;
+    }
+
+    if (!tsch_vars.coordinator &&
+        ++tsch_vars.slots_since_sync > TSCH_DESYNC_TIMEOUT_SLOTS) {
+        tsch_vars.synchronized = false;
+        rftimer_disable_interrupts_by_id(TSCH_RFTIMER_ID);
+        radio_rx_cancel();
+        tsch_scan();
+        return;
+    }
+
+    // The previous timeslot overran, skip this one
+    if (radio_busy()) {
+        return;
+    }
+
+    cell = tsch_find_cell(tsch_vars.slot_offset);
+    if (cell == NULL) {
+        return;
+    }
+
+    // The hopping sequence length is a power of 2, the low byte of the ASN
+    // is enough
+    i = ((uint8_t)tsch_vars.asn + cell->channel_offset) &
+        (IEEE_802_15_4_NUM_CHANNELS - 1);
+    tsch_vars.channel = tsch_hopping_sequence[i];
+
+    if (cell->options & TSCH_CELL_OPTION_EB) {
+        if (!tsch_vars.coordinator) {
+            tsch_rx();
+            return;
+        }
+
+        tsch_vars.eb[IEEE_802_15_4_SEQ_NUM_OFFSET]++;
+        for (i = 0; i < 5; i++) {
+            tsch_vars.eb[TSCH_EB_ASN_OFFSET + i] = tsch_vars.asn >> (8 * i);
+        }
+        tsch_vars.eb[TSCH_EB_JOIN_METRIC_OFFSET] = 0;
+        tsch_vars.tx_eb = true;
+        tsch_tx(tsch_vars.eb, TSCH_EB_LENGTH + LENGTH_CRC);
+    } else if ((cell->options & TSCH_CELL_OPTION_TX) &&
+               tsch_vars.tx_packet != NULL) {
+        tsch_tx(tsch_vars.tx_packet, tsch_vars.tx_len);
+    } else if (cell->options & TSCH_CELL_OPTION_RX) {
+        tsch_rx();
+    }
+}
+
+static void cb_tsch_scan_done(radio_status_t status) {
+    if (!tsch_vars.running) {
+        return;
+    }
+
+    if (!tsch_vars.synchronized) {
+        tsch_scan();
+        return;
+    }
+
+    rftimer_set_callback_by_id(cb_tsch_slot, TSCH_RFTIMER_ID);
+    rftimer_setCompareIn_by_id(tsch_vars.next_slot_start, TSCH_RFTIMER_ID);
+}
+
+// The frame is on the air; listen for its ACK TsTxAckDelay after its end
+static void cb_tsch_tx_done(radio_status_t status) {
+    uint32_t ack_start;
+
+    if (tsch_vars.tx_eb) {
+        tsch_vars.tx_eb = false;
+        return;
+    }
+
+    if ((tsch_vars.tx_packet[0] & IEEE_802_15_4_FCF_ACK_REQUEST) == 0) {
+        tsch_tx_finish(TSCH_STATUS_SENT);
+        return;
+    }
+
+    ack_start = tsch_vars.tx_start +
+                (IEEE_802_15_4_PHY_OVERHEAD + tsch_vars.tx_len) *
+                    IEEE_802_15_4_BYTE_TICKS +
+                TSCH_TX_ACK_DELAY_TICKS - TSCH_ACK_WAIT_TICKS / 2;
+
+    autoack_expect_ack(tsch_vars.tx_packet[IEEE_802_15_4_SEQ_NUM_OFFSET]);
+    radio_setFrequency(tsch_vars.channel, FREQ_RX);
+    radio_rxEnable();
+    if (!radio_schedule_rx_window(ack_start,
+                                  ack_start + TSCH_ACK_WAIT_TICKS +
+                                      TSCH_SFD_TICKS,
+                                  cb_tsch_ack_done)) {
+        radio_rfOff();
+        cb_tsch_ack_done(RADIO_STATUS_TIMEOUT);
+    }
+}
+
+static void cb_tsch_ack_done(radio_status_t status) {
+    if (autoack_ack_received()) {
+        tsch_tx_finish(TSCH_STATUS_SENT);
+    } else if (tsch_vars.tx_retries < TSCH_MAX_RETRIES) {
+        // Retry in the next TX cell
+        tsch_vars.tx_retries++;
+    } else {
+        tsch_tx_finish(TSCH_STATUS_NO_ACK);
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef __TSCH_H
+#define __TSCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//=========================== define ==========================================
+
+// IEEE 802.15.4 default timeslot template (10 ms timeslot), in RF timer ticks
+// (500 ticks = 1 ms)
+#define TSCH_SLOT_TICKS 5000
+#define TSCH_TX_OFFSET_TICKS 1060     // TsTxOffset, 2120 us
+#define TSCH_RX_OFFSET_TICKS 510      // TsRxOffset, 1020 us
+#define TSCH_RX_WAIT_TICKS 1100       // TsRxWait, 2200 us
+#define TSCH_TX_ACK_DELAY_TICKS 500   // TsTxAckDelay, 1000 us
+#define TSCH_ACK_WAIT_TICKS 200       // TsAckWait, 400 us
+
+// Time from TX_SEND to the SFD capture: 4 bytes of preamble and the SFD
+#define TSCH_SFD_TICKS 80
+
+#define TSCH_MAX_CELLS 8
+#define TSCH_MAX_RETRIES 3
+
+// A node that hears no enhanced beacon for this many timeslots (30 s) drops
+// its synchronization and scans again
+#define TSCH_DESYNC_TIMEOUT_SLOTS 3000
+
+//=========================== typedef =========================================
+
+typedef enum {
+    TSCH_CELL_OPTION_TX = 0x01,
+    TSCH_CELL_OPTION_RX = 0x02,
+    // Enhanced beacon cell: sent by the coordinator, received by the nodes
+    TSCH_CELL_OPTION_EB = 0x04,
+} tsch_cell_option_t;
+
+typedef struct {
+    uint16_t slot_offset;
+    uint8_t channel_offset;
+    uint8_t options;  // tsch_cell_option_t flags
+} tsch_cell_t;
+
+typedef enum {
+    TSCH_STATUS_SENT = 0x01,  // acknowledged, if an ACK was requested
+    TSCH_STATUS_NO_ACK = 0x02,
+} tsch_status_t;
+
+typedef void (*tsch_tx_cbt)(tsch_status_t status);
+
+//=========================== prototypes ======================================
+
+void tsch_init(uint16_t pan_id, uint16_t short_addr);
+bool tsch_set_slotframe(uint16_t length);
+bool tsch_add_cell(const tsch_cell_t* cell);
+void tsch_clear_cells(void);
+
+void tsch_start_coordinator(void);
+void tsch_start_join(uint8_t scan_channel);
+void tsch_stop(void);
+bool tsch_is_synchronized(void);
+uint64_t tsch_get_asn(void);
+
+bool tsch_send_async(void* packet, uint8_t pkt_len, tsch_tx_cbt cb);
+bool tsch_tx_pending(void);
+
+#endif
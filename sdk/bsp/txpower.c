@@ -0,0 +1,248 @@
+#include "txpower.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "scum.h"
+#include "ieee_802_15_4.h"
+#include "neighbor_table.h"
+#include "scm3c_hw_interface.h"
+
+//=========================== define ==========================================
+
+// Two frames lost in a row raise the level without waiting for the window
+#define TXPOWER_UP_LOSSES 2
+
+// When the receiver reports the link quality, the level is only lowered
+// while it hears us well above its sensitivity, and raised as soon as it
+// hears us close to it. The RSSI of a SCuM receiver bottoms out at -85 dBm,
+// its highest AGC gain: lowered from 10 dB above it, raised within 3 dB.
+#define TXPOWER_DOWN_MIN_RSSI (-75)
+#define TXPOWER_DOWN_MAX_CHIP_ERRORS 12
+#define TXPOWER_UP_RSSI (-82)
+
+// The scan chain holds no known level
+#define TXPOWER_LEVEL_UNKNOWN 0xFF
+
+//=========================== variables =======================================
+
+typedef struct {
+    neighbor_table_entry_t entry;
+    uint8_t level;
+    uint8_t sent;  // frames sent in the current window
+    uint8_t lost;
+    uint8_t lost_in_row;
+    bool feedback;  // link quality reported at the current level
+    int8_t rssi;
+    uint8_t chip_errors;
+} txpower_neighbor_t;
+
+typedef struct {
+    txpower_level_t levels[TXPOWER_MAX_LEVELS];
+    uint8_t num_levels;
+    uint16_t per_target;
+    txpower_neighbor_t neighbors[TXPOWER_MAX_NEIGHBORS];
+    neighbor_table_t table;
+    uint8_t current_level;  // level programmed in the scan chain
+    txpower_stats_t stats;
+} txpower_vars_t;
+
+txpower_vars_t txpower_vars;
+
+// From the lowest power to the radio_init_tx() setting. Only the PA supply is
+// stepped: the LO supply also pulls the LC oscillator off its calibrated
+// channel codes, so it is only trimmed by per-chip tables characterized for
+// it.
+static const txpower_level_t txpower_default_levels[] = {
+    {7, 127},  {15, 127}, {23, 127}, {31, 127},
+    {39, 127}, {47, 127}, {55, 127}, {63, 127},
+};
+
+//=========================== prototypes ======================================
+
+static void txpower_step(txpower_neighbor_t* neighbor, bool up);
+
+//=========================== public ==========================================
+
+// Initialize the TX power controller with the default power table. The
+// radio_init_tx() supplies are taken as the highest level, which new
+// neighbors start at.
+void txpower_init(void) {
+    memset(&txpower_vars, 0, sizeof(txpower_vars_t));
+    neighbor_table_init(&txpower_vars.table, txpower_vars.neighbors,
+                        TXPOWER_MAX_NEIGHBORS, sizeof(txpower_neighbor_t));
+
+    txpower_load_table(
+        txpower_default_levels,
+        sizeof(txpower_default_levels) / sizeof(txpower_default_levels[0]));
+    txpower_vars.per_target = TXPOWER_DEFAULT_PER_TARGET;
+    txpower_vars.current_level = txpower_vars.num_levels - 1;
+}
+
+// Replace the power table with the one characterized for this chip, ordered
+// from the lowest to the highest power. Every neighbor goes back to the
+// highest level. Returns false if num_levels is out of range.
+bool txpower_load_table(const txpower_level_t* levels, uint8_t num_levels) {
+    if (num_levels == 0 || num_levels > TXPOWER_MAX_LEVELS) {
+        return false;
+    }
+
+    __disable_irq();
+    memcpy(txpower_vars.levels, levels, num_levels * sizeof(txpower_level_t));
+    txpower_vars.num_levels = num_levels;
+    txpower_vars.current_level = TXPOWER_LEVEL_UNKNOWN;
+    neighbor_table_clear(&txpower_vars.table);
+    __enable_irq();
+    return true;
+}
+
+// Packet error rate each neighbor is kept under, in per mille
+void txpower_set_per_target(uint16_t per_mille) {
+    txpower_vars.per_target = per_mille;
+}
+
+// Program the TX power level of neighbor addr before sending it a frame of
+// pkt_len bytes, CRC included, and account the frame to that level.
+// Broadcast frames go out at the highest level. The supplies are set through
+// the analog scan chain, which is only shifted when the level changes. Must
+// be called from thread context while the radio is idle. Returns the level.
+uint8_t txpower_select(uint16_t addr, uint8_t pkt_len) {
+    txpower_neighbor_t* neighbor;
+    neighbor_table_result_t result;
+    const txpower_level_t* settings;
+    uint8_t level = txpower_vars.num_levels - 1;
+
+    __disable_irq();
+    if (addr != IEEE_802_15_4_BROADCAST_ADDR) {
+        neighbor = neighbor_table_add(&txpower_vars.table, addr, &result);
+        if (result != NEIGHBOR_TABLE_FOUND) {
+            neighbor->level = txpower_vars.num_levels - 1;
+        }
+        level = neighbor->level;
+    }
+    txpower_vars.stats.frames[level]++;
+    txpower_vars.stats.airtime_ticks[level] +=
+        (uint32_t)(pkt_len + IEEE_802_15_4_PHY_OVERHEAD) *
+        IEEE_802_15_4_BYTE_TICKS;
+    __enable_irq();
+
+    if (level != txpower_vars.current_level) {
+        settings = &txpower_vars.levels[level];
+        set_PA_supply(settings->pa_supply);
+        set_LO_supply(settings->lo_supply, 0);
+        analog_scan_chain_write();
+        analog_scan_chain_load();
+        txpower_vars.current_level = level;
+        txpower_vars.stats.level_changes++;
+    }
+    return level;
+}
+
+// Feed the outcome of a frame sent to addr, e.g. from an autoack or CSMA-CA
+// completion callback. Every TXPOWER_WINDOW_FRAMES frames the level is raised
+// if the packet error rate exceeds the target, or lowered if it is under half
+// the target and the link quality, when reported, leaves a margin. Two losses
+// in a row raise it right away. May be called from interrupt context.
+void txpower_report_tx(uint16_t addr, bool acked) {
+    txpower_neighbor_t* neighbor;
+    uint32_t per;
+
+    __disable_irq();
+    neighbor = neighbor_table_find(&txpower_vars.table, addr);
+    if (neighbor == NULL) {
+        __enable_irq();
+        return;
+    }
+
+    neighbor->sent++;
+    if (acked) {
+        neighbor->lost_in_row = 0;
+    } else {
+        neighbor->lost++;
+        neighbor->lost_in_row++;
+    }
+
+    if (neighbor->lost_in_row >= TXPOWER_UP_LOSSES) {
+        txpower_step(neighbor, true);
+    } else if (neighbor->sent >= TXPOWER_WINDOW_FRAMES) {
+        per = (uint32_t)neighbor->lost * 1000 / neighbor->sent;
+        if (per > txpower_vars.per_target) {
+            txpower_step(neighbor, true);
+        } else if (per <= txpower_vars.per_target / 2 &&
+                   (!neighbor->feedback ||
+                    (neighbor->rssi >= TXPOWER_DOWN_MIN_RSSI &&
+                     neighbor->chip_errors <= TXPOWER_DOWN_MAX_CHIP_ERRORS))) {
+            txpower_step(neighbor, false);
+        } else {
+            neighbor->sent = 0;
+            neighbor->lost = 0;
+        }
+    }
+    __enable_irq();
+}
+
+// Feed the link quality at which neighbor addr hears us: the RSSI (dBm) and
+// chip errors it reports back, or those of its ACKs from
+// autoack_get_ack_quality(). May be called from interrupt context.
+void txpower_report_link(uint16_t addr, int8_t rssi, uint8_t chip_errors) {
+    txpower_neighbor_t* neighbor;
+
+    __disable_irq();
+    neighbor = neighbor_table_find(&txpower_vars.table, addr);
+    if (neighbor == NULL) {
+        __enable_irq();
+        return;
+    }
+
+    neighbor->rssi =
+        neighbor->feedback ? (int8_t)((3 * neighbor->rssi + rssi) / 4) : rssi;
+    neighbor->chip_errors = chip_errors;
+    neighbor->feedback = true;
+    if (rssi <= TXPOWER_UP_RSSI) {
+        txpower_step(neighbor, true);
+    }
+    __enable_irq();
+}
+
+// Current level of neighbor addr; the highest one for unknown neighbors
+uint8_t txpower_get_level(uint16_t addr) {
+    txpower_neighbor_t* neighbor;
+    uint8_t level = txpower_vars.num_levels - 1;
+
+    __disable_irq();
+    neighbor = neighbor_table_find(&txpower_vars.table, addr);
+    if (neighbor != NULL) {
+        level = neighbor->level;
+    }
+    __enable_irq();
+    return level;
+}
+
+void txpower_get_stats(txpower_stats_t* stats) {
+    __disable_irq();
+    *stats = txpower_vars.stats;
+    __enable_irq();
+}
+
+void txpower_reset_stats(void) {
+    __disable_irq();
+    memset(&txpower_vars.stats, 0, sizeof(txpower_stats_t));
+    __enable_irq();
+}
+
+//=========================== private =========================================
+
+// Move a neighbor one level up or down and start a new window
+static void txpower_step(txpower_neighbor_t* neighbor, bool up) {
+    if (up && neighbor->level < txpower_vars.num_levels - 1) {
+        neighbor->level++;
+    } else if (!up && neighbor->level > 0) {
+        neighbor->level--;
+    }
+
+    neighbor->sent = 0;
+    neighbor->lost = 0;
+    neighbor->lost_in_row = 0;
+    neighbor->feedback = false;
+}
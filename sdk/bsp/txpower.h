@@ -0,0 +1,50 @@
+#ifndef __TXPOWER_H
+#define __TXPOWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//=========================== define ==========================================
+
+// Number of neighbors tracked; the least recently used one is evicted
+#ifndef TXPOWER_MAX_NEIGHBORS
+#define TXPOWER_MAX_NEIGHBORS 8
+#endif
+
+#define TXPOWER_MAX_LEVELS 8
+
+// Default packet error rate target, in per mille
+#define TXPOWER_DEFAULT_PER_TARGET 100
+
+// Frames sent to a neighbor between two evaluations of its packet error rate
+#define TXPOWER_WINDOW_FRAMES 16
+
+//=========================== typedef =========================================
+
+// PA and LO supply codes of a TX power level
+typedef struct {
+    uint8_t pa_supply;  // set_PA_supply() code, 63 is the max
+    uint8_t lo_supply;  // set_LO_supply() code, 127 is the max
+} txpower_level_t;
+
+typedef struct {
+    uint32_t frames[TXPOWER_MAX_LEVELS];
+    uint32_t airtime_ticks[TXPOWER_MAX_LEVELS];  // time on the air
+    uint32_t level_changes;  // PA and LO supplies reprogrammed
+} txpower_stats_t;
+
+//=========================== prototypes ======================================
+
+void txpower_init(void);
+bool txpower_load_table(const txpower_level_t* levels, uint8_t num_levels);
+void txpower_set_per_target(uint16_t per_mille);
+
+uint8_t txpower_select(uint16_t addr, uint8_t pkt_len);
+void txpower_report_tx(uint16_t addr, bool acked);
+void txpower_report_link(uint16_t addr, int8_t rssi, uint8_t chip_errors);
+uint8_t txpower_get_level(uint16_t addr);
+
+void txpower_get_stats(txpower_stats_t* stats);
+void txpower_reset_stats(void);
+
+#endif
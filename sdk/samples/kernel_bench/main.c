@@ -0,0 +1,220 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ble.h"
+#include "ieee_802_15_4.h"
+#include "optical.h"
+#include "rftimer.h"
+#include "scum.h"
+
+// Cortex-M0 cost of the target-independent bsp kernels. Each kernel is called
+// BENCH_ITERATIONS times back to back and the batch is timed with SysTick,
+// which counts CPU cycles, and with the RF timer. The cost of an empty call
+// is measured the same way and subtracted. If the core was built without
+// SysTick, only the time is reported. The BLE kernels are compared with the
+// bit-serial LFSRs they replace. RF_Handler() is called with no radio event
+// pending, which is the cost of its entry, error decoding and exit, and then
+// with the printf of the interrupt word it used to make on every interrupt.
+// The benchmark repeats every second.
+
+#define BENCH_ITERATIONS 1000
+
+// Each printf of the interrupt word blocks for 10 characters on the UART
+#define BENCH_PRINTF_ITERATIONS 10
+
+// RF timer tick, 2 us
+#define RFTIMER_TICK_NS 2000
+#define BENCH_PERIOD_TICKS 500000
+
+#define SYSTICK_MAX 0xFFFFFF
+
+typedef void (*bench_kernel_t)(void);
+
+typedef struct {
+    uint32_t cycles;  // 0 without SysTick
+    uint32_t ticks;
+} bench_result_t;
+
+void bench_run(bench_kernel_t kernel, uint16_t iterations,
+               bench_result_t* result);
+void bench_report(const char* name, bench_kernel_t kernel,
+                  uint16_t iterations);
+void bench_empty(void);
+void bench_parse(void);
+void bench_build(void);
+void bench_crc24(void);
+void bench_crc24_bitwise(void);
+void bench_whiten(void);
+void bench_whiten_bitwise(void);
+void bench_rf_handler(void);
+void bench_rf_handler_printf(void);
+void RF_Handler(void);
+
+bool systick_present;
+bench_result_t overhead;
+
+// Data frame between short addresses of the same PAN with a 20-byte payload,
+// FCS included
+uint8_t data_frame[9 + 20 + 2];
+uint8_t tx_buffer[128];
+ieee_802_15_4_frame_t data_header;
+volatile uint8_t sink;
+
+// Longest legacy advertising PDU, header included
+uint8_t ble_pdu[BLE_PDU_HEADER_LENGTH + BLE_ADV_ADDRESS_LENGTH +
+                BLE_MAX_ADV_DATA_LENGTH];
+volatile uint32_t ble_sink;
+
+int main(void) {
+    ieee_802_15_4_frame_t view;
+    uint32_t start;
+
+    perform_calibration();
+    ble_init();
+
+    SysTick->LOAD = SYSTICK_MAX;
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+    systick_present = SysTick->LOAD != 0;
+
+    memset(&data_header, 0, sizeof(data_header));
+    data_header.frame_type = IEEE_802_15_4_FRAME_TYPE_DATA;
+    data_header.frame_version = IEEE_802_15_4_FRAME_VERSION_2006;
+    data_header.ack_request = true;
+    data_header.dst_addr_mode = IEEE_802_15_4_ADDR_MODE_SHORT;
+    data_header.dst_pan_id = 0xCAFE;
+    data_header.dst_short_addr = 0x1234;
+    data_header.src_addr_mode = IEEE_802_15_4_ADDR_MODE_SHORT;
+    data_header.src_pan_id = 0xCAFE;
+    data_header.src_short_addr = 0x5678;
+    ieee_802_15_4_build_header(data_frame, &data_header);
+    if (!ieee_802_15_4_parse(data_frame, sizeof(data_frame), &view)) {
+        puts("Test frame does not parse");
+    }
+
+    while (1) {
+        bench_run(bench_empty, BENCH_ITERATIONS, &overhead);
+        printf("%u calls per kernel, SysTick %s\r\n", BENCH_ITERATIONS,
+               systick_present ? "present" : "absent");
+        bench_report("ieee_802_15_4_parse", bench_parse, BENCH_ITERATIONS);
+        bench_report("ieee_802_15_4_build_header", bench_build,
+                     BENCH_ITERATIONS);
+        bench_report("ble_crc24", bench_crc24, BENCH_ITERATIONS);
+        bench_report("ble_crc24, bit-serial", bench_crc24_bitwise,
+                     BENCH_ITERATIONS);
+        bench_report("ble_whiten", bench_whiten, BENCH_ITERATIONS);
+        bench_report("ble_whiten, bit-serial", bench_whiten_bitwise,
+                     BENCH_ITERATIONS);
+        bench_report("RF_Handler", bench_rf_handler, BENCH_ITERATIONS);
+        bench_report("RF_Handler, printf of the interrupt word",
+                     bench_rf_handler_printf, BENCH_PRINTF_ITERATIONS);
+
+        start = rftimer_readCounter();
+        while (rftimer_readCounter() - start < BENCH_PERIOD_TICKS) {
+        }
+    }
+}
+
+// Time iterations calls of kernel. SysTick counts down and wraps after 2^24
+// cycles, so a batch must stay under that.
+void bench_run(bench_kernel_t kernel, uint16_t iterations,
+               bench_result_t* result) {
+    uint32_t cycles_start;
+    uint32_t ticks_start;
+    uint16_t i;
+
+    SysTick->VAL = 0;
+    cycles_start = SysTick->VAL;
+    ticks_start = rftimer_readCounter();
+    for (i = 0; i < iterations; i++) {
+        kernel();
+    }
+    result->ticks = rftimer_readCounter() - ticks_start;
+    result->cycles = (cycles_start - SysTick->VAL) & SYSTICK_MAX;
+}
+
+// Print the cycles and nanoseconds per call of kernel, over iterations calls,
+// net of the call overhead
+void bench_report(const char* name, bench_kernel_t kernel,
+                  uint16_t iterations) {
+    bench_result_t result;
+    uint32_t ns;
+
+    bench_run(kernel, iterations, &result);
+    ns = result.ticks * RFTIMER_TICK_NS / iterations -
+         overhead.ticks * RFTIMER_TICK_NS / BENCH_ITERATIONS;
+    if (systick_present) {
+        printf("%s: %lu cycles, %lu ns\r\n", name,
+               result.cycles / iterations - overhead.cycles / BENCH_ITERATIONS,
+               ns);
+    } else {
+        printf("%s: %lu ns\r\n", name, ns);
+    }
+}
+
+void bench_empty(void) {}
+
+void bench_parse(void) {
+    ieee_802_15_4_frame_t view;
+
+    ieee_802_15_4_parse(data_frame, sizeof(data_frame), &view);
+    sink = view.payload_offset;
+}
+
+void bench_build(void) {
+    data_header.seq_num++;
+    sink = ieee_802_15_4_build_header(tx_buffer, &data_header);
+}
+
+void bench_crc24(void) {
+    ble_sink = ble_crc24(ble_pdu, sizeof(ble_pdu), 0x555555);
+}
+
+// One LFSR step per bit, in the bit-reversed form of ble_crc24()
+void bench_crc24_bitwise(void) {
+    uint32_t crc = 0xAAAAAA;
+    uint8_t i;
+    uint8_t j;
+
+    for (i = 0; i < sizeof(ble_pdu); i++) {
+        for (j = 0; j < 8; j++) {
+            if ((crc ^ (ble_pdu[i] >> j)) & 1) {
+                crc = (crc >> 1) ^ 0xDA6000;
+            } else {
+                crc >>= 1;
+            }
+        }
+    }
+    ble_sink = crc;
+}
+
+void bench_whiten(void) { ble_whiten(ble_pdu, sizeof(ble_pdu), 37); }
+
+// One LFSR step per bit, seeded for channel 37 in the upper 7 bits
+void bench_whiten_bitwise(void) {
+    uint8_t lfsr = 0xA6;
+    uint8_t i;
+    uint8_t mask;
+
+    for (i = 0; i < sizeof(ble_pdu); i++) {
+        for (mask = 1; mask != 0; mask <<= 1) {
+            if (lfsr & 0x80) {
+                lfsr ^= 0x11;
+                ble_pdu[i] ^= mask;
+            }
+            lfsr <<= 1;
+        }
+    }
+}
+
+void bench_rf_handler(void) { RF_Handler(); }
+
+// RF_Handler() as it was, with a blocking UART write on every interrupt
+void bench_rf_handler_printf(void) {
+    unsigned int interrupt = SCUM_RF->INT;
+
+    printf("%08x\r\n", interrupt);
+    RF_Handler();
+}
@@ -0,0 +1,290 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "autoack.h"
+#include "csma.h"
+#include "helpers.h"
+#include "ieee_802_15_4.h"
+#include "link_estimator.h"
+#include "lpl.h"
+#include "optical.h"
+#include "radio.h"
+#include "rftimer.h"
+#include "scm3c_hw_interface.h"
+#include "tsch.h"
+#include "txpower.h"
+
+// Two nodes exchanging acknowledged data frames over one of the MAC layers of
+// the bsp, selected by MAC_MODE: unslotted CSMA-CA, low-power listening or
+// TSCH, where the node with the lower address is the coordinator. The MAC
+// layers share an RF timer compare channel, so only one of them runs. Every
+// SEND_PERIOD_TICKS, a frame goes to the peer at the TX power level chosen by
+// txpower. Its outcome and the frames received from the peer feed txpower
+// and the link estimator, whose state is printed every REPORT_FRAMES frames.
+// Flash the two boards with OWN_ADDR and PEER_ADDR swapped.
+
+#define MAC_MODE MAC_MODE_CSMA
+
+#define PAN_ID 0xCAFE
+#define OWN_ADDR 0x0001
+#define PEER_ADDR 0x0002
+#define CHANNEL 11
+
+// Interval between two frames sent to the peer, 1 s
+#define SEND_PERIOD_TICKS 500000
+
+#define PAYLOAD_LENGTH 20
+#define REPORT_FRAMES 10
+
+// Transmissions of a frame over CSMA-CA, retries included. They are made one
+// at a time so that the link estimator sees each of them.
+#define CSMA_MAX_ATTEMPTS 4
+
+// TSCH slotframe: the enhanced beacon cell, then one cell each way
+#define TSCH_SLOTFRAME_LENGTH 11
+#define TSCH_EB_SLOT 0
+#define TSCH_LOW_TO_HIGH_SLOT 1
+#define TSCH_HIGH_TO_LOW_SLOT 2
+
+typedef enum {
+    MAC_MODE_CSMA = 0x00,
+    MAC_MODE_LPL = 0x01,
+    MAC_MODE_TSCH = 0x02,
+} mac_mode_t;
+
+void mac_start(void);
+uint8_t build_frame(void);
+bool send_frame(uint8_t pkt_len);
+void receive_frames(uint32_t until);
+void report(void);
+void cb_tsch_sent(tsch_status_t status);
+
+const mac_mode_t mac_mode = MAC_MODE;
+
+uint8_t packet[MAXLENGTH_TRX_BUFFER] __attribute__((aligned(4)));
+uint8_t seq_num = 0;
+uint32_t frames_sent = 0;
+uint32_t frames_acked = 0;
+uint32_t frames_received = 0;
+
+// Set while a TSCH frame is queued, cleared by cb_tsch_sent()
+volatile bool tsch_busy;
+volatile bool tsch_acked;
+
+int main(void) {
+    uint32_t next_send;
+    uint8_t pkt_len;
+
+    perform_calibration();
+    radio_init();
+
+    // Tune every channel from the calibrated channel 11 code
+    radio_rxEnable();
+    radio_build_channel_table(optical_get_LC_code());
+    radio_rfOff();
+
+    radio_set_address_filter(PAN_ID, OWN_ADDR, NULL);
+    radio_setFrequency(CHANNEL, FREQ_RX);
+    link_estimator_init();
+    txpower_init();
+    mac_start();
+
+    next_send = rftimer_readCounter() + SEND_PERIOD_TICKS;
+    while (1) {
+        receive_frames(next_send);
+        next_send += SEND_PERIOD_TICKS;
+
+        if (mac_mode == MAC_MODE_TSCH && !tsch_is_synchronized()) {
+            continue;
+        }
+
+        pkt_len = build_frame();
+        if (send_frame(pkt_len)) {
+            frames_acked++;
+        }
+        frames_sent++;
+        if (frames_sent % REPORT_FRAMES == 0) {
+            report();
+        }
+    }
+}
+
+void mac_start(void) {
+    csma_config_t config;
+    tsch_cell_t cell;
+
+    switch (mac_mode) {
+        case MAC_MODE_CSMA:
+            autoack_init();
+            autoack_set_address(PAN_ID, OWN_ADDR, NULL);
+            csma_init(OWN_ADDR);
+            csma_get_config(&config);
+            config.max_retries = 0;
+            csma_set_config(&config);
+            break;
+        case MAC_MODE_LPL:
+            autoack_init();
+            autoack_set_address(PAN_ID, OWN_ADDR, NULL);
+            lpl_init();
+            lpl_start();
+            break;
+        case MAC_MODE_TSCH:
+            tsch_init(PAN_ID, OWN_ADDR);
+            tsch_set_slotframe(TSCH_SLOTFRAME_LENGTH);
+
+            cell.channel_offset = 0;
+            cell.slot_offset = TSCH_EB_SLOT;
+            cell.options = TSCH_CELL_OPTION_EB;
+            tsch_add_cell(&cell);
+            cell.slot_offset = TSCH_LOW_TO_HIGH_SLOT;
+            cell.options = OWN_ADDR < PEER_ADDR ? TSCH_CELL_OPTION_TX
+                                                : TSCH_CELL_OPTION_RX;
+            tsch_add_cell(&cell);
+            cell.slot_offset = TSCH_HIGH_TO_LOW_SLOT;
+            cell.options = OWN_ADDR < PEER_ADDR ? TSCH_CELL_OPTION_RX
+                                                : TSCH_CELL_OPTION_TX;
+            tsch_add_cell(&cell);
+
+            if (OWN_ADDR < PEER_ADDR) {
+                tsch_start_coordinator();
+            } else {
+                tsch_start_join(CHANNEL);
+            }
+            break;
+    }
+}
+
+// Data frame to the peer, requesting an ACK. Returns its length, CRC
+// included.
+uint8_t build_frame(void) {
+    ieee_802_15_4_frame_t header;
+    uint8_t len;
+    uint8_t i;
+
+    memset(&header, 0, sizeof(header));
+    header.frame_type = IEEE_802_15_4_FRAME_TYPE_DATA;
+    header.frame_version = IEEE_802_15_4_FRAME_VERSION_2006;
+    header.ack_request = true;
+    header.seq_num_present = true;
+    header.seq_num = seq_num++;
+    header.dst_addr_mode = IEEE_802_15_4_ADDR_MODE_SHORT;
+    header.src_addr_mode = IEEE_802_15_4_ADDR_MODE_SHORT;
+    header.dst_pan_id = PAN_ID;
+    header.src_pan_id = PAN_ID;
+    header.dst_short_addr = PEER_ADDR;
+    header.src_short_addr = OWN_ADDR;
+
+    len = ieee_802_15_4_build_header(packet, &header);
+    for (i = 0; i < PAYLOAD_LENGTH; i++) {
+        packet[len++] = i;
+    }
+    return len + 2;
+}
+
+// Send the frame to the peer and feed the outcome to txpower and the link
+// estimator. Returns whether it was acknowledged.
+bool send_frame(uint8_t pkt_len) {
+    csma_status_t csma_status = CSMA_STATUS_ERROR;
+    bool acked = false;
+    uint8_t attempts;
+    int8_t ack_rssi;
+    uint8_t ack_chip_errors;
+
+    txpower_select(PEER_ADDR, pkt_len);
+
+    switch (mac_mode) {
+        case MAC_MODE_CSMA:
+            for (attempts = 0; attempts < CSMA_MAX_ATTEMPTS && !acked;
+                 attempts++) {
+                csma_status = csma_send(packet, pkt_len);
+                if (csma_status == CSMA_STATUS_CHANNEL_ACCESS_FAILURE) {
+                    break;
+                }
+                acked = csma_status == CSMA_STATUS_SUCCESS;
+                link_estimator_report_tx(PEER_ADDR, CHANNEL, 1, acked);
+            }
+            break;
+        case MAC_MODE_LPL:
+            while (lpl_busy() || radio_busy()) {
+            }
+            acked = lpl_send(packet, pkt_len) == LPL_STATUS_SUCCESS;
+            link_estimator_report_tx(PEER_ADDR, CHANNEL, 1, acked);
+            break;
+        case MAC_MODE_TSCH:
+            // Retried in the next TX cells by TSCH itself
+            tsch_busy = true;
+            if (tsch_send_async(packet, pkt_len, cb_tsch_sent)) {
+                radio_wait_while(&tsch_busy);
+            } else {
+                tsch_busy = false;
+            }
+            acked = tsch_acked;
+            break;
+    }
+
+    txpower_report_tx(PEER_ADDR, acked);
+    if (acked) {
+        autoack_get_ack_quality(&ack_rssi, &ack_chip_errors);
+        txpower_report_link(PEER_ADDR, ack_rssi, ack_chip_errors);
+    }
+    return acked;
+}
+
+// Count and feed the frames of the peer to the link estimator until the RF
+// timer reaches until. Over CSMA-CA, the receiver is only on meanwhile.
+void receive_frames(uint32_t until) {
+    radio_rx_slot_t* slot;
+    ieee_802_15_4_frame_t view;
+
+    if (mac_mode == MAC_MODE_CSMA) {
+        radio_setFrequency(CHANNEL, FREQ_RX);
+        radio_rx_listen();
+    }
+
+    while ((int32_t)(until - rftimer_readCounter()) > 0) {
+        while ((slot = radio_rx_peek()) != NULL) {
+            if (slot->crc_ok &&
+                ieee_802_15_4_parse(&slot->buffer[1], slot->length, &view) &&
+                view.frame_type == IEEE_802_15_4_FRAME_TYPE_DATA &&
+                view.src_addr_mode == IEEE_802_15_4_ADDR_MODE_SHORT &&
+                view.src_short_addr == PEER_ADDR) {
+                frames_received++;
+                link_estimator_report_rx(PEER_ADDR, slot->channel, slot->rssi,
+                                         slot->lqi);
+            }
+            radio_rx_release();
+        }
+    }
+
+    if (mac_mode == MAC_MODE_CSMA) {
+        radio_rx_cancel();
+    }
+}
+
+void report(void) {
+    link_estimate_t estimate;
+    lpl_energy_t energy;
+
+    printf("sent %lu, acked %lu, received %lu, TX level %u\r\n",
+           frames_sent, frames_acked, frames_received,
+           txpower_get_level(PEER_ADDR));
+    if (link_estimator_get_neighbor(PEER_ADDR, &estimate)) {
+        printf("link: RSSI %d dBm, delivery %u/256, ETX %u/256\r\n",
+               estimate.rssi >> 8, estimate.delivery, estimate.etx);
+    }
+    if (mac_mode == MAC_MODE_LPL) {
+        lpl_get_energy(&energy);
+        printf("radio on %lu ms per hour\r\n", energy.on_ms_per_hour);
+    }
+    if (mac_mode == MAC_MODE_TSCH) {
+        printf("ASN %lu\r\n", (uint32_t)tsch_get_asn());
+    }
+}
+
+void cb_tsch_sent(tsch_status_t status) {
+    tsch_acked = status == TSCH_STATUS_SENT;
+    tsch_busy = false;
+}
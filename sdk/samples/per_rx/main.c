@@ -0,0 +1,289 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "helpers.h"
+#include "ieee_802_15_4.h"
+#include "optical.h"
+#include "radio.h"
+#include "record_ring.h"
+#include "rftimer.h"
+#include "scm3c_hw_interface.h"
+
+// Packet error rate and throughput test, receiver side. Follows the rounds
+// of per_tx from channel to channel and, at the end of each round, sends a
+// binary summary of it on the UART: frames received, missing, duplicated and
+// failing the CRC, and the RSSI and chip error histograms. per_report.py
+// turns the summaries into a per-channel report.
+//
+// The receiver listens on channel 11 until it hears a first test frame. Each
+// frame gives the start of its round, its length and the number of rounds
+// per channel, so the receiver keeps in step even across rounds it hears
+// nothing of.
+
+// Idle time between two rounds of per_tx, 100 ms. A round ends in the middle
+// of the gap that follows it.
+#define ROUND_GAP_TICKS 50000
+
+// Highest number of frames per round whose duplicates are detected
+#define MAX_FRAMES_PER_ROUND 1024
+
+// Test frame header sent by per_tx
+#define TEST_MAGIC_0 'P'
+#define TEST_MAGIC_1 'E'
+#define TEST_HEADER_LEN 15
+
+// Histogram bins: RSSI in 5 dB steps from -100 dBm, chip errors in steps of
+// 4. The first and last bins also hold the values beyond them.
+#define NUM_HIST_BINS 16
+#define RSSI_HIST_MIN (-100)
+#define RSSI_HIST_STEP 5
+#define CHIP_ERRORS_HIST_STEP 4
+
+// Summaries waiting for the UART, written UART_CHUNK bytes at a time between
+// two checks of the radio RX ring so that no frame is lost while they are
+// sent
+#define SUMMARY_RING_SIZE 1024
+#define UART_CHUNK 8
+
+// UART records: sync bytes, the record body and an 8-bit sum of the body.
+// Multi-byte fields are little endian. Decoded by per_report.py.
+//
+// Round summary body: record type, record counter (2 bytes), sweep (2
+// bytes), round, channel, PHY length (0 if no frame of the round was
+// received), frames per round (2 bytes), frame interval (4 bytes, RF timer
+// ticks), then 2 bytes each for the frames received, missing, duplicated,
+// failing the CRC and dropped because the RX ring was full, the SFD
+// timestamps of the first and last frames received (4 bytes each), and the
+// RSSI and chip error histograms (2 bytes per bin).
+#define RECORD_TYPE_ROUND 0x01
+#define ROUND_RECORD_BODY_LEN (32 + 4 * NUM_HIST_BINS)
+
+typedef struct {
+    uint16_t sweep;
+    uint8_t round;
+    uint8_t channel;
+    uint8_t rounds_per_channel;
+    uint8_t pkt_len;
+    uint16_t frames;
+    uint32_t interval;
+    uint32_t end;  // RF timer count at which the round is reported
+    uint16_t received;
+    uint16_t duplicates;
+    uint16_t crc_fail;
+    uint16_t ring_drops;
+    uint32_t first_timestamp;
+    uint32_t last_timestamp;
+    uint16_t rssi_hist[NUM_HIST_BINS];
+    uint16_t chip_errors_hist[NUM_HIST_BINS];
+    uint8_t seen[MAX_FRAMES_PER_ROUND / 8];
+} round_t;
+
+void handle_frame(const radio_rx_slot_t* slot);
+void start_round(uint16_t sweep, uint8_t round, uint8_t channel);
+void end_round(void);
+void listen_on(uint8_t channel);
+void push_summary(void);
+void push_u16(uint8_t* body, uint16_t* len, uint16_t value);
+void push_u32(uint8_t* body, uint16_t* len, uint32_t value);
+
+round_t current;
+bool synced = false;
+uint32_t radio_drops = 0;
+
+uint8_t summary_buffer[SUMMARY_RING_SIZE];
+record_ring_t summary_ring;
+uint16_t record_counter = 0;
+
+int main(void) {
+    radio_rx_slot_t* slot;
+    uint32_t drops;
+
+    perform_calibration();
+    radio_init();
+    record_ring_init(&summary_ring, summary_buffer, SUMMARY_RING_SIZE);
+
+    // Tune every channel from the calibrated channel 11 code
+    radio_rxEnable();
+    radio_build_channel_table(optical_get_LC_code());
+
+    // Test frames carry no addresses
+    radio_clear_address_filter();
+    start_round(0, 0, IEEE_802_15_4_MIN_CHANNEL);
+    listen_on(IEEE_802_15_4_MIN_CHANNEL);
+
+    while (1) {
+        drops = radio_rx_drop_count();
+        current.ring_drops += drops - radio_drops;
+        radio_drops = drops;
+
+        while ((slot = radio_rx_peek()) != NULL) {
+            handle_frame(slot);
+            radio_rx_release();
+        }
+
+        if (synced && (int32_t)(rftimer_readCounter() - current.end) >= 0) {
+            end_round();
+        }
+
+        record_ring_send(&summary_ring, UART_CHUNK);
+    }
+}
+
+// Account a received frame to the current round, moving on to the round of
+// the frame first if it is another one
+void handle_frame(const radio_rx_slot_t* slot) {
+    const uint8_t* payload = &slot->buffer[1];
+    uint16_t sweep;
+    uint8_t round;
+    uint16_t seq;
+    int16_t bin;
+
+    if (!slot->crc_ok) {
+        // The header cannot be trusted, count it in the round listened to
+        current.crc_fail++;
+        return;
+    }
+    if (slot->length < TEST_HEADER_LEN + LENGTH_CRC ||
+        payload[0] != TEST_MAGIC_0 || payload[1] != TEST_MAGIC_1) {
+        return;
+    }
+
+    sweep = payload[2] | (payload[3] << 8);
+    round = payload[4];
+    if (!synced || sweep != current.sweep || round != current.round) {
+        if (synced) {
+            push_summary();
+        }
+        start_round(sweep, round, payload[5]);
+        synced = true;
+    }
+
+    seq = payload[7] | (payload[8] << 8);
+    current.rounds_per_channel = payload[6];
+    current.pkt_len = slot->length;
+    current.frames = payload[9] | (payload[10] << 8);
+    current.interval = payload[11] | (payload[12] << 8) |
+                       ((uint32_t)payload[13] << 16) |
+                       ((uint32_t)payload[14] << 24);
+    current.end = slot->timestamp +
+                  (uint32_t)(current.frames - seq) * current.interval +
+                  ROUND_GAP_TICKS / 2;
+
+    if (seq < MAX_FRAMES_PER_ROUND) {
+        if (current.seen[seq / 8] & (1 << (seq % 8))) {
+            current.duplicates++;
+            return;
+        }
+        current.seen[seq / 8] |= 1 << (seq % 8);
+    }
+
+    if (current.received == 0) {
+        current.first_timestamp = slot->timestamp;
+    }
+    current.last_timestamp = slot->timestamp;
+    current.received++;
+
+    bin = (slot->rssi - RSSI_HIST_MIN) / RSSI_HIST_STEP;
+    bin = bin < 0 ? 0 : bin >= NUM_HIST_BINS ? NUM_HIST_BINS - 1 : bin;
+    current.rssi_hist[bin]++;
+    bin = slot->LQI_chip_errors < NUM_HIST_BINS * CHIP_ERRORS_HIST_STEP
+              ? slot->LQI_chip_errors / CHIP_ERRORS_HIST_STEP
+              : NUM_HIST_BINS - 1;
+    current.chip_errors_hist[bin]++;
+}
+
+// Start counting a round, keeping its timing from the previous one until a
+// frame of it is heard
+void start_round(uint16_t sweep, uint8_t round, uint8_t channel) {
+    uint8_t rounds_per_channel = current.rounds_per_channel;
+    uint16_t frames = current.frames;
+    uint32_t interval = current.interval;
+    uint32_t end = current.end;
+
+    memset(&current, 0, sizeof(round_t));
+    current.sweep = sweep;
+    current.round = round;
+    current.channel = channel;
+    current.rounds_per_channel = rounds_per_channel;
+    current.frames = frames;
+    current.interval = interval;
+    current.end = end;
+
+    if (channel != radio_getFrequency()) {
+        listen_on(channel);
+    }
+}
+
+// Report the round that just ended and listen for the next one, expected a
+// gap after the end of this one
+void end_round(void) {
+    uint16_t sweep = current.sweep;
+    uint8_t round = current.round + 1;
+
+    push_summary();
+
+    if (round >= IEEE_802_15_4_NUM_CHANNELS * current.rounds_per_channel) {
+        // Back to the first round of the next sweep
+        round = 0;
+        sweep++;
+    }
+    current.end += (uint32_t)current.frames * current.interval +
+                   ROUND_GAP_TICKS;
+    start_round(sweep, round,
+                IEEE_802_15_4_MIN_CHANNEL + round / current.rounds_per_channel);
+}
+
+void listen_on(uint8_t channel) {
+    radio_rx_cancel();
+    // Tuned through the calibrated channel table
+    radio_setFrequency(channel, FREQ_RX);
+    radio_rx_listen();
+}
+
+// Queue the summary of the current round for the UART. The summary is lost
+// if the ring has no room for it; the record counter shows the gap.
+void push_summary(void) {
+    uint8_t body[ROUND_RECORD_BODY_LEN];
+    uint16_t missing =
+        current.received < current.frames ? current.frames - current.received
+                                           : 0;
+    uint16_t len = 0;
+    uint8_t i;
+
+    body[len++] = RECORD_TYPE_ROUND;
+    push_u16(body, &len, record_counter++);
+    push_u16(body, &len, current.sweep);
+    body[len++] = current.round;
+    body[len++] = current.channel;
+    body[len++] = current.pkt_len;
+    push_u16(body, &len, current.frames);
+    push_u32(body, &len, current.interval);
+    push_u16(body, &len, current.received);
+    push_u16(body, &len, missing);
+    push_u16(body, &len, current.duplicates);
+    push_u16(body, &len, current.crc_fail);
+    push_u16(body, &len, current.ring_drops);
+    push_u32(body, &len, current.first_timestamp);
+    push_u32(body, &len, current.last_timestamp);
+    for (i = 0; i < NUM_HIST_BINS; i++) {
+        push_u16(body, &len, current.rssi_hist[i]);
+    }
+    for (i = 0; i < NUM_HIST_BINS; i++) {
+        push_u16(body, &len, current.chip_errors_hist[i]);
+    }
+
+    record_ring_push(&summary_ring, body, len);
+}
+
+void push_u16(uint8_t* body, uint16_t* len, uint16_t value) {
+    body[(*len)++] = value & 0xFF;
+    body[(*len)++] = value >> 8;
+}
+
+void push_u32(uint8_t* body, uint16_t* len, uint32_t value) {
+    push_u16(body, len, value & 0xFFFF);
+    push_u16(body, len, value >> 16);
+}
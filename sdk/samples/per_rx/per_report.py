@@ -0,0 +1,315 @@
+#!/usr/bin/env python
+
+"""Build a per-channel packet error rate and throughput report from per_rx.
+
+per_rx sends a binary summary of each round of per_tx on the UART. This
+script collects them from the serial port, or from a recorded stream, and
+reports for each channel and frame length the frames sent and received,
+the packet error rate, the goodput and the RSSI and chip error statistics.
+
+The report is printed once the requested number of sweeps is complete, the
+recorded stream ends or the capture is interrupted with Ctrl-C.
+"""
+
+import csv
+import struct
+import sys
+from dataclasses import dataclass, field
+
+import click
+import serial
+
+SERIAL_PORT_DEFAULT = "/dev/ttyACM0"
+SERIAL_BAUDRATE_DEFAULT = 19200
+
+RECORD_SYNC = b"\xa5\x5a"
+RECORD_TYPE_ROUND = 0x01
+NUM_HIST_BINS = 16
+ROUND_RECORD_BODY_LEN = 32 + 4 * NUM_HIST_BINS
+ROUND_RECORD_FORMAT = f"<BHHBBBHIHHHHHII{NUM_HIST_BINS}H{NUM_HIST_BINS}H"
+
+RSSI_HIST_MIN = -100
+RSSI_HIST_STEP = 5
+CHIP_ERRORS_HIST_STEP = 4
+
+LENGTH_CRC = 2
+TICKS_PER_SECOND = 500000
+
+
+@dataclass
+class Round:
+    """Summary of a round of the test, as sent by per_rx."""
+
+    counter: int
+    sweep: int
+    round: int
+    channel: int
+    pkt_len: int
+    frames: int
+    interval: int
+    received: int
+    missing: int
+    duplicates: int
+    crc_fail: int
+    ring_drops: int
+    first_timestamp: int
+    last_timestamp: int
+    rssi_hist: list
+    chip_errors_hist: list
+
+    @classmethod
+    def from_body(cls, body):
+        """Decode the body of a round summary record."""
+        values = struct.unpack(ROUND_RECORD_FORMAT, body)
+        return cls(
+            *values[1:15],
+            rssi_hist=list(values[15 : 15 + NUM_HIST_BINS]),
+            chip_errors_hist=list(values[15 + NUM_HIST_BINS :]),
+        )
+
+
+@dataclass
+class Result:
+    """Results of all the rounds of a channel and frame length."""
+
+    rounds: int = 0
+    sent: int = 0
+    received: int = 0
+    duplicates: int = 0
+    crc_fail: int = 0
+    ring_drops: int = 0
+    duration: float = 0
+    rssi_hist: list = field(default_factory=lambda: [0] * NUM_HIST_BINS)
+    chip_errors_hist: list = field(
+        default_factory=lambda: [0] * NUM_HIST_BINS
+    )
+
+    def add(self, summary):
+        """Account the summary of a round."""
+        self.rounds += 1
+        self.sent += summary.frames
+        self.received += summary.received
+        self.duplicates += summary.duplicates
+        self.crc_fail += summary.crc_fail
+        self.ring_drops += summary.ring_drops
+        self.duration += summary.frames * summary.interval / TICKS_PER_SECOND
+        for i in range(NUM_HIST_BINS):
+            self.rssi_hist[i] += summary.rssi_hist[i]
+            self.chip_errors_hist[i] += summary.chip_errors_hist[i]
+
+    @property
+    def per(self):
+        """Packet error rate, in percent."""
+        if self.sent == 0:
+            return 0
+        return 100 * (self.sent - self.received) / self.sent
+
+    def goodput(self, pkt_len):
+        """Payload bits received per second of test, in kbps."""
+        if self.duration == 0:
+            return 0
+        bits = self.received * (pkt_len - LENGTH_CRC) * 8
+        return bits / self.duration / 1000
+
+    @staticmethod
+    def hist_mean(hist, first, step):
+        """Mean of a histogram, taking each bin at its center."""
+        count = sum(hist)
+        if count == 0:
+            return None
+        total = sum(n * (first + step * (i + 0.5)) for i, n in enumerate(hist))
+        return total / count
+
+    @property
+    def rssi(self):
+        """Mean RSSI of the frames received, in dBm."""
+        return self.hist_mean(self.rssi_hist, RSSI_HIST_MIN, RSSI_HIST_STEP)
+
+    @property
+    def chip_errors(self):
+        """Mean chip errors of the frames received."""
+        return self.hist_mean(self.chip_errors_hist, 0, CHIP_ERRORS_HIST_STEP)
+
+
+def read_summaries(stream):
+    """Yield the round summaries with a valid sum in stream."""
+    buffer = b""
+    record_len = 2 + ROUND_RECORD_BODY_LEN + 1
+    while True:
+        data = stream.read(256)
+        if not data:
+            if isinstance(stream, serial.Serial):
+                continue
+            return
+        buffer += data
+        while True:
+            start = buffer.find(RECORD_SYNC)
+            if start < 0:
+                buffer = buffer[-1:]
+                break
+            buffer = buffer[start:]
+            if len(buffer) < record_len:
+                break
+            body = buffer[2 : 2 + ROUND_RECORD_BODY_LEN]
+            if (
+                body[0] != RECORD_TYPE_ROUND
+                or sum(body) & 0xFF != buffer[record_len - 1]
+            ):
+                # False sync inside a record, resynchronize after it
+                buffer = buffer[1:]
+                continue
+            buffer = buffer[record_len:]
+            yield Round.from_body(body)
+
+
+def collect(stream, sweeps):
+    """Collect the round summaries until sweeps sweeps are complete."""
+    summaries = []
+    first_sweep = None
+    expected_counter = None
+    try:
+        for summary in read_summaries(stream):
+            if first_sweep is None:
+                first_sweep = summary.sweep
+            if sweeps and summary.sweep >= first_sweep + sweeps:
+                break
+            if (
+                expected_counter is not None
+                and summary.counter != expected_counter
+            ):
+                lost = (summary.counter - expected_counter) & 0xFFFF
+                print(f"{lost} summaries lost", file=sys.stderr)
+            expected_counter = (summary.counter + 1) & 0xFFFF
+
+            print(
+                f"sweep {summary.sweep} round {summary.round}: channel "
+                f"{summary.channel}, {summary.received}/{summary.frames} "
+                "frames received",
+                file=sys.stderr,
+            )
+            summaries.append(summary)
+    except KeyboardInterrupt:
+        pass
+    return summaries
+
+
+def build_results(summaries):
+    """Group the round summaries by channel and frame length."""
+    # Rounds without any frame received do not carry their length, take it
+    # from the same round of another sweep
+    lengths = {s.round: s.pkt_len for s in summaries if s.pkt_len}
+    results = {}
+    for summary in summaries:
+        pkt_len = summary.pkt_len or lengths.get(summary.round, 0)
+        key = (summary.channel, pkt_len)
+        results.setdefault(key, Result()).add(summary)
+    return results
+
+
+def format_optional(value, fmt):
+    """Format a value that may be missing."""
+    return "-" if value is None else format(value, fmt)
+
+
+def print_report(results):
+    """Print the report, one line per channel and frame length."""
+    print(
+        f"{'ch':>3} {'len':>4} {'sent':>7} {'rcvd':>7} {'dup':>5} "
+        f"{'crc':>5} {'drop':>5} {'PER %':>7} {'kbps':>7} {'RSSI':>6} "
+        f"{'chips':>6}"
+    )
+    for (channel, pkt_len), result in sorted(results.items()):
+        print(
+            f"{channel:>3} {pkt_len or '?':>4} {result.sent:>7} "
+            f"{result.received:>7} {result.duplicates:>5} "
+            f"{result.crc_fail:>5} {result.ring_drops:>5} "
+            f"{result.per:>7.2f} {result.goodput(pkt_len):>7.1f} "
+            f"{format_optional(result.rssi, '.1f'):>6} "
+            f"{format_optional(result.chip_errors, '.1f'):>6}"
+        )
+
+
+def write_csv(results, output):
+    """Write the report as CSV."""
+    writer = csv.writer(output)
+    writer.writerow(
+        [
+            "channel",
+            "pkt_len",
+            "rounds",
+            "sent",
+            "received",
+            "duplicates",
+            "crc_fail",
+            "ring_drops",
+            "per_percent",
+            "goodput_kbps",
+            "mean_rssi_dbm",
+            "mean_chip_errors",
+        ]
+    )
+    for (channel, pkt_len), result in sorted(results.items()):
+        writer.writerow(
+            [
+                channel,
+                pkt_len,
+                result.rounds,
+                result.sent,
+                result.received,
+                result.duplicates,
+                result.crc_fail,
+                result.ring_drops,
+                f"{result.per:.2f}",
+                f"{result.goodput(pkt_len):.1f}",
+                format_optional(result.rssi, ".1f"),
+                format_optional(result.chip_errors, ".1f"),
+            ]
+        )
+
+
+@click.command()
+@click.option(
+    "-p",
+    "--port",
+    default=SERIAL_PORT_DEFAULT,
+    help="Serial port the SCuM UART is connected to.",
+)
+@click.option(
+    "-b",
+    "--baudrate",
+    default=SERIAL_BAUDRATE_DEFAULT,
+    help="Serial port baudrate.",
+)
+@click.option(
+    "-f",
+    "--file",
+    "capture",
+    type=click.File("rb"),
+    help="Read a recorded stream instead of the serial port.",
+)
+@click.option(
+    "-s",
+    "--sweeps",
+    default=1,
+    help="Sweeps over all channels to collect, 0 until interrupted. The "
+    "first one is partial if per_rx started in the middle of it.",
+)
+@click.option(
+    "--csv",
+    "csv_output",
+    type=click.File("w"),
+    help="Also write the report to this CSV file.",
+)
+def main(port, baudrate, capture, sweeps, csv_output):
+    """Report the packet error rate and throughput of each channel."""
+    if capture is None:
+        capture = serial.Serial(port, baudrate, timeout=1)
+
+    results = build_results(collect(capture, sweeps))
+    print_report(results)
+    if csv_output is not None:
+        write_csv(results, csv_output)
+
+
+if __name__ == "__main__":
+    main()
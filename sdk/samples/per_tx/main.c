@@ -0,0 +1,146 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "helpers.h"
+#include "ieee_802_15_4.h"
+#include "optical.h"
+#include "radio.h"
+#include "rftimer.h"
+#include "scm3c_hw_interface.h"
+
+// Packet error rate and throughput test, transmitter side. The test runs in
+// sweeps of rounds, one round per channel and frame length, channel 11
+// first. Each round sends FRAMES_PER_ROUND sequence-numbered frames, one
+// every FRAME_INTERVAL_TICKS, followed by an idle gap for the receiver
+// (per_rx) to report the round and move to the next channel. Sweeps repeat
+// until the chip is reset.
+
+#define FRAMES_PER_ROUND 100
+
+// Interval between two frame starts, 5 ms in RF timer ticks. Stretched for
+// the frame lengths that do not fit in it.
+#define FRAME_INTERVAL_TICKS 2500
+
+// Idle time between two rounds, 100 ms. Must match per_rx.
+#define ROUND_GAP_TICKS 50000
+
+// Frames are loaded and the TX LDOs turned on this long before their start
+#define TX_SETUP_TICKS 100
+
+// Test frame header, decoded by per_rx: magic, sweep (2 bytes), round,
+// channel, rounds per channel, sequence number (2 bytes), frames per round (2
+// bytes) and frame interval (4 bytes). Multi-byte fields are little endian.
+// The rest of the frame is filled with a pattern.
+#define TEST_MAGIC_0 'P'
+#define TEST_MAGIC_1 'E'
+#define TEST_HEADER_LEN 15
+
+// PHY lengths of the frames sent on each channel, CRC included
+static const uint8_t frame_lengths[] = {20, 40, 80, 127};
+#define NUM_LENGTHS (sizeof(frame_lengths) / sizeof(frame_lengths[0]))
+#define NUM_ROUNDS (IEEE_802_15_4_NUM_CHANNELS * NUM_LENGTHS)
+
+void run_round(uint16_t sweep, uint8_t round);
+void build_packet(uint16_t sweep, uint8_t round, uint8_t pkt_len,
+                  uint16_t seq, uint32_t interval);
+uint8_t round_channel(uint8_t round);
+void cb_tx_done(radio_status_t status);
+
+uint8_t packet[MAXLENGTH_TRX_BUFFER] __attribute__((aligned(4)));
+uint32_t next_tx;
+// Set while a scheduled frame is pending, cleared by cb_tx_done()
+volatile bool tx_busy;
+
+int main(void) {
+    uint16_t sweep = 0;
+    uint8_t round;
+
+    perform_calibration();
+    radio_init();
+
+    // Tune every channel from the calibrated channel 11 code
+    radio_rxEnable();
+    radio_build_channel_table(optical_get_LC_code());
+
+    next_tx = rftimer_readCounter() + ROUND_GAP_TICKS;
+    while (1) {
+        for (round = 0; round < NUM_ROUNDS; round++) {
+            run_round(sweep, round);
+        }
+        sweep++;
+    }
+}
+
+// Send the frames of a round, each one started by the RF timer exactly one
+// interval after the previous one. A frame whose start has already passed is
+// skipped, the receiver counts it as missing.
+void run_round(uint16_t sweep, uint8_t round) {
+    uint8_t channel = round_channel(round);
+    uint8_t pkt_len = frame_lengths[round % NUM_LENGTHS];
+    uint32_t interval = FRAME_INTERVAL_TICKS;
+    uint32_t airtime = (pkt_len + IEEE_802_15_4_PHY_OVERHEAD) *
+                       IEEE_802_15_4_BYTE_TICKS;
+    uint16_t late = 0;
+    uint16_t seq;
+
+    if (interval < airtime + TX_SETUP_TICKS) {
+        interval = airtime + TX_SETUP_TICKS;
+    }
+
+    for (seq = 0; seq < FRAMES_PER_ROUND; seq++) {
+        build_packet(sweep, round, pkt_len, seq, interval);
+        while ((int32_t)(next_tx - TX_SETUP_TICKS - rftimer_readCounter()) >
+               0) {
+        }
+
+        // Tuned through the calibrated channel table
+        radio_setFrequency(channel, FREQ_TX);
+        radio_loadPacket(packet, pkt_len);
+        radio_txEnable();
+        tx_busy = true;
+        if (radio_schedule_tx_at(next_tx, cb_tx_done)) {
+            radio_wait_while(&tx_busy);
+        } else {
+            tx_busy = false;
+            radio_rfOff();
+            late++;
+        }
+        next_tx += interval;
+    }
+    next_tx += ROUND_GAP_TICKS;
+
+    printf("sweep %u round %u: channel %u, %u bytes, %u late\r\n", sweep,
+           round, channel, pkt_len, late);
+}
+
+void build_packet(uint16_t sweep, uint8_t round, uint8_t pkt_len,
+                  uint16_t seq, uint32_t interval) {
+    uint8_t i;
+
+    packet[0] = TEST_MAGIC_0;
+    packet[1] = TEST_MAGIC_1;
+    packet[2] = sweep & 0xFF;
+    packet[3] = sweep >> 8;
+    packet[4] = round;
+    packet[5] = round_channel(round);
+    packet[6] = NUM_LENGTHS;
+    packet[7] = seq & 0xFF;
+    packet[8] = seq >> 8;
+    packet[9] = FRAMES_PER_ROUND & 0xFF;
+    packet[10] = FRAMES_PER_ROUND >> 8;
+    packet[11] = interval & 0xFF;
+    packet[12] = (interval >> 8) & 0xFF;
+    packet[13] = (interval >> 16) & 0xFF;
+    packet[14] = interval >> 24;
+    for (i = TEST_HEADER_LEN; i < pkt_len - LENGTH_CRC; i++) {
+        packet[i] = (uint8_t)(seq + i);
+    }
+}
+
+uint8_t round_channel(uint8_t round) {
+    return IEEE_802_15_4_MIN_CHANNEL + round / NUM_LENGTHS;
+}
+
+void cb_tx_done(radio_status_t status) { tx_busy = false; }
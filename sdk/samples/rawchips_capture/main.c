@@ -0,0 +1,83 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "helpers.h"
+#include "optical.h"
+#include "radio.h"
+#include "rftimer.h"
+#include "scm3c_hw_interface.h"
+
+// Channel to listen on.
+#define CHANNEL 11
+
+// Number of 32-chip words per UART frame.
+#define WORDS_PER_FRAME 32
+
+// UART frame: sync bytes, frame counter (little endian), flags, word count,
+// words (little endian) and an 8-bit sum of all bytes after the sync bytes.
+// Decoded by rawchips_decode.py.
+#define FRAME_SYNC_0 0xA5
+#define FRAME_SYNC_1 0x5A
+#define FRAME_FLAG_GAP 0x01
+#define FRAME_HEADER_LEN 6
+#define FRAME_MAX_LEN (FRAME_HEADER_LEN + 4 * WORDS_PER_FRAME + 1)
+
+void send_frame(const uint32_t* words, uint8_t count, bool gap);
+
+uint32_t words[WORDS_PER_FRAME];
+uint8_t frame[FRAME_MAX_LEN];
+uint16_t frame_counter = 0;
+
+int main(void) {
+    uint16_t count;
+    bool gap;
+
+    perform_calibration();
+    radio_init();
+    radio_setFrequency(CHANNEL, FREQ_RX);
+
+    // Keep the receiver running so that the chip shift register is fed
+    radio_rx_listen();
+    radio_rawchips_start();
+
+    while (1) {
+        // Frames decoded by the receiver are not needed here
+        while (radio_rx_peek() != NULL) {
+            radio_rx_release();
+        }
+
+        count = radio_rawchips_read(words, WORDS_PER_FRAME, &gap);
+        if (count > 0 || gap) {
+            send_frame(words, count, gap);
+        }
+    }
+}
+
+void send_frame(const uint32_t* words, uint8_t count, bool gap) {
+    uint8_t len = 0;
+    uint8_t sum = 0;
+    uint8_t i;
+
+    frame[len++] = FRAME_SYNC_0;
+    frame[len++] = FRAME_SYNC_1;
+    frame[len++] = frame_counter & 0xFF;
+    frame[len++] = frame_counter >> 8;
+    frame[len++] = gap ? FRAME_FLAG_GAP : 0;
+    frame[len++] = count;
+    for (i = 0; i < count; i++) {
+        frame[len++] = words[i] & 0xFF;
+        frame[len++] = (words[i] >> 8) & 0xFF;
+        frame[len++] = (words[i] >> 16) & 0xFF;
+        frame[len++] = words[i] >> 24;
+    }
+    for (i = 2; i < len; i++) {
+        sum += frame[i];
+    }
+    frame[len++] = sum;
+
+    frame_counter++;
+    fwrite(frame, 1, len, stdout);
+    fflush(stdout);
+}
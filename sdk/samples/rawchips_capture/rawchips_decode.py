@@ -0,0 +1,273 @@
+#!/usr/bin/env python
+
+"""Decode the raw chip stream of the rawchips_capture sample.
+
+The UART frames are reassembled into a chip stream, which is correlated
+against the 16 IEEE 802.15.4 O-QPSK symbol sequences to find preambles,
+recover the frames that follow them and count chip errors per symbol.
+"""
+
+import sys
+from dataclasses import dataclass, field
+
+import click
+import serial
+
+SERIAL_PORT_DEFAULT = "/dev/ttyACM0"
+SERIAL_BAUDRATE_DEFAULT = 460800
+
+FRAME_SYNC = b"\xa5\x5a"
+FRAME_HEADER_LEN = 6
+FRAME_FLAG_GAP = 0x01
+
+CHIPS_PER_SYMBOL = 32
+
+# Chip sequences of the 16 symbols, first chip first (IEEE 802.15.4, table
+# 12-1).
+SYMBOL_CHIPS = [
+    "11011001110000110101001000101110",
+    "11101101100111000011010100100010",
+    "00101110110110011100001101010010",
+    "00100010111011011001110000110101",
+    "01010010001011101101100111000011",
+    "00110101001000101110110110011100",
+    "11000011010100100010111011011001",
+    "10011100001101010010001011101101",
+    "10001100100101100000011101111011",
+    "10111000110010010110000001110111",
+    "01111011100011001001011000000111",
+    "01110111101110001100100101100000",
+    "00000111011110111000110010010110",
+    "01100000011101111011100011001001",
+    "10010110000001110111101110001100",
+    "11001001011000000111011110111000",
+]
+SYMBOLS = [int(chips, 2) for chips in SYMBOL_CHIPS]
+SYMBOL_MASK = (1 << CHIPS_PER_SYMBOL) - 1
+
+PREAMBLE_SYMBOLS = 8
+SFD = 0xA7
+
+
+@dataclass
+class Packet:
+    """Frame recovered from the chip stream."""
+
+    chip_offset: int
+    psdu: bytes
+    chip_errors: list = field(default_factory=list)
+
+    @property
+    def crc_ok(self):
+        """Check the 802.15.4 FCS (CRC-16/KERMIT)."""
+        crc = 0
+        for byte in self.psdu[:-2]:
+            crc ^= byte
+            for _ in range(8):
+                crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+        return len(self.psdu) >= 2 and crc == int.from_bytes(
+            self.psdu[-2:], "little"
+        )
+
+
+def read_frames(stream):
+    """Yield (counter, gap, words) for every valid UART frame in stream."""
+    buffer = b""
+    while True:
+        data = stream.read(256)
+        if not data:
+            return
+        buffer += data
+        while True:
+            start = buffer.find(FRAME_SYNC)
+            if start < 0:
+                buffer = buffer[-1:]
+                break
+            buffer = buffer[start:]
+            if len(buffer) < FRAME_HEADER_LEN:
+                break
+            count = buffer[5]
+            length = FRAME_HEADER_LEN + 4 * count + 1
+            if len(buffer) < length:
+                break
+            frame = buffer[:length]
+            if sum(frame[2:-1]) & 0xFF != frame[-1]:
+                # False sync inside data, resynchronize after it
+                buffer = buffer[1:]
+                continue
+            buffer = buffer[length:]
+            words = [
+                int.from_bytes(frame[6 + 4 * i : 10 + 4 * i], "little")
+                for i in range(count)
+            ]
+            yield (
+                int.from_bytes(frame[2:4], "little"),
+                bool(frame[4] & FRAME_FLAG_GAP),
+                words,
+            )
+
+
+class ChipDecoder:
+    """Find and decode 802.15.4 frames in a chip stream."""
+
+    def __init__(self, max_errors, lsb_first, invert):
+        self.max_errors = max_errors
+        self.lsb_first = lsb_first
+        self.invert = invert
+        self.chips = []
+        self.offset = 0
+
+    def reset(self):
+        """Drop the chips collected so far, e.g. after a gap."""
+        self.offset += len(self.chips)
+        self.chips = []
+
+    def push(self, word):
+        """Append the 32 chips of a captured word."""
+        bits = range(32) if self.lsb_first else range(31, -1, -1)
+        for bit in bits:
+            chip = (word >> bit) & 1
+            self.chips.append(chip ^ 1 if self.invert else chip)
+
+    def symbol_at(self, index):
+        """Return (symbol, chip errors) of the closest match at index."""
+        value = 0
+        for chip in self.chips[index : index + CHIPS_PER_SYMBOL]:
+            value = (value << 1) | chip
+        errors = [bin(value ^ chips).count("1") for chips in SYMBOLS]
+        symbol = min(range(16), key=errors.__getitem__)
+        return symbol, errors[symbol]
+
+    def decode(self):
+        """Yield the packets found in the chips collected so far."""
+        index = 0
+        while index + CHIPS_PER_SYMBOL * (PREAMBLE_SYMBOLS + 4) <= len(
+            self.chips
+        ):
+            packet, consumed = self.try_packet(index)
+            if packet is None:
+                if consumed == 0:
+                    index += 1
+                    continue
+                # Truncated packet, wait for more chips
+                break
+            yield packet
+            index += consumed
+        self.offset += index
+        self.chips = self.chips[index:]
+
+    def try_packet(self, index):
+        """Decode a packet starting with a preamble at index.
+
+        Return (packet, chips consumed), (None, 0) if there is no packet here,
+        or (None, -1) if the packet runs past the collected chips.
+        """
+        errors = []
+        position = index
+        for _ in range(PREAMBLE_SYMBOLS):
+            symbol, symbol_errors = self.symbol_at(position)
+            if symbol != 0 or symbol_errors > self.max_errors:
+                return None, 0
+            errors.append(symbol_errors)
+            position += CHIPS_PER_SYMBOL
+
+        symbols = []
+        while True:
+            if position + 2 * CHIPS_PER_SYMBOL > len(self.chips):
+                return None, -1
+            symbol, symbol_errors = self.symbol_at(position)
+            if symbol != 0:
+                break
+            # Longer preamble than expected
+            errors.append(symbol_errors)
+            position += CHIPS_PER_SYMBOL
+
+        # SFD and PHY header, then the PSDU, low nibble first
+        for _ in range(4):
+            if position + CHIPS_PER_SYMBOL > len(self.chips):
+                return None, -1
+            symbol, symbol_errors = self.symbol_at(position)
+            symbols.append(symbol)
+            errors.append(symbol_errors)
+            position += CHIPS_PER_SYMBOL
+        if symbols[0] | (symbols[1] << 4) != SFD:
+            return None, 0
+        length = (symbols[2] | (symbols[3] << 4)) & 0x7F
+
+        psdu = bytearray()
+        for _ in range(length):
+            if position + 2 * CHIPS_PER_SYMBOL > len(self.chips):
+                return None, -1
+            low, low_errors = self.symbol_at(position)
+            high, high_errors = self.symbol_at(position + CHIPS_PER_SYMBOL)
+            psdu.append(low | (high << 4))
+            errors += [low_errors, high_errors]
+            position += 2 * CHIPS_PER_SYMBOL
+
+        return (
+            Packet(self.offset + index, bytes(psdu), errors),
+            position - index,
+        )
+
+
+@click.command()
+@click.option(
+    "-p",
+    "--port",
+    default=SERIAL_PORT_DEFAULT,
+    help="Serial port the SCuM UART is connected to.",
+)
+@click.option(
+    "-b",
+    "--baudrate",
+    default=SERIAL_BAUDRATE_DEFAULT,
+    help="Serial port baudrate.",
+)
+@click.option(
+    "-f",
+    "--file",
+    "capture",
+    type=click.File("rb"),
+    help="Decode a recorded capture instead of the serial port.",
+)
+@click.option(
+    "-e",
+    "--max-errors",
+    default=8,
+    help="Maximum chip errors per preamble symbol.",
+)
+@click.option(
+    "--lsb-first",
+    is_flag=True,
+    help="The first chip of a word is its least significant bit.",
+)
+@click.option("--invert", is_flag=True, help="Invert every chip.")
+def main(port, baudrate, capture, max_errors, lsb_first, invert):
+    """Decode 802.15.4 frames from the raw chip stream of a SCuM."""
+    stream = capture or serial.Serial(port, baudrate, timeout=1)
+    decoder = ChipDecoder(max_errors, lsb_first, invert)
+    expected_counter = None
+    gaps = 0
+
+    for counter, gap, words in read_frames(stream):
+        if gap or (expected_counter is not None and counter != expected_counter):
+            gaps += 1
+            decoder.reset()
+        expected_counter = (counter + 1) & 0xFFFF
+
+        for word in words:
+            decoder.push(word)
+        for packet in decoder.decode():
+            errors = packet.chip_errors
+            print(
+                f"chip {packet.chip_offset}: len={len(packet.psdu)} "
+                f"crc={'ok' if packet.crc_ok else 'FAIL'} "
+                f"chip_errors={sum(errors)} "
+                f"({sum(errors) / len(errors):.2f}/symbol, max {max(errors)}) "
+                f"gaps={gaps} {packet.psdu.hex()}"
+            )
+            sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,200 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "helpers.h"
+#include "optical.h"
+#include "radio.h"
+#include "record_ring.h"
+#include "rftimer.h"
+#include "scm3c_hw_interface.h"
+#include "uart.h"
+
+// Channel to listen on until the host selects another one by sending
+// "C<channel>\n", e.g. "C15\n".
+#define DEFAULT_CHANNEL 11
+
+// Bytes of each frame forwarded to the host, at most the 127-byte PSDU.
+// Lowering it shortens the records when the UART cannot keep up.
+#define SNAPLEN 127
+
+// Records waiting for the UART. Frames are taken out of the small radio RX
+// ring straight away and buffered here while the UART drains the previous
+// ones; a frame that does not fit is dropped and counted.
+#define RECORD_RING_SIZE 8192
+
+// Bytes written to the UART between two checks of the radio RX ring, so that
+// the ring is drained well before it fills up
+#define UART_CHUNK 8
+
+// Interval between two status records, 1 s in RF timer ticks
+#define STATUS_PERIOD_TICKS 500000
+
+// UART records: sync bytes, record type, record counter (little endian), the
+// fields of the record type and an 8-bit sum of all bytes after the sync
+// bytes. Multi-byte fields are little endian. Decoded by sniffer_pcapng.py.
+//
+// Frame record: SFD timestamp (4 bytes, RF timer ticks at 500 kHz), channel,
+// RSSI (dBm, signed), chip errors, flags, frames dropped right before this
+// one (2 bytes, saturated), PSDU length, captured length and the captured
+// PSDU bytes, FCS included.
+//
+// Status record: channel, total frames dropped (4 bytes).
+#define RECORD_TYPE_FRAME 0x01
+#define RECORD_TYPE_STATUS 0x02
+#define RECORD_FLAG_CRC_OK 0x01
+#define FRAME_RECORD_BODY_LEN 15  // without the captured bytes
+
+void capture_frames(void);
+void push_frame_record(const radio_rx_slot_t* slot);
+void push_status_record(void);
+bool push_record(const uint8_t* record, uint16_t len);
+void cb_uart_rx(char data);
+
+uint8_t record_buffer[RECORD_RING_SIZE];
+record_ring_t record_ring;
+uint8_t record[FRAME_RECORD_BODY_LEN + SNAPLEN];
+uint16_t record_counter = 0;
+
+uint8_t channel = DEFAULT_CHANNEL;
+uint32_t radio_drops = 0;
+uint32_t pending_drops = 0;  // not reported in a frame record yet
+uint32_t total_drops = 0;
+
+// Channel selection received from the host
+volatile uint8_t requested_channel = 0;
+uint8_t command_channel = 0;
+bool command_started = false;
+
+int main(void) {
+    uint32_t last_status;
+
+    perform_calibration();
+    radio_init();
+    record_ring_init(&record_ring, record_buffer, RECORD_RING_SIZE);
+
+    uart_set_rx_callback(cb_uart_rx);
+    uart_enable_interrupt();
+
+    // Promiscuous: every frame is captured and none is acknowledged
+    radio_clear_address_filter();
+    radio_setFrequency(channel, FREQ_RX);
+    radio_rx_listen();
+
+    last_status = rftimer_readCounter();
+    while (1) {
+        if (requested_channel != 0) {
+            radio_rx_cancel();
+            channel = requested_channel;
+            requested_channel = 0;
+            radio_setFrequency(channel, FREQ_RX);
+            radio_rx_listen();
+            push_status_record();
+        }
+
+        capture_frames();
+
+        if (rftimer_readCounter() - last_status >= STATUS_PERIOD_TICKS) {
+            last_status = rftimer_readCounter();
+            push_status_record();
+        }
+
+        record_ring_send(&record_ring, UART_CHUNK);
+    }
+}
+
+// Move every frame received into the record ring
+void capture_frames(void) {
+    radio_rx_slot_t* slot;
+    uint32_t drops;
+
+    // Frames lost in the radio RX ring itself
+    drops = radio_rx_drop_count();
+    if (drops != radio_drops) {
+        pending_drops += drops - radio_drops;
+        total_drops += drops - radio_drops;
+        radio_drops = drops;
+    }
+
+    while ((slot = radio_rx_peek()) != NULL) {
+        push_frame_record(slot);
+        radio_rx_release();
+    }
+}
+
+void push_frame_record(const radio_rx_slot_t* slot) {
+    uint8_t psdu_len = slot->length;
+    uint8_t cap_len = psdu_len < SNAPLEN ? psdu_len : SNAPLEN;
+    uint16_t drops = pending_drops < 0xFFFF ? pending_drops : 0xFFFF;
+    uint16_t len = 0;
+
+    record[len++] = RECORD_TYPE_FRAME;
+    record[len++] = record_counter & 0xFF;
+    record[len++] = record_counter >> 8;
+    record[len++] = slot->timestamp & 0xFF;
+    record[len++] = (slot->timestamp >> 8) & 0xFF;
+    record[len++] = (slot->timestamp >> 16) & 0xFF;
+    record[len++] = slot->timestamp >> 24;
+    record[len++] = slot->channel;
+    record[len++] = (uint8_t)slot->rssi;
+    record[len++] = slot->LQI_chip_errors & 0xFF;
+    record[len++] = slot->crc_ok ? RECORD_FLAG_CRC_OK : 0;
+    record[len++] = drops & 0xFF;
+    record[len++] = drops >> 8;
+    record[len++] = psdu_len;
+    record[len++] = cap_len;
+    memcpy(&record[len], &slot->buffer[1], cap_len);
+    len += cap_len;
+
+    if (push_record(record, len)) {
+        pending_drops = 0;
+    } else {
+        pending_drops++;
+        total_drops++;
+    }
+}
+
+void push_status_record(void) {
+    uint16_t len = 0;
+
+    record[len++] = RECORD_TYPE_STATUS;
+    record[len++] = record_counter & 0xFF;
+    record[len++] = record_counter >> 8;
+    record[len++] = channel;
+    record[len++] = total_drops & 0xFF;
+    record[len++] = (total_drops >> 8) & 0xFF;
+    record[len++] = (total_drops >> 16) & 0xFF;
+    record[len++] = total_drops >> 24;
+
+    push_record(record, len);
+}
+
+// Queue a record for the UART and count it. Returns false if the ring has no
+// room for it.
+bool push_record(const uint8_t* body, uint16_t body_len) {
+    if (!record_ring_push(&record_ring, body, body_len)) {
+        return false;
+    }
+    record_counter++;
+    return true;
+}
+
+// Parse "C<channel>\n" commands from the host
+void cb_uart_rx(char data) {
+    if (data == 'C') {
+        command_started = true;
+        command_channel = 0;
+    } else if (command_started && data >= '0' && data <= '9') {
+        command_channel = command_channel * 10 + (data - '0');
+    } else if (command_started && data == '\n') {
+        command_started = false;
+        if (command_channel >= IEEE_802_15_4_MIN_CHANNEL &&
+            command_channel <= IEEE_802_15_4_MAX_CHANNEL) {
+            requested_channel = command_channel;
+        }
+    } else {
+        command_started = false;
+    }
+}
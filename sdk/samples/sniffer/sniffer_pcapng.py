@@ -0,0 +1,304 @@
+#!/usr/bin/env python
+
+"""Convert the record stream of the sniffer sample into pcapng.
+
+Frames are written with the IEEE 802.15.4 TAP link type (283), carrying
+the channel, RSSI and LQI of each frame, so that the capture can be opened
+in Wireshark or piped into it live:
+
+    sniffer_pcapng.py -c 15 | wireshark -k -i -
+
+Frames dropped by the mote, or records lost on the serial link, are
+reported on stderr and recorded in the drop count of the next packet.
+"""
+
+import struct
+import sys
+import time
+from dataclasses import dataclass
+
+import click
+import serial
+
+SERIAL_PORT_DEFAULT = "/dev/ttyACM0"
+SERIAL_BAUDRATE_DEFAULT = 19200
+
+RECORD_SYNC = b"\xa5\x5a"
+RECORD_TYPE_FRAME = 0x01
+RECORD_TYPE_STATUS = 0x02
+RECORD_FLAG_CRC_OK = 0x01
+FRAME_RECORD_BODY_LEN = 15
+STATUS_RECORD_BODY_LEN = 8
+
+TICKS_PER_SECOND = 500000
+
+LINKTYPE_IEEE802_15_4_TAP = 283
+
+TAP_FCS_TYPE = 0
+TAP_RSS = 1
+TAP_CHANNEL_ASSIGNMENT = 3
+TAP_LQI = 10
+TAP_FCS_16_BIT = 1
+
+PCAPNG_SHB = 0x0A0D0D0A
+PCAPNG_IDB = 0x00000001
+PCAPNG_EPB = 0x00000006
+PCAPNG_BYTE_ORDER_MAGIC = 0x1A2B3C4D
+PCAPNG_EPB_DROPCOUNT = 4
+
+
+@dataclass
+class Frame:
+    """Frame record of the sniffer stream."""
+
+    counter: int
+    timestamp: int
+    channel: int
+    rssi: int
+    chip_errors: int
+    crc_ok: bool
+    drops: int
+    length: int
+    psdu: bytes
+
+
+@dataclass
+class Status:
+    """Status record of the sniffer stream."""
+
+    counter: int
+    channel: int
+    total_drops: int
+
+
+def read_records(stream):
+    """Yield the frame and status records with a valid sum in stream."""
+    buffer = b""
+    while True:
+        data = stream.read(256)
+        if not data:
+            if isinstance(stream, serial.Serial):
+                continue
+            return
+        buffer += data
+        while True:
+            start = buffer.find(RECORD_SYNC)
+            if start < 0:
+                buffer = buffer[-1:]
+                break
+            buffer = buffer[start:]
+            if len(buffer) < 3:
+                break
+            record_type = buffer[2]
+            if record_type == RECORD_TYPE_FRAME:
+                if len(buffer) < 2 + FRAME_RECORD_BODY_LEN:
+                    break
+                body_len = FRAME_RECORD_BODY_LEN + buffer[2 + 14]
+            elif record_type == RECORD_TYPE_STATUS:
+                body_len = STATUS_RECORD_BODY_LEN
+            else:
+                buffer = buffer[1:]
+                continue
+            if len(buffer) < 2 + body_len + 1:
+                break
+            body = buffer[2 : 2 + body_len]
+            if sum(body) & 0xFF != buffer[2 + body_len]:
+                # False sync inside a record, resynchronize after it
+                buffer = buffer[1:]
+                continue
+            buffer = buffer[2 + body_len + 1 :]
+            yield parse_record(body)
+
+
+def parse_record(body):
+    """Decode the body of a record, its sync bytes and sum removed."""
+    counter = int.from_bytes(body[1:3], "little")
+    if body[0] == RECORD_TYPE_STATUS:
+        return Status(counter, body[3], int.from_bytes(body[4:8], "little"))
+    return Frame(
+        counter=counter,
+        timestamp=int.from_bytes(body[3:7], "little"),
+        channel=body[7],
+        rssi=struct.unpack("b", body[8:9])[0],
+        chip_errors=body[9],
+        crc_ok=bool(body[10] & RECORD_FLAG_CRC_OK),
+        drops=int.from_bytes(body[11:13], "little"),
+        length=body[13],
+        psdu=bytes(body[15:]),
+    )
+
+
+def pcapng_block(block_type, body):
+    """Frame a pcapng block body, padding it to 32 bits."""
+    body += b"\x00" * (-len(body) % 4)
+    length = 12 + len(body)
+    return (
+        struct.pack("<II", block_type, length)
+        + body
+        + struct.pack("<I", length)
+    )
+
+
+def tap_tlv(tlv_type, value):
+    """Encode a TAP TLV, padding its value to 32 bits."""
+    return (
+        struct.pack("<HH", tlv_type, len(value))
+        + value
+        + b"\x00" * (-len(value) % 4)
+    )
+
+
+def tap_header(frame):
+    """Build the IEEE 802.15.4 TAP header of a frame."""
+    # The mote reports chip errors, LQI is higher for better links
+    lqi = max(0, 255 - frame.chip_errors)
+    tlvs = (
+        tap_tlv(TAP_FCS_TYPE, bytes([TAP_FCS_16_BIT]))
+        + tap_tlv(TAP_RSS, struct.pack("<f", frame.rssi))
+        + tap_tlv(TAP_CHANNEL_ASSIGNMENT, struct.pack("<HB", frame.channel, 0))
+        + tap_tlv(TAP_LQI, bytes([lqi]))
+    )
+    return struct.pack("<BBH", 0, 0, 4 + len(tlvs)) + tlvs
+
+
+class PcapngWriter:
+    """Write frames as pcapng enhanced packet blocks."""
+
+    def __init__(self, output):
+        self.output = output
+        self.output.write(
+            pcapng_block(
+                PCAPNG_SHB,
+                struct.pack("<IHHq", PCAPNG_BYTE_ORDER_MAGIC, 1, 0, -1),
+            )
+        )
+        self.output.write(
+            pcapng_block(
+                PCAPNG_IDB, struct.pack("<HHI", LINKTYPE_IEEE802_15_4_TAP, 0, 0)
+            )
+        )
+        self.output.flush()
+
+    def write(self, timestamp_us, frame, drops):
+        """Write a frame captured at timestamp_us (microseconds)."""
+        header = tap_header(frame)
+        data = header + frame.psdu
+        options = b""
+        if drops:
+            options += struct.pack("<HHQ", PCAPNG_EPB_DROPCOUNT, 8, drops)
+        if options:
+            options += struct.pack("<HH", 0, 0)
+        body = struct.pack(
+            "<IIIII",
+            0,
+            timestamp_us >> 32,
+            timestamp_us & 0xFFFFFFFF,
+            len(data),
+            len(header) + frame.length,
+        )
+        body += data + b"\x00" * (-len(data) % 4) + options
+        self.output.write(pcapng_block(PCAPNG_EPB, body))
+        self.output.flush()
+
+
+class Timestamps:
+    """Turn the 32-bit RF timer timestamps into host time."""
+
+    def __init__(self):
+        self.start_us = None
+        self.first = 0
+        self.last = 0
+        self.wraps = 0
+
+    def convert(self, ticks):
+        """Return the host time of an RF timer count, in microseconds."""
+        if self.start_us is None:
+            self.start_us = int(time.time() * 1e6)
+            self.first = self.last = ticks
+        if ticks < self.last:
+            self.wraps += 1
+        self.last = ticks
+        elapsed = (self.wraps << 32) + ticks - self.first
+        return self.start_us + elapsed * 1000000 // TICKS_PER_SECOND
+
+
+@click.command()
+@click.option(
+    "-p",
+    "--port",
+    default=SERIAL_PORT_DEFAULT,
+    help="Serial port the SCuM UART is connected to.",
+)
+@click.option(
+    "-b",
+    "--baudrate",
+    default=SERIAL_BAUDRATE_DEFAULT,
+    help="Serial port baudrate.",
+)
+@click.option(
+    "-c",
+    "--channel",
+    type=click.IntRange(11, 26),
+    help="802.15.4 channel to sniff.",
+)
+@click.option(
+    "-f",
+    "--file",
+    "capture",
+    type=click.File("rb"),
+    help="Convert a recorded stream instead of the serial port.",
+)
+@click.option(
+    "-o",
+    "--output",
+    type=click.File("wb"),
+    default="-",
+    help="pcapng file to write, stdout by default.",
+)
+def main(port, baudrate, channel, capture, output):
+    """Capture 802.15.4 frames from the SCuM sniffer into pcapng."""
+    if capture is None:
+        capture = serial.Serial(port, baudrate, timeout=1)
+        if channel is not None:
+            capture.write(f"C{channel}\n".encode())
+
+    writer = PcapngWriter(output)
+    timestamps = Timestamps()
+    expected_counter = None
+    mote_drops = 0
+    lost_records = 0
+
+    for record in read_records(capture):
+        lost = 0
+        if expected_counter is not None and record.counter != expected_counter:
+            lost = (record.counter - expected_counter) & 0xFFFF
+            lost_records += lost
+            print(
+                f"{lost} records lost on the serial link "
+                f"({lost_records} in total)",
+                file=sys.stderr,
+            )
+        expected_counter = (record.counter + 1) & 0xFFFF
+
+        if isinstance(record, Status):
+            if record.total_drops != mote_drops:
+                print(
+                    f"channel {record.channel}: {record.total_drops} frames "
+                    "dropped by the mote in total",
+                    file=sys.stderr,
+                )
+                mote_drops = record.total_drops
+            continue
+
+        if record.drops:
+            print(
+                f"{record.drops} frames dropped by the mote before this one",
+                file=sys.stderr,
+            )
+        writer.write(
+            timestamps.convert(record.timestamp), record, record.drops + lost
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,127 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "helpers.h"
+#include "ieee_802_15_4.h"
+#include "optical.h"
+#include "radio.h"
+#include "rftimer.h"
+#include "scm3c_hw_interface.h"
+
+// Transmit rate of a TX burst against one send_packet() call per frame. For
+// each frame length, BATCH_FRAMES frames are sent both ways on CHANNEL and
+// the radio measures, from its own capture timestamps, the gap between the
+// end of a frame and the SFD of the next one. The frame rate follows from the
+// gap and the air time of the frame after its SFD. The duration of the burst,
+// from its first SFD to its last frame end, is also given. The results are
+// printed on the UART next to the air limit, where only the preamble and SFD
+// of the next frame separate two frames. The test repeats every second.
+
+#define CHANNEL 11
+#define BATCH_FRAMES 32
+
+// Pause before each batch, longer than the gaps counted by the radio, so
+// that the last frame of a batch and the first of the next are not counted
+// as back-to-back
+#define BATCH_GAP_TICKS 50000
+
+#define TEST_PERIOD_TICKS 500000
+
+// RF timer frequency
+#define RFTIMER_HZ 500000
+#define RFTIMER_TICK_US 2
+
+// PHY lengths of the frames, CRC included
+static const uint8_t frame_lengths[] = {20, 60, 127};
+#define NUM_LENGTHS (sizeof(frame_lengths) / sizeof(frame_lengths[0]))
+
+void run_length(uint8_t pkt_len);
+void wait_ticks(uint32_t ticks);
+uint32_t frame_rate(uint32_t gap_ticks, uint8_t pkt_len);
+
+uint8_t packets[BATCH_FRAMES][MAXLENGTH_TRX_BUFFER] __attribute__((aligned(4)));
+radio_burst_frame_t burst[BATCH_FRAMES];
+
+int main(void) {
+    uint8_t i;
+    uint8_t j;
+
+    perform_calibration();
+    radio_init();
+
+    // Tune every channel from the calibrated channel 11 code
+    radio_rxEnable();
+    radio_build_channel_table(optical_get_LC_code());
+    radio_rfOff();
+
+    for (i = 0; i < BATCH_FRAMES; i++) {
+        for (j = 0; j < MAXLENGTH_TRX_BUFFER; j++) {
+            packets[i][j] = i + j;
+        }
+        burst[i].packet = packets[i];
+    }
+
+    while (1) {
+        for (i = 0; i < NUM_LENGTHS; i++) {
+            run_length(frame_lengths[i]);
+        }
+        wait_ticks(TEST_PERIOD_TICKS);
+    }
+}
+
+// Send BATCH_FRAMES frames of pkt_len bytes with send_packet(), then as one
+// burst, and print the frame rate and mean gap of each
+void run_length(uint8_t pkt_len) {
+    radio_stats_t stats;
+    uint32_t single_gap;
+    uint32_t burst_gap;
+    uint8_t i;
+
+    wait_ticks(BATCH_GAP_TICKS);
+    radio_reset_stats();
+    for (i = 0; i < BATCH_FRAMES; i++) {
+        radio_setFrequency(CHANNEL, FREQ_TX);
+        send_packet(packets[i], pkt_len);
+    }
+    radio_get_stats(&stats);
+    single_gap = stats.tx_gaps > 0 ? stats.tx_gap_ticks / stats.tx_gaps : 0;
+
+    for (i = 0; i < BATCH_FRAMES; i++) {
+        burst[i].pkt_len = pkt_len;
+    }
+    wait_ticks(BATCH_GAP_TICKS);
+    radio_reset_stats();
+    radio_setFrequency(CHANNEL, FREQ_TX);
+    radio_tx_burst(burst, BATCH_FRAMES);
+    radio_get_stats(&stats);
+    burst_gap = stats.tx_gaps > 0 ? stats.tx_gap_ticks / stats.tx_gaps : 0;
+
+    printf("%u bytes, air limit %lu frames/s\r\n", pkt_len,
+           frame_rate((IEEE_802_15_4_PHY_OVERHEAD - 1) *
+                          IEEE_802_15_4_BYTE_TICKS,
+                      pkt_len));
+    printf("  send_packet: %lu frames/s, gap %lu us\r\n",
+           frame_rate(single_gap, pkt_len), single_gap * RFTIMER_TICK_US);
+    printf("  burst: %lu frames/s, gap %lu us, %lu frames in %lu us\r\n",
+           frame_rate(burst_gap, pkt_len), burst_gap * RFTIMER_TICK_US,
+           stats.burst_frames, stats.burst_ticks * RFTIMER_TICK_US);
+}
+
+void wait_ticks(uint32_t ticks) {
+    uint32_t start = rftimer_readCounter();
+
+    while (rftimer_readCounter() - start < ticks) {
+    }
+}
+
+// Frames per second when frames of pkt_len bytes are gap_ticks apart. The
+// gap runs from the end of a frame to the SFD of the next one, so each frame
+// also takes its PHY header and pkt_len bytes.
+uint32_t frame_rate(uint32_t gap_ticks, uint8_t pkt_len) {
+    if (gap_ticks == 0) {
+        return 0;
+    }
+    return RFTIMER_HZ / (gap_ticks + (pkt_len + 1) * IEEE_802_15_4_BYTE_TICKS);
+}
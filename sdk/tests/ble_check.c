@@ -0,0 +1,125 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ble.h"
+#include "check.h"
+
+// Host check of the table-driven BLE kernels against bit-serial models of
+// the LFSRs of the specification (Vol 6, Part B, 3.1.1 and 3.2), run over
+// every channel and every length up to the longest advertising PDU.
+
+// Advertising channel PDU, header and CRC included
+#define MAX_LENGTH (2 + 37 + 3)
+
+// CRC initial value of the advertising channels
+#define CRC_INIT_ADV 0x555555
+
+// CRC LFSR: position 23 is the most significant bit and is sent first; data
+// bits are shifted in least significant bit first. Returns the CRC with the
+// first bit sent in bit 0, as ble_crc24() does.
+static uint32_t crc24_reference(const uint8_t* data, uint8_t len,
+                                uint32_t init) {
+    uint32_t state = init & 0xFFFFFF;
+    uint32_t crc = 0;
+    uint8_t feedback;
+    uint8_t i;
+    uint8_t j;
+
+    for (i = 0; i < len; i++) {
+        for (j = 0; j < 8; j++) {
+            feedback = ((state >> 23) ^ (data[i] >> j)) & 1;
+            state = (state << 1) & 0xFFFFFF;
+            if (feedback) {
+                // x^10 + x^9 + x^6 + x^4 + x^3 + x + 1
+                state ^= 0x00065B;
+            }
+        }
+    }
+
+    for (i = 0; i < 24; i++) {
+        crc |= ((state >> (23 - i)) & 1) << i;
+    }
+    return crc;
+}
+
+// Whitening LFSR x^7 + x^4 + 1: position 0 is set and positions 1 to 6 hold
+// the channel index, most significant bit first. Position 6 whitens the next
+// data bit, least significant bit first, and feeds back into positions 0 and
+// 4.
+static void whiten_reference(uint8_t* data, uint8_t len, uint8_t channel) {
+    uint8_t position[7];
+    uint8_t out;
+    uint8_t i;
+    uint8_t j;
+    int8_t k;
+
+    position[0] = 1;
+    for (k = 1; k < 7; k++) {
+        position[k] = (channel >> (6 - k)) & 1;
+    }
+
+    for (i = 0; i < len; i++) {
+        for (j = 0; j < 8; j++) {
+            out = position[6];
+            data[i] ^= out << j;
+            for (k = 6; k > 0; k--) {
+                position[k] = position[k - 1];
+            }
+            position[0] = out;
+            position[4] ^= out;
+        }
+    }
+}
+
+static void check_crc24(const uint8_t* data) {
+    static const uint32_t inits[] = {CRC_INIT_ADV, 0x000000, 0xFFFFFF,
+                                     0x123456};
+    uint8_t i;
+    uint8_t len;
+
+    for (i = 0; i < sizeof(inits) / sizeof(inits[0]); i++) {
+        for (len = 0; len <= MAX_LENGTH; len++) {
+            CHECK(ble_crc24(data, len, inits[i]) ==
+                  crc24_reference(data, len, inits[i]));
+        }
+    }
+}
+
+static void check_whiten(const uint8_t* data) {
+    uint8_t table[MAX_LENGTH];
+    uint8_t reference[MAX_LENGTH];
+    uint8_t channel;
+    uint8_t len;
+
+    for (channel = 0; channel < 40; channel++) {
+        for (len = 0; len <= MAX_LENGTH; len++) {
+            memcpy(table, data, len);
+            memcpy(reference, data, len);
+            ble_whiten(table, len, channel);
+            whiten_reference(reference, len, channel);
+            CHECK(memcmp(table, reference, len) == 0);
+
+            // Whitening twice gives the data back
+            ble_whiten(table, len, channel);
+            CHECK(memcmp(table, data, len) == 0);
+        }
+    }
+}
+
+int main(void) {
+    uint8_t data[MAX_LENGTH];
+    uint8_t i;
+
+    for (i = 0; i < MAX_LENGTH; i++) {
+        data[i] = i * 37 + 5;
+    }
+
+    ble_init();
+    check_crc24(data);
+    check_whiten(data);
+
+    printf("ble: %u failures\n", failures);
+    return failures != 0;
+}
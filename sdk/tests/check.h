@@ -0,0 +1,19 @@
+// Assertion shared by the host checks: a failed CHECK() prints its location
+// and is counted, and the check returns nonzero if any failed.
+
+#ifndef __CHECK_H
+#define __CHECK_H
+
+#include <stdio.h>
+
+#define CHECK(cond)                                                  \
+    do {                                                             \
+        if (!(cond)) {                                               \
+            printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+            failures++;                                              \
+        }                                                            \
+    } while (0)
+
+static unsigned int failures = 0;
+
+#endif
@@ -0,0 +1,308 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "ieee_802_15_4.h"
+#include "radio.h"
+#include "rftimer.h"
+
+// The check swaps the state of the single CSMA-CA instance between the
+// simulated nodes, so it builds the module itself.
+#include "csma.c"
+
+// Host simulation of N nodes sharing a channel, all in range of each other,
+// comparing the throughput of unslotted CSMA-CA with blind transmission
+// (pure ALOHA) at the same offered load. Each node runs the backoff and CCA
+// logic of csma.c against a channel model: a CCA is busy if a frame was on
+// the air at any time during its window, and a frame is lost if any other
+// frame overlaps it. Time is in RF timer ticks.
+
+#define MAX_NODES 10
+
+// Frame length, including the CRC
+#define PKT_LEN 100
+#define AIRTIME_TICKS \
+    ((IEEE_802_15_4_PHY_OVERHEAD + PKT_LEN) * IEEE_802_15_4_BYTE_TICKS)
+
+// 60 s per run
+#define SIM_TICKS 30000000
+
+typedef enum {
+    EVENT_NONE = 0x00,
+    EVENT_FRAME = 0x01,  // a new frame is ready to be sent
+    EVENT_TIMER = 0x02,
+    EVENT_CCA_END = 0x03,
+    EVENT_TX_START = 0x04,
+    EVENT_TX_END = 0x05,
+} event_t;
+
+typedef struct {
+    csma_vars_t csma;
+    rftimer_cbt timer_cb;
+    radio_done_cbt radio_cb;
+
+    event_t event;
+    uint32_t event_at;
+    uint32_t cca_start;
+    uint32_t tx_start;  // last frame put on the air
+    uint32_t tx_end;
+    bool transmitting;
+    bool collided;
+
+    uint32_t frames;  // frames sent to the end
+    uint32_t delivered;
+    uint32_t access_failures;
+} node_t;
+
+typedef struct {
+    uint32_t delivered;
+    uint32_t frames;
+    uint32_t access_failures;
+    uint32_t throughput;  // channel time carrying delivered frames, per mille
+} result_t;
+
+static node_t nodes[MAX_NODES];
+static uint8_t num_nodes;
+static node_t* current;
+static uint32_t now;
+static bool blind;
+static uint32_t mean_idle_ticks;
+static uint32_t idle_prng_state = 1;
+
+static uint8_t packet[PKT_LEN];
+
+//===== stand-ins of the drivers csma.c runs on, for the current node
+
+uint32_t rftimer_readCounter(void) { return now; }
+
+void rftimer_set_callback_by_id(rftimer_cbt cb, uint8_t id) {
+    current->timer_cb = cb;
+}
+
+void rftimer_setCompareIn_by_id(uint32_t val, uint8_t id) {
+    current->event = EVENT_TIMER;
+    current->event_at = val;
+}
+
+void rftimer_disable_interrupts_by_id(uint8_t id) {}
+
+bool radio_busy(void) { return false; }
+
+void radio_wait_while(volatile bool* flag) {}
+
+bool radio_setFrequency(uint8_t channel, radio_freq_t tx_or_rx) {
+    return true;
+}
+
+uint8_t radio_getFrequency(void) { return IEEE_802_15_4_MIN_CHANNEL; }
+
+void radio_loadPacket(void* packet, uint16_t len) {}
+
+void radio_txEnable(void) {}
+
+bool radio_cca_async(uint32_t duration, int8_t threshold,
+                     radio_done_cbt cb) {
+    current->radio_cb = cb;
+    current->cca_start = now;
+    current->event = EVENT_CCA_END;
+    current->event_at = now + duration;
+    return true;
+}
+
+bool radio_schedule_tx_at(uint32_t ticks, radio_done_cbt cb) {
+    current->radio_cb = cb;
+    current->event = EVENT_TX_START;
+    current->event_at = ticks;
+    return true;
+}
+
+// The simulated frames do not request an ACK
+bool autoack_tx_at(void* packet, uint8_t pkt_len, uint32_t ticks,
+                   autoack_done_cbt cb) {
+    return false;
+}
+
+//===== simulation
+
+// Idle time before the next frame of a node, uniform in
+// [0, 2 * mean_idle_ticks], from a xorshift32 shared by the nodes
+static uint32_t idle_ticks(void) {
+    uint32_t x = idle_prng_state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    idle_prng_state = x;
+    return x % (2 * mean_idle_ticks + 1);
+}
+
+static void cb_frame_done(csma_status_t status) {
+    if (status == CSMA_STATUS_CHANNEL_ACCESS_FAILURE) {
+        current->access_failures++;
+    }
+    current->event = EVENT_FRAME;
+    current->event_at = now + idle_ticks();
+}
+
+static bool channel_busy(uint32_t start, uint32_t end) {
+    uint8_t i;
+
+    for (i = 0; i < num_nodes; i++) {
+        if (nodes[i].tx_start <= end && nodes[i].tx_end > start) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void start_tx(void) {
+    uint8_t i;
+
+    current->tx_start = now;
+    current->tx_end = now + AIRTIME_TICKS;
+    current->transmitting = true;
+    current->collided = false;
+    for (i = 0; i < num_nodes; i++) {
+        if (&nodes[i] != current && nodes[i].transmitting) {
+            nodes[i].collided = true;
+            current->collided = true;
+        }
+    }
+    current->event = EVENT_TX_END;
+    current->event_at = current->tx_end;
+}
+
+// Handle the event of the current node, with its CSMA-CA state swapped in
+static void handle_event(event_t event) {
+    csma_vars = current->csma;
+
+    switch (event) {
+        case EVENT_FRAME:
+            if (blind) {
+                current->event = EVENT_TX_START;
+                current->event_at = now + CSMA_TURNAROUND_TICKS;
+            } else {
+                CHECK(csma_send_async(packet, PKT_LEN, cb_frame_done));
+            }
+            break;
+        case EVENT_TIMER:
+            current->timer_cb();
+            break;
+        case EVENT_CCA_END:
+            current->radio_cb(channel_busy(current->cca_start, now)
+                                  ? RADIO_STATUS_CCA_BUSY
+                                  : RADIO_STATUS_CCA_CLEAR);
+            break;
+        case EVENT_TX_START:
+            start_tx();
+            break;
+        case EVENT_TX_END:
+            current->transmitting = false;
+            current->frames++;
+            if (!current->collided) {
+                current->delivered++;
+            }
+            if (blind) {
+                cb_frame_done(CSMA_STATUS_SUCCESS);
+            } else {
+                current->radio_cb(RADIO_STATUS_SENT);
+            }
+            break;
+        case EVENT_NONE:
+            break;
+    }
+
+    current->csma = csma_vars;
+}
+
+// Run n nodes for SIM_TICKS at an offered load of load per mille of the
+// channel time, counting each frame as its airtime only
+static result_t simulate(uint8_t n, uint32_t load, bool use_blind) {
+    result_t result;
+    node_t* next;
+    event_t event;
+    uint8_t i;
+
+    memset(nodes, 0, sizeof(nodes));
+    num_nodes = n;
+    now = 0;
+    blind = use_blind;
+    mean_idle_ticks = AIRTIME_TICKS * (1000 * n - load) / load;
+
+    for (i = 0; i < n; i++) {
+        current = &nodes[i];
+        csma_init(0x9E3779B9 * (i + 1));
+        current->csma = csma_vars;
+        current->event = EVENT_FRAME;
+        current->event_at = idle_ticks();
+    }
+
+    while (true) {
+        next = &nodes[0];
+        for (i = 1; i < n; i++) {
+            if (nodes[i].event_at < next->event_at) {
+                next = &nodes[i];
+            }
+        }
+        if (next->event_at >= SIM_TICKS) {
+            break;
+        }
+
+        current = next;
+        now = next->event_at;
+        event = next->event;
+        next->event = EVENT_NONE;
+        handle_event(event);
+        CHECK(next->event != EVENT_NONE);
+    }
+
+    memset(&result, 0, sizeof(result));
+    for (i = 0; i < n; i++) {
+        result.delivered += nodes[i].delivered;
+        result.frames += nodes[i].frames;
+        result.access_failures += nodes[i].access_failures;
+    }
+    result.throughput =
+        (uint64_t)result.delivered * AIRTIME_TICKS * 1000 / SIM_TICKS;
+    return result;
+}
+
+static void check_throughput(uint8_t n, uint32_t load) {
+    result_t aloha = simulate(n, load, true);
+    result_t csma = simulate(n, load, false);
+
+    printf("%2u nodes, load %4u: blind %3u, CSMA-CA %3u per mille, "
+           "%u access failures\n",
+           n, load, aloha.throughput, csma.throughput, csma.access_failures);
+
+    // Alone on the channel, every frame gets through
+    if (n == 1) {
+        CHECK(aloha.delivered == aloha.frames);
+        CHECK(csma.delivered == csma.frames);
+        CHECK(csma.access_failures == 0);
+        return;
+    }
+
+    CHECK(csma.throughput > aloha.throughput);
+    CHECK(csma.frames - csma.delivered < aloha.frames - aloha.delivered);
+}
+
+int main(void) {
+    const uint8_t node_counts[] = {1, 2, 5, 10};
+    const uint32_t loads[] = {500, 1000};
+    uint8_t i;
+    uint8_t j;
+
+    packet[0] = IEEE_802_15_4_FRAME_TYPE_DATA;  // no ACK request
+
+    for (i = 0; i < sizeof(loads) / sizeof(loads[0]); i++) {
+        for (j = 0; j < sizeof(node_counts); j++) {
+            check_throughput(node_counts[j], loads[i]);
+        }
+    }
+
+    printf("csma: %u failures\n", failures);
+    return failures != 0;
+}
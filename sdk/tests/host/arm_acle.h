@@ -0,0 +1,3 @@
+// Empty stand-in for the ARM C language extensions header, so that the CMSIS
+// headers pulled in by scum.h parse with the host compiler. The host checks
+// never call the CMSIS intrinsics.
@@ -0,0 +1,40 @@
+#include "scum_host.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gpio.h"
+
+//=========================== variables =======================================
+
+host_rf_t host_rf;
+host_rftimer_t host_rftimer;
+uint8_t* volatile host_dma_rf_rx_addr;
+volatile uint32_t host_analog_cfg[31];
+volatile uint32_t host_gpio_input;
+volatile uint32_t host_gpio_output;
+volatile uint32_t host_adc_start;
+volatile uint32_t host_adc_data;
+
+bool host_irq_masked = false;
+void (*host_wfi_hook)(void) = NULL;
+
+//=========================== public ==========================================
+
+void host_disable_irq(void) { host_irq_masked = true; }
+
+void host_enable_irq(void) { host_irq_masked = false; }
+
+// A pending interrupt wakes the core up even while it is masked
+void host_wfi(void) {
+    if (host_wfi_hook != NULL) {
+        host_wfi_hook();
+    }
+}
+
+// Debug pins, not modelled
+void gpio_2_set(void) {}
+void gpio_2_clr(void) {}
+void gpio_6_set(void) {}
+void gpio_6_clr(void) {}
@@ -0,0 +1,166 @@
+// Host stand-in of the SCuM peripherals, for the host checks that build bsp
+// drivers touching them. Included ahead of every source with -include: scum.h
+// is parsed as for the Cortex-M0, then the peripheral registers are moved to
+// host variables and the core intrinsics to host functions, so that a check
+// can preset the registers an interrupt handler reads and call the handler.
+
+#ifndef __SCUM_HOST_H
+#define __SCUM_HOST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "scum.h"
+
+//=========================== typedef =========================================
+
+// Same layouts as SCUM_RF_TypeDef and SCUM_RFTIMER_TypeDef, all writable
+typedef struct {
+    volatile uint32_t CONTROL;
+    volatile uint32_t STATUS;
+    volatile uint32_t TX_DATA_ADDR;
+    volatile uint32_t TX_PACK_LEN;
+    volatile uint32_t INT;
+    volatile uint32_t INT_CONFIG;
+    volatile uint32_t INT_CLEAR;
+    volatile uint32_t ERROR;
+    volatile uint32_t ERROR_CONFIG;
+    volatile uint32_t ERROR_CLEAR;
+} host_rf_t;
+
+typedef struct {
+    volatile uint32_t CONTROL;
+    volatile uint32_t COUNTER;
+    volatile uint32_t MAX_COUNT;
+    volatile uint32_t COMPARE[8];
+    volatile uint32_t COMPARE_CONTROL[8];
+    volatile uint32_t CAPTURE[4];
+    volatile uint32_t CAPTURE_CONTROL[4];
+    volatile uint32_t INT;
+    volatile uint32_t INT_CLEAR;
+} host_rftimer_t;
+
+//=========================== variables =======================================
+
+extern host_rf_t host_rf;
+extern host_rftimer_t host_rftimer;
+extern uint8_t* volatile host_dma_rf_rx_addr;
+extern volatile uint32_t host_analog_cfg[31];
+extern volatile uint32_t host_gpio_input;
+extern volatile uint32_t host_gpio_output;
+extern volatile uint32_t host_adc_start;
+extern volatile uint32_t host_adc_data;
+
+// Set between __disable_irq() and __enable_irq()
+extern bool host_irq_masked;
+
+// Called by __WFI(), e.g. to raise the interrupt a driver is waiting for
+extern void (*host_wfi_hook)(void);
+
+//=========================== prototypes ======================================
+
+void host_disable_irq(void);
+void host_enable_irq(void);
+void host_wfi(void);
+
+//=========================== registers =======================================
+
+#undef SCUM_RF
+#undef SCUM_RFTIMER
+#undef SCUM_DMA_RF_RX_ADDR
+#undef SCUM_ADC_START
+#undef SCUM_ADC_DATA
+#undef SCUM_GPIO_INPUT
+#undef SCUM_GPIO_OUTPUT
+#undef SCUM_ANALOG_CFG_REG_0
+#undef SCUM_ANALOG_CFG_REG_1
+#undef SCUM_ANALOG_CFG_REG_2
+#undef SCUM_ANALOG_CFG_REG_3
+#undef SCUM_ANALOG_CFG_REG_4
+#undef SCUM_ANALOG_CFG_REG_5
+#undef SCUM_ANALOG_CFG_REG_6
+#undef SCUM_ANALOG_CFG_REG_7
+#undef SCUM_ANALOG_CFG_REG_8
+#undef SCUM_ANALOG_CFG_REG_9
+#undef SCUM_ANALOG_CFG_REG_10
+#undef SCUM_ANALOG_CFG_REG_11
+#undef SCUM_ANALOG_CFG_REG_12
+#undef SCUM_ANALOG_CFG_REG_13
+#undef SCUM_ANALOG_CFG_REG_14
+#undef SCUM_ANALOG_CFG_REG_15
+#undef SCUM_ANALOG_CFG_REG_16
+#undef SCUM_ANALOG_CFG_REG_17
+#undef SCUM_ANALOG_CFG_REG_18
+#undef SCUM_ANALOG_CFG_REG_19
+#undef SCUM_ANALOG_CFG_REG_20
+#undef SCUM_ANALOG_CFG_REG_21
+#undef SCUM_ANALOG_CFG_REG_22
+#undef SCUM_ANALOG_CFG_REG_23
+#undef SCUM_ANALOG_CFG_REG_24
+#undef SCUM_ANALOG_CFG_REG_25
+#undef SCUM_ANALOG_CFG_REG_26
+#undef SCUM_ANALOG_CFG_REG_27
+#undef SCUM_ANALOG_CFG_REG_28
+#undef SCUM_ANALOG_CFG_REG_29
+#undef SCUM_ANALOG_CFG_REG_30
+#undef SCUM_ANALOG_CFG_LO_ADDR
+#undef SCUM_ANALOG_CFG_LO_ADDR_2
+
+#define SCUM_RF (&host_rf)
+#define SCUM_RFTIMER (&host_rftimer)
+#define SCUM_DMA_RF_RX_ADDR host_dma_rf_rx_addr
+#define SCUM_ADC_START host_adc_start
+#define SCUM_ADC_DATA host_adc_data
+#define SCUM_GPIO_INPUT host_gpio_input
+#define SCUM_GPIO_OUTPUT host_gpio_output
+#define SCUM_ANALOG_CFG_REG_0 host_analog_cfg[0]
+#define SCUM_ANALOG_CFG_REG_1 host_analog_cfg[1]
+#define SCUM_ANALOG_CFG_REG_2 host_analog_cfg[2]
+#define SCUM_ANALOG_CFG_REG_3 host_analog_cfg[3]
+#define SCUM_ANALOG_CFG_REG_4 host_analog_cfg[4]
+#define SCUM_ANALOG_CFG_REG_5 host_analog_cfg[5]
+#define SCUM_ANALOG_CFG_REG_6 host_analog_cfg[6]
+#define SCUM_ANALOG_CFG_REG_7 host_analog_cfg[7]
+#define SCUM_ANALOG_CFG_REG_8 host_analog_cfg[8]
+#define SCUM_ANALOG_CFG_REG_9 host_analog_cfg[9]
+#define SCUM_ANALOG_CFG_REG_10 host_analog_cfg[10]
+#define SCUM_ANALOG_CFG_REG_11 host_analog_cfg[11]
+#define SCUM_ANALOG_CFG_REG_12 host_analog_cfg[12]
+#define SCUM_ANALOG_CFG_REG_13 host_analog_cfg[13]
+#define SCUM_ANALOG_CFG_REG_14 host_analog_cfg[14]
+#define SCUM_ANALOG_CFG_REG_15 host_analog_cfg[15]
+#define SCUM_ANALOG_CFG_REG_16 host_analog_cfg[16]
+#define SCUM_ANALOG_CFG_REG_17 host_analog_cfg[17]
+#define SCUM_ANALOG_CFG_REG_18 host_analog_cfg[18]
+#define SCUM_ANALOG_CFG_REG_19 host_analog_cfg[19]
+#define SCUM_ANALOG_CFG_REG_20 host_analog_cfg[20]
+#define SCUM_ANALOG_CFG_REG_21 host_analog_cfg[21]
+#define SCUM_ANALOG_CFG_REG_22 host_analog_cfg[22]
+#define SCUM_ANALOG_CFG_REG_23 host_analog_cfg[23]
+#define SCUM_ANALOG_CFG_REG_24 host_analog_cfg[24]
+#define SCUM_ANALOG_CFG_REG_25 host_analog_cfg[25]
+#define SCUM_ANALOG_CFG_REG_26 host_analog_cfg[26]
+#define SCUM_ANALOG_CFG_REG_27 host_analog_cfg[27]
+#define SCUM_ANALOG_CFG_REG_28 host_analog_cfg[28]
+#define SCUM_ANALOG_CFG_REG_29 host_analog_cfg[29]
+#define SCUM_ANALOG_CFG_REG_30 host_analog_cfg[30]
+#define SCUM_ANALOG_CFG_LO_ADDR host_analog_cfg[7]
+#define SCUM_ANALOG_CFG_LO_ADDR_2 host_analog_cfg[8]
+
+//=========================== core ============================================
+
+#undef NVIC_EnableIRQ
+#undef NVIC_DisableIRQ
+#undef NVIC_ClearPendingIRQ
+#undef NVIC_SetPendingIRQ
+#undef __WFI
+
+#define NVIC_EnableIRQ(irq) ((void)(irq))
+#define NVIC_DisableIRQ(irq) ((void)(irq))
+#define NVIC_ClearPendingIRQ(irq) ((void)(irq))
+#define NVIC_SetPendingIRQ(irq) ((void)(irq))
+#define __WFI() host_wfi()
+#define __disable_irq() host_disable_irq()
+#define __enable_irq() host_enable_irq()
+
+#endif
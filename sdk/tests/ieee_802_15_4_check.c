@@ -0,0 +1,174 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "ieee_802_15_4.h"
+
+// Host check of the 802.15.4 frame parser and builder: headers built by
+// ieee_802_15_4_build_header() must parse back to the same fields, and
+// frames captured from other stacks must parse to their known fields.
+
+static const uint8_t ext_addr[IEEE_802_15_4_EXT_ADDR_LENGTH] = {
+    0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+
+// Build header, append a payload of payload_length bytes and the FCS, parse
+// the frame back and compare
+static void check_round_trip(const ieee_802_15_4_frame_t* header,
+                             uint8_t payload_length) {
+    uint8_t frame[127];
+    ieee_802_15_4_frame_t view;
+    uint8_t offset;
+    uint8_t length;
+    uint8_t i;
+
+    offset = ieee_802_15_4_build_header(frame, header);
+    for (i = 0; i < payload_length; i++) {
+        frame[offset + i] = i;
+    }
+    length = offset + payload_length + 2;
+
+    CHECK(ieee_802_15_4_parse(frame, length, &view));
+    CHECK(view.frame_type == header->frame_type);
+    CHECK(view.frame_version == header->frame_version);
+    CHECK(view.ack_request == header->ack_request);
+    CHECK(view.frame_pending == header->frame_pending);
+    CHECK(view.dst_addr_mode == header->dst_addr_mode);
+    CHECK(view.src_addr_mode == header->src_addr_mode);
+    if (view.seq_num_present) {
+        CHECK(view.seq_num == header->seq_num);
+    }
+    if (view.dst_pan_id_present) {
+        CHECK(view.dst_pan_id == header->dst_pan_id);
+    }
+    if (header->src_addr_mode != IEEE_802_15_4_ADDR_MODE_NONE) {
+        CHECK(view.src_pan_id == header->src_pan_id);
+    }
+    if (header->dst_addr_mode == IEEE_802_15_4_ADDR_MODE_SHORT) {
+        CHECK(view.dst_short_addr == header->dst_short_addr);
+    } else if (header->dst_addr_mode == IEEE_802_15_4_ADDR_MODE_EXTENDED) {
+        CHECK(memcmp(view.dst_addr, header->dst_addr,
+                     IEEE_802_15_4_EXT_ADDR_LENGTH) == 0);
+    }
+    if (header->src_addr_mode == IEEE_802_15_4_ADDR_MODE_SHORT) {
+        CHECK(view.src_short_addr == header->src_short_addr);
+    } else if (header->src_addr_mode == IEEE_802_15_4_ADDR_MODE_EXTENDED) {
+        CHECK(memcmp(view.src_addr, header->src_addr,
+                     IEEE_802_15_4_EXT_ADDR_LENGTH) == 0);
+    }
+    CHECK(view.payload_offset == offset);
+    CHECK(view.payload == &frame[offset]);
+    CHECK(view.payload_length == payload_length);
+
+    // Any truncation of the header is rejected
+    for (i = 0; i < offset + 2; i++) {
+        CHECK(!ieee_802_15_4_parse(frame, i, &view));
+    }
+}
+
+static void check_data_frames(void) {
+    ieee_802_15_4_frame_t header;
+
+    // Short addresses in the same PAN: the source PAN ID is compressed away
+    memset(&header, 0, sizeof(header));
+    header.frame_type = IEEE_802_15_4_FRAME_TYPE_DATA;
+    header.frame_version = IEEE_802_15_4_FRAME_VERSION_2006;
+    header.ack_request = true;
+    header.seq_num = 42;
+    header.dst_addr_mode = IEEE_802_15_4_ADDR_MODE_SHORT;
+    header.dst_pan_id = 0xCAFE;
+    header.dst_short_addr = 0x1234;
+    header.src_addr_mode = IEEE_802_15_4_ADDR_MODE_SHORT;
+    header.src_pan_id = 0xCAFE;
+    header.src_short_addr = 0x5678;
+    check_round_trip(&header, 10);
+
+    // Extended source address in another PAN
+    header.src_addr_mode = IEEE_802_15_4_ADDR_MODE_EXTENDED;
+    header.src_pan_id = 0xBEEF;
+    header.src_addr = ext_addr;
+    header.frame_pending = true;
+    check_round_trip(&header, 0);
+
+    // Broadcast without source address, 2003 frame
+    memset(&header, 0, sizeof(header));
+    header.frame_type = IEEE_802_15_4_FRAME_TYPE_DATA;
+    header.frame_version = IEEE_802_15_4_FRAME_VERSION_2003;
+    header.seq_num = 7;
+    header.dst_addr_mode = IEEE_802_15_4_ADDR_MODE_SHORT;
+    header.dst_pan_id = IEEE_802_15_4_BROADCAST_PAN_ID;
+    header.dst_short_addr = IEEE_802_15_4_BROADCAST_ADDR;
+    check_round_trip(&header, 100);
+
+    // 2015 frame, extended addresses in the same PAN, sequence number kept
+    memset(&header, 0, sizeof(header));
+    header.frame_type = IEEE_802_15_4_FRAME_TYPE_DATA;
+    header.frame_version = IEEE_802_15_4_FRAME_VERSION_2015;
+    header.seq_num_present = true;
+    header.seq_num = 200;
+    header.dst_addr_mode = IEEE_802_15_4_ADDR_MODE_EXTENDED;
+    header.dst_addr = ext_addr;
+    header.dst_pan_id = 0xCAFE;
+    header.src_addr_mode = IEEE_802_15_4_ADDR_MODE_EXTENDED;
+    header.src_addr = ext_addr;
+    header.src_pan_id = 0xCAFE;
+    check_round_trip(&header, 20);
+
+    // Same with the sequence number suppressed
+    header.seq_num_present = false;
+    check_round_trip(&header, 20);
+}
+
+// 2015 enhanced beacon from short address 0x0001 in PAN 0xCAFE: a header
+// termination IE, then payload IEs, as sent by TSCH coordinators
+static void check_enhanced_beacon(void) {
+    static const uint8_t frame[] = {
+        0x00, 0xA2, 0x05, 0xFE, 0xCA, 0x01, 0x00, 0x00, 0x3F, 0x08, 0x88,
+        0x06, 0x1A, 0x01, 0x02, 0x03, 0x04, 0x05, 0x00, 0x00, 0x00};
+    ieee_802_15_4_frame_t view;
+
+    CHECK(ieee_802_15_4_parse(frame, sizeof(frame), &view));
+    CHECK(view.frame_type == IEEE_802_15_4_FRAME_TYPE_BEACON);
+    CHECK(view.frame_version == IEEE_802_15_4_FRAME_VERSION_2015);
+    CHECK(view.seq_num_present && view.seq_num == 5);
+    CHECK(view.dst_addr_mode == IEEE_802_15_4_ADDR_MODE_NONE);
+    CHECK(view.src_addr_mode == IEEE_802_15_4_ADDR_MODE_SHORT);
+    CHECK(view.src_pan_id_present && view.src_pan_id == 0xCAFE);
+    CHECK(view.src_short_addr == 0x0001);
+    CHECK(view.ie_present);
+    CHECK(view.header_ie == &frame[7] && view.header_ie_length == 2);
+    CHECK(view.payload_offset == 9);
+    CHECK(view.payload_length == sizeof(frame) - 9 - 2);
+}
+
+static void check_ack(void) {
+    uint8_t frame[IEEE_802_15_4_ACK_LENGTH];
+    ieee_802_15_4_frame_t view;
+
+    CHECK(ieee_802_15_4_build_ack(frame, 99, true) ==
+          IEEE_802_15_4_ACK_LENGTH);
+    CHECK(ieee_802_15_4_parse(frame, sizeof(frame), &view));
+    CHECK(view.frame_type == IEEE_802_15_4_FRAME_TYPE_ACK);
+    CHECK(view.seq_num == 99);
+    CHECK(view.frame_pending);
+    CHECK(view.payload_length == 0);
+}
+
+// Reserved addressing mode 1
+static void check_reserved(void) {
+    static const uint8_t frame[] = {0x41, 0x04, 0x01, 0x00, 0x00, 0x00, 0x00};
+    ieee_802_15_4_frame_t view;
+
+    CHECK(!ieee_802_15_4_parse(frame, sizeof(frame), &view));
+}
+
+int main(void) {
+    check_data_frames();
+    check_enhanced_beacon();
+    check_ack();
+    check_reserved();
+
+    printf("ieee_802_15_4: %u failures\n", failures);
+    return failures != 0;
+}
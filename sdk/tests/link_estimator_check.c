@@ -0,0 +1,182 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "check.h"
+#include "ieee_802_15_4.h"
+#include "link_estimator.h"
+#include "neighbor_table.h"
+
+// Host check of the neighbor table and the link estimator: least recently
+// used eviction, channel blacklisting once a channel has been tried enough,
+// the last usable channel kept, and blacklisted channels tried again after
+// the timeout. The RF timer is the stand-in below, moved by the check.
+
+#define TABLE_ENTRIES 3
+#define TIMEOUT 1000
+
+typedef struct {
+    neighbor_table_entry_t entry;
+    uint32_t value;
+} entry_t;
+
+static uint32_t now;
+
+uint32_t rftimer_readCounter(void) { return now; }
+
+// Report frames to neighbor 1 on channel that were never acknowledged
+static void fail_frames(uint8_t channel, uint8_t frames) {
+    uint8_t i;
+
+    for (i = 0; i < frames; i++) {
+        link_estimator_report_tx(1, channel, 1, false);
+    }
+}
+
+static void check_neighbor_table(void) {
+    entry_t entries[TABLE_ENTRIES];
+    neighbor_table_t table;
+    neighbor_table_result_t result;
+    entry_t* entry;
+    uint16_t addr;
+
+    neighbor_table_init(&table, entries, TABLE_ENTRIES, sizeof(entry_t));
+    CHECK(neighbor_table_find(&table, 1) == NULL);
+
+    for (addr = 1; addr <= TABLE_ENTRIES; addr++) {
+        entry = neighbor_table_add(&table, addr, &result);
+        CHECK(result == NEIGHBOR_TABLE_ADDED);
+        CHECK(entry->entry.addr == addr);
+        entry->value = addr;
+    }
+
+    // Using neighbor 1 again makes neighbor 2 the least recently used
+    entry = neighbor_table_add(&table, 1, &result);
+    CHECK(result == NEIGHBOR_TABLE_FOUND);
+    CHECK(entry->value == 1);
+
+    entry = neighbor_table_add(&table, 4, &result);
+    CHECK(result == NEIGHBOR_TABLE_EVICTED);
+    CHECK(entry == &entries[1]);
+    CHECK(entry->value == 0);
+    CHECK(neighbor_table_find(&table, 2) == NULL);
+    CHECK(neighbor_table_find(&table, 1) == &entries[0]);
+    CHECK(neighbor_table_find(&table, 3) == &entries[2]);
+
+    // Finding a neighbor does not count as using it
+    CHECK(neighbor_table_find(&table, 3) != NULL);
+    neighbor_table_add(&table, 5, &result);
+    CHECK(result == NEIGHBOR_TABLE_EVICTED);
+    CHECK(neighbor_table_find(&table, 3) == NULL);
+
+    neighbor_table_clear(&table);
+    CHECK(neighbor_table_find(&table, 1) == NULL);
+    neighbor_table_add(&table, 1, &result);
+    CHECK(result == NEIGHBOR_TABLE_ADDED);
+}
+
+static void check_eviction(void) {
+    link_estimator_stats_t stats;
+    link_estimate_t estimate;
+    uint16_t addr;
+
+    link_estimator_init();
+    for (addr = 1; addr <= LINK_ESTIMATOR_MAX_NEIGHBORS; addr++) {
+        link_estimator_report_rx(addr, 11, -50, 100);
+    }
+    link_estimator_report_tx(1, 11, 2, true);
+    link_estimator_report_rx(LINK_ESTIMATOR_MAX_NEIGHBORS + 1, 11, -60, 90);
+
+    link_estimator_get_stats(&stats);
+    CHECK(stats.evictions == 1);
+    CHECK(!link_estimator_get_neighbor(2, &estimate));
+    CHECK(link_estimator_get_neighbor(1, &estimate));
+    CHECK(estimate.rssi == -50 * LINK_ESTIMATOR_ONE);
+    CHECK(estimate.delivery == LINK_ESTIMATOR_ONE / 2);
+    CHECK(estimate.etx == 2 * LINK_ESTIMATOR_ONE);
+    CHECK(link_estimator_get_link(LINK_ESTIMATOR_MAX_NEIGHBORS + 1, 11,
+                                  &estimate));
+    CHECK(estimate.rx_frames == 1 && estimate.lqi == 90 * LINK_ESTIMATOR_ONE);
+    CHECK(!link_estimator_get_link(1, 10, &estimate));
+}
+
+static void check_blacklist(void) {
+    link_estimator_stats_t stats;
+    uint8_t i;
+
+    now = 0xFFFFFF00;  // the timeout wraps around
+    link_estimator_init();
+    link_estimator_set_blacklist(LINK_ESTIMATOR_DEFAULT_BLACKLIST_THRESHOLD,
+                                 TIMEOUT);
+
+    // Under the threshold well before, but not blacklisted until the channel
+    // has been tried LINK_ESTIMATOR_MIN_SAMPLES times
+    fail_frames(11, LINK_ESTIMATOR_MIN_SAMPLES);
+    CHECK(link_estimator_channel_usable(11));
+    fail_frames(11, 1);
+    CHECK(!link_estimator_channel_usable(11));
+    CHECK(link_estimator_get_channel_mask() == 0xFFFE);
+    link_estimator_get_stats(&stats);
+    CHECK(stats.blacklisted == 1);
+
+    // Two out of three frames acknowledged keep a channel over the threshold
+    for (i = 0; i < 4 * LINK_ESTIMATOR_MIN_SAMPLES; i++) {
+        link_estimator_report_tx(1, 12, 1, true);
+        link_estimator_report_tx(1, 12, 1, true);
+        fail_frames(12, 1);
+    }
+    CHECK(link_estimator_channel_usable(12));
+
+    // Tried again after the timeout, starting over as a perfect channel
+    now += TIMEOUT - 1;
+    CHECK(!link_estimator_channel_usable(11));
+    now++;
+    CHECK(link_estimator_channel_usable(11));
+    link_estimator_get_stats(&stats);
+    CHECK(stats.retried == 1);
+    fail_frames(11, LINK_ESTIMATOR_MIN_SAMPLES);
+    CHECK(link_estimator_channel_usable(11));
+    fail_frames(11, 1);
+    CHECK(!link_estimator_channel_usable(11));
+
+    // A threshold of 0 clears the blacklist
+    link_estimator_set_blacklist(0, TIMEOUT);
+    CHECK(link_estimator_get_channel_mask() == 0xFFFF);
+    fail_frames(11, 4 * LINK_ESTIMATOR_MIN_SAMPLES);
+    CHECK(link_estimator_channel_usable(11));
+}
+
+static void check_last_channel(void) {
+    link_estimator_stats_t stats;
+    uint8_t channel;
+
+    now = 0;
+    link_estimator_init();
+    for (channel = IEEE_802_15_4_MIN_CHANNEL;
+         channel < IEEE_802_15_4_MIN_CHANNEL + IEEE_802_15_4_NUM_CHANNELS - 1;
+         channel++) {
+        fail_frames(channel, LINK_ESTIMATOR_MIN_SAMPLES + 1);
+        CHECK(!link_estimator_channel_usable(channel));
+    }
+    CHECK(link_estimator_get_channel_mask() == 0x8000);
+
+    fail_frames(channel, 4 * LINK_ESTIMATOR_MIN_SAMPLES);
+    CHECK(link_estimator_channel_usable(channel));
+    CHECK(link_estimator_get_channel_mask() == 0x8000);
+    link_estimator_get_stats(&stats);
+    CHECK(stats.blacklisted == IEEE_802_15_4_NUM_CHANNELS - 1);
+
+    link_estimator_reset_stats();
+    link_estimator_get_stats(&stats);
+    CHECK(stats.blacklisted == 0);
+}
+
+int main(void) {
+    check_neighbor_table();
+    check_eviction();
+    check_blacklist();
+    check_last_channel();
+
+    printf("link_estimator: %u failures\n", failures);
+    return failures != 0;
+}
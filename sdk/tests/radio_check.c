@@ -0,0 +1,295 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "check.h"
+#include "ieee_802_15_4.h"
+#include "radio.h"
+#include "scum.h"
+
+// Host check of the radio driver against the register model of
+// host/scum_host.h: each frame is written where the RX DMA points, the RF
+// timer captures of its SFD and end are latched, and the RF interrupt
+// handler is called as the hardware would.
+
+#define PAN_ID 0xCAFE
+#define SHORT_ADDR 0x0001
+
+// Frame control fields of the frames received
+#define FCF_DATA_2006_SHORT 0x9861    // ACK request, PAN ID compression
+#define FCF_DATA_2015_EXT 0xEC41      // PAN ID compression: no PAN ID at all
+#define FCF_DATA_2015_EXT_PAN 0xEC01  // destination PAN ID only
+
+// Frames received to time the RX path
+#define RATE_FRAMES 1000000
+
+// RF timer tick, 2 us
+#define RFTIMER_TICK_NS 2000
+
+void RF_Handler(void);
+
+static uint32_t hook_timestamp;
+
+static const uint8_t own_ext_addr[IEEE_802_15_4_EXT_ADDR_LENGTH] = {
+    0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18};
+static const uint8_t other_ext_addr[IEEE_802_15_4_EXT_ADDR_LENGTH] = {
+    0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28};
+
+// RF timer capture channel radio_init() latches input_sel on
+static uint8_t capture_channel(uint32_t input_sel) {
+    uint8_t i;
+
+    for (i = 0; i < 4; i++) {
+        if (host_rftimer.CAPTURE_CONTROL[i] == input_sel) {
+            return i;
+        }
+    }
+    CHECK(false);
+    return 0;
+}
+
+// Receive the MAC frame of length bytes, FCS included, whose SFD and end the
+// RF timer latched at sfd and end. Each interrupt is handled latency ticks
+// after its event.
+static void receive_frame_late(const uint8_t* frame, uint8_t length,
+                               uint32_t sfd, uint32_t end, uint32_t latency) {
+    host_dma_rf_rx_addr[0] = length;
+    memcpy(&host_dma_rf_rx_addr[1], frame, length);
+    host_rf.ERROR = 0;
+
+    host_rftimer.CAPTURE[capture_channel(
+        RFTIMER_CAPTURE_INPUT_SEL_RX_SFD_DONE)] = sfd;
+    host_rftimer.COUNTER = sfd + latency;
+    host_rf.INT = RX_SFD_DONE_INT;
+    RF_Handler();
+
+    host_rftimer.CAPTURE[capture_channel(RFTIMER_CAPTURE_INPUT_SEL_RX_DONE)] =
+        end;
+    host_rftimer.COUNTER = end + latency;
+    host_rf.INT = RX_DONE_INT;
+    RF_Handler();
+    host_rf.INT = 0;
+}
+
+static void receive_frame(const uint8_t* frame, uint8_t length, uint32_t sfd,
+                          uint32_t end) {
+    receive_frame_late(frame, length, sfd, end, 0);
+}
+
+// Build a data frame with fcf, to dst_addr (short or extended, from
+// dst_addr_len) in dst_pan_id if pan_id_present, from an extended source.
+// Returns its length, FCS included.
+static uint8_t build_frame(uint8_t* frame, uint16_t fcf, bool pan_id_present,
+                           uint16_t dst_pan_id, const uint8_t* dst_addr,
+                           uint8_t dst_addr_len) {
+    uint8_t length = 0;
+
+    frame[length++] = fcf & 0xFF;
+    frame[length++] = fcf >> 8;
+    frame[length++] = 0x42;  // sequence number
+    if (pan_id_present) {
+        frame[length++] = dst_pan_id & 0xFF;
+        frame[length++] = dst_pan_id >> 8;
+    }
+    memcpy(&frame[length], dst_addr, dst_addr_len);
+    length += dst_addr_len;
+    if (dst_addr_len == IEEE_802_15_4_SHORT_ADDR_LENGTH) {
+        frame[length++] = 0x02;  // short source address
+        frame[length++] = 0x00;
+    } else {
+        memcpy(&frame[length], other_ext_addr, IEEE_802_15_4_EXT_ADDR_LENGTH);
+        length += IEEE_802_15_4_EXT_ADDR_LENGTH;
+    }
+    memset(&frame[length], 0xA5, 20);  // payload
+    length += 20;
+    frame[length++] = 0;  // FCS, not checked by the model
+    frame[length++] = 0;
+    return length;
+}
+
+// Whether a frame received while listening with the address filter on was
+// queued
+static bool frame_accepted(const uint8_t* frame, uint8_t length) {
+    radio_stats_t before;
+    radio_stats_t after;
+    radio_rx_slot_t* slot;
+    bool accepted;
+
+    radio_get_stats(&before);
+    receive_frame(frame, length, 1000, 1000 + 16 * (length + 6));
+    radio_get_stats(&after);
+
+    slot = radio_rx_peek();
+    accepted = slot != NULL;
+    CHECK(accepted == (after.rx_filtered == before.rx_filtered));
+    if (slot != NULL) {
+        CHECK(slot->length == length);
+        radio_rx_release();
+    }
+    return accepted;
+}
+
+static void check_address_filter(void) {
+    const uint8_t own_short[2] = {SHORT_ADDR & 0xFF, SHORT_ADDR >> 8};
+    const uint8_t other_short[2] = {0x03, 0x00};
+    uint8_t frame[MAXLENGTH_TRX_BUFFER];
+    uint8_t length;
+
+    radio_init();
+    radio_set_address_filter(PAN_ID, SHORT_ADDR, own_ext_addr);
+    CHECK(radio_rx_listen());
+
+    // 2006 frames: the destination PAN ID is always present
+    length = build_frame(frame, FCF_DATA_2006_SHORT, true, PAN_ID, own_short,
+                         sizeof(own_short));
+    CHECK(frame_accepted(frame, length));
+    length = build_frame(frame, FCF_DATA_2006_SHORT, true, PAN_ID,
+                         other_short, sizeof(other_short));
+    CHECK(!frame_accepted(frame, length));
+    length = build_frame(frame, FCF_DATA_2006_SHORT, true, 0x1234, own_short,
+                         sizeof(own_short));
+    CHECK(!frame_accepted(frame, length));
+
+    // 2015 frames between extended addresses with PAN ID compression carry no
+    // PAN ID: the destination address follows the sequence number
+    length = build_frame(frame, FCF_DATA_2015_EXT, false, 0, own_ext_addr,
+                         sizeof(own_ext_addr));
+    CHECK(frame_accepted(frame, length));
+    length = build_frame(frame, FCF_DATA_2015_EXT, false, 0, other_ext_addr,
+                         sizeof(other_ext_addr));
+    CHECK(!frame_accepted(frame, length));
+
+    // Without compression, the destination PAN ID is present
+    length = build_frame(frame, FCF_DATA_2015_EXT_PAN, true, PAN_ID,
+                         own_ext_addr, sizeof(own_ext_addr));
+    CHECK(frame_accepted(frame, length));
+    length = build_frame(frame, FCF_DATA_2015_EXT_PAN, true, 0x1234,
+                         own_ext_addr, sizeof(own_ext_addr));
+    CHECK(!frame_accepted(frame, length));
+
+    radio_rx_cancel();
+}
+
+// RX hook recording the end of frame timestamp it is given
+static radio_rx_verdict_t record_timestamp(radio_rx_slot_t* slot,
+                                           uint32_t timestamp) {
+    hook_timestamp = timestamp;
+    return RADIO_RX_HOOK_QUEUE;
+}
+
+// The SFD timestamp of a frame is the RF timer capture of its SFD, and the
+// hook gets the capture of its end, however late the RF interrupt is handled
+// and across the wrap-around of the RF timer
+static void check_timestamps(void) {
+    const uint32_t latencies[] = {0, 1, 250, 5000, 0x80000000};
+    const uint8_t dst_addr[2] = {SHORT_ADDR & 0xFF, SHORT_ADDR >> 8};
+    uint8_t frame[MAXLENGTH_TRX_BUFFER];
+    radio_rx_slot_t* slot;
+    uint32_t sfd = 0xFFFFF000;  // about to wrap around
+    uint32_t end;
+    uint8_t length;
+    uint8_t i;
+
+    radio_init();
+    radio_set_rx_hook(record_timestamp);
+    CHECK(radio_rx_listen());
+
+    length = build_frame(frame, FCF_DATA_2006_SHORT, true, PAN_ID, dst_addr,
+                         sizeof(dst_addr));
+    for (i = 0; i < sizeof(latencies) / sizeof(latencies[0]); i++) {
+        end = sfd + 16 * (length + 1);
+        receive_frame_late(frame, length, sfd, end, latencies[i]);
+
+        slot = radio_rx_peek();
+        CHECK(slot != NULL);
+        if (slot != NULL) {
+            CHECK(slot->timestamp == sfd);
+            radio_rx_release();
+        }
+        CHECK(hook_timestamp == end);
+
+        sfd = end + 1000;
+    }
+
+    radio_set_rx_hook(NULL);
+    radio_rx_cancel();
+}
+
+// Receive a frame back to back with the one that ended at *end: its SFD
+// follows the preamble and SFD of the next frame
+static void receive_back_to_back(const uint8_t* frame, uint8_t length,
+                                 uint32_t* end) {
+    uint32_t sfd = *end + (IEEE_802_15_4_PHY_OVERHEAD - 1) *
+                              IEEE_802_15_4_BYTE_TICKS;
+
+    *end = sfd + (length + 1) * IEEE_802_15_4_BYTE_TICKS;
+    receive_frame(frame, length, sfd, *end);
+}
+
+// Back-to-back frames are all kept while the ring has room, and counted as
+// dropped once it is full. Then time the RX path per frame, both interrupts
+// and the drain, on the host, against the air time of the frame.
+static void check_rx_rate(void) {
+    const uint8_t dst_addr[2] = {SHORT_ADDR & 0xFF, SHORT_ADDR >> 8};
+    uint8_t frame[MAXLENGTH_TRX_BUFFER];
+    radio_stats_t stats;
+    struct timespec start;
+    struct timespec stop;
+    uint64_t ns;
+    uint32_t air_ns;
+    uint32_t end = 0;
+    uint32_t i;
+    uint8_t length;
+
+    radio_init();
+    CHECK(radio_rx_listen());
+    length = build_frame(frame, FCF_DATA_2006_SHORT, true, PAN_ID, dst_addr,
+                         sizeof(dst_addr));
+
+    for (i = 0; i < RADIO_RX_RING_SIZE - 1; i++) {
+        receive_back_to_back(frame, length, &end);
+    }
+    radio_get_stats(&stats);
+    CHECK(stats.rx_frames == RADIO_RX_RING_SIZE - 1 && stats.rx_drops == 0);
+    receive_back_to_back(frame, length, &end);
+    radio_get_stats(&stats);
+    CHECK(stats.rx_drops == 1);
+    for (i = 0; radio_rx_peek() != NULL; i++) {
+        radio_rx_release();
+    }
+    CHECK(i == RADIO_RX_RING_SIZE - 1);
+
+    timespec_get(&start, TIME_UTC);
+    for (i = 0; i < RATE_FRAMES; i++) {
+        receive_back_to_back(frame, length, &end);
+        if (radio_rx_peek() != NULL) {
+            radio_rx_release();
+        }
+    }
+    timespec_get(&stop, TIME_UTC);
+    radio_get_stats(&stats);
+    CHECK(stats.rx_drops == 1);
+
+    ns = (uint64_t)(stop.tv_sec - start.tv_sec) * 1000000000 +
+         stop.tv_nsec - start.tv_nsec;
+    air_ns = (IEEE_802_15_4_PHY_OVERHEAD + length) * IEEE_802_15_4_BYTE_TICKS *
+             RFTIMER_TICK_NS;
+    printf("radio: %u-byte frames, RX path %lu ns per frame on the host "
+           "(%lu frames/s), air time %lu ns (%lu frames/s)\n",
+           length, (unsigned long)(ns / RATE_FRAMES),
+           (unsigned long)(RATE_FRAMES * 1000000000ULL / (ns + 1)),
+           (unsigned long)air_ns, (unsigned long)(1000000000 / air_ns));
+
+    radio_rx_cancel();
+}
+
+int main(void) {
+    check_address_filter();
+    check_timestamps();
+    check_rx_rate();
+
+    printf("radio: %u failures\n", failures);
+    return failures != 0;
+}